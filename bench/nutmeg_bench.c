@@ -0,0 +1,385 @@
+/*
+ * Benchmark suite for the event runtime. Every workload builds a fresh
+ * engine, ticks it a few times to warm up and then times a run of ticks
+ * with the engine's own tick statistics. Results are printed as JSON so
+ * they can be collected and compared across releases.
+ *
+ *   nutmeg_bench [--filter TEXT] [--ticks N] [--max-objects N]
+ *                [--workers N] [--output FILE] [--no-alloc] [--no-fusion]
+ *                [--list]
+ *
+ * --no-alloc arms the engine's allocation guard after warm-up, so any
+ * allocation during a timed tick aborts the run. --no-fusion runs local
+ * events one pass at a time, for comparison with the fused default.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nutmeg_engine.h"
+#include "nutmeg_builtin.h"
+
+#define BENCH_DELTA (1.0f / 60.0f)
+#define BENCH_WARMUP_TICKS 3
+#define BENCH_TARGET_OBJECT_TICKS 50000000.0
+#define BENCH_MIN_TICKS 60
+#define BENCH_MAX_TICKS NUTMEG_TICK_HISTORY_CAPACITY
+
+typedef struct BenchConfig {
+    const char *filter;
+    unsigned int ticks;    /**< Zero scales the tick count with the workload size. */
+    size_t max_objects;
+    unsigned int workers;
+    const char *output;
+    bool no_alloc;         /**< Abort on any allocation during timed ticks. */
+    bool no_fusion;        /**< Disable event fusion. */
+} BenchConfig;
+
+typedef struct BenchCase {
+    const char *name;
+    size_t objects;
+    size_t events;
+    /** Populate the scene. Returns false when the workload cannot be built. */
+    bool (*setup)(NutmegEngine *engine, NutmegScene *scene, const struct BenchCase *bench);
+} BenchCase;
+
+typedef struct BenchResult {
+    unsigned int ticks;
+    NutmegTickStats tick_stats;
+    double allocations_per_tick;
+    size_t peak_bytes;
+} BenchResult;
+
+static NutmegVelocityChange bench_push = {{0.5f, 0.25f}};
+static NutmegNameFilter bench_target_filter;
+static unsigned long long bench_timer_fires;
+static NutmegTimer *bench_timers; /**< Timer payloads of the running workload. */
+
+static bool bench_spawn(NutmegScene *scene, size_t count, const char *name)
+{
+    for (size_t i = 0; i < count; ++i) {
+        NutmegObject *object = nutmeg_scene_spawn_object(scene, name);
+        if (!object) {
+            return false;
+        }
+        NutmegVec2 *velocity = nutmeg_object_velocity(object);
+        velocity->x = (float)(i % 17) - 8.0f;
+        velocity->y = (float)(i % 13) - 6.0f;
+    }
+    return true;
+}
+
+static void bench_add_integrate(NutmegScene *scene)
+{
+    NutmegEvent integrate = nutmeg_event_make("Integrate", NUTMEG_EVENT_SCOPE_OBJECTS, false);
+    integrate.flags = NUTMEG_EVENT_FLAG_PARALLEL;
+    nutmeg_event_add_action_batch(&integrate, nutmeg_action_integrate_batch, nutmeg_action_integrate, NULL);
+    nutmeg_scene_add_event(scene, integrate);
+}
+
+static bool bench_setup_integrate(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    (void)engine;
+    bench_add_integrate(scene);
+    return bench_spawn(scene, bench->objects, "Body");
+}
+
+/* Replace one percent of the objects every tick through the deferred command buffer. */
+static void bench_action_churn(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+{
+    (void)engine;
+    (void)object;
+    (void)userdata;
+
+    size_t count = 0;
+    NutmegObject **objects = nutmeg_scene_objects(scene, &count);
+    size_t replaced = count / 100;
+    for (size_t i = 0; i < replaced; ++i) {
+        nutmeg_scene_destroy_object(scene, objects[i]);
+        nutmeg_scene_spawn_object(scene, "Body");
+    }
+}
+
+static bool bench_setup_churn(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    (void)engine;
+    bench_add_integrate(scene);
+
+    NutmegEvent churn = nutmeg_event_make("Churn", NUTMEG_EVENT_SCOPE_SCENE, false);
+    nutmeg_event_add_action(&churn, bench_action_churn, NULL);
+    nutmeg_scene_add_event(scene, churn);
+    return bench_spawn(scene, bench->objects, "Body");
+}
+
+/* One object in a hundred is a "Target"; the others are background noise. */
+static bool bench_spawn_targets(NutmegScene *scene, size_t objects)
+{
+    for (size_t i = 0; i < objects; i += 100) {
+        size_t batch = objects - i < 100 ? objects - i : 100;
+        if (!bench_spawn(scene, 1, "Target") || !bench_spawn(scene, batch - 1, "Crowd")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool bench_setup_name_query(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    NutmegEvent push = nutmeg_event_make("PushTargets", NUTMEG_EVENT_SCOPE_OBJECTS, false);
+    push.query.name = nutmeg_engine_intern(engine, "Target");
+    nutmeg_event_add_action(&push, nutmeg_action_add_velocity, &bench_push);
+    nutmeg_scene_add_event(scene, push);
+    return bench_spawn_targets(scene, bench->objects);
+}
+
+static bool bench_setup_name_condition(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    bench_target_filter.name = nutmeg_engine_intern(engine, "Target");
+
+    NutmegEvent push = nutmeg_event_make("PushTargets", NUTMEG_EVENT_SCOPE_OBJECTS, false);
+    nutmeg_event_add_condition_batch(&push, nutmeg_condition_name_is_batch, nutmeg_condition_name_is, &bench_target_filter);
+    nutmeg_event_add_action_batch(&push, nutmeg_action_add_velocity_batch, nutmeg_action_add_velocity, &bench_push);
+    nutmeg_scene_add_event(scene, push);
+    return bench_spawn_targets(scene, bench->objects);
+}
+
+static bool bench_setup_many_events(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    (void)engine;
+    for (size_t e = 0; e < bench->events; ++e) {
+        NutmegEvent small = nutmeg_event_make("Small", NUTMEG_EVENT_SCOPE_OBJECTS, false);
+        nutmeg_event_add_action_batch(&small, nutmeg_action_add_velocity_batch, nutmeg_action_add_velocity, &bench_push);
+        nutmeg_scene_add_event(scene, small);
+    }
+    return bench_spawn(scene, bench->objects, "Body");
+}
+
+/* Ten per-object motion steps that each touch only their own object. */
+static bool bench_setup_local_events(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    (void)engine;
+    for (size_t e = 0; e < bench->events; ++e) {
+        NutmegEvent step = nutmeg_event_make("LocalStep", NUTMEG_EVENT_SCOPE_OBJECTS, false);
+        step.flags = NUTMEG_EVENT_FLAG_LOCAL;
+        if (e % 2 == 0) {
+            nutmeg_event_add_action(&step, nutmeg_action_add_velocity, &bench_push);
+        } else {
+            nutmeg_event_add_action(&step, nutmeg_action_integrate, NULL);
+        }
+        nutmeg_scene_add_event(scene, step);
+    }
+    return bench_spawn(scene, bench->objects, "Body");
+}
+
+static void bench_action_count_fire(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+{
+    (void)engine;
+    (void)scene;
+    (void)object;
+    (void)userdata;
+    bench_timer_fires++;
+}
+
+static bool bench_setup_timers(NutmegEngine *engine, NutmegScene *scene, const BenchCase *bench)
+{
+    (void)engine;
+    /* every event but the integrate one is a timer; they point into this array, freed with the engine */
+    bench_timers = (NutmegTimer *)calloc(bench->events, sizeof(NutmegTimer));
+    if (!bench_timers) {
+        return false;
+    }
+    for (size_t e = 0; e + 1 < bench->events; ++e) {
+        bench_timers[e] = nutmeg_timer_make(0.05f + 0.01f * (float)(e % 100), true);
+        NutmegEvent timer = nutmeg_event_make("Timer", NUTMEG_EVENT_SCOPE_SCENE, false);
+        nutmeg_event_add_condition(&timer, nutmeg_condition_timer, &bench_timers[e]);
+        nutmeg_event_add_action(&timer, bench_action_count_fire, NULL);
+        nutmeg_scene_add_event(scene, timer);
+    }
+    bench_add_integrate(scene);
+    return bench_spawn(scene, bench->objects, "Body");
+}
+
+static const BenchCase bench_cases[] = {
+    {"integrate_1k", 1000, 1, bench_setup_integrate},
+    {"integrate_10k", 10000, 1, bench_setup_integrate},
+    {"integrate_100k", 100000, 1, bench_setup_integrate},
+    {"integrate_1m", 1000000, 1, bench_setup_integrate},
+    {"spawn_destroy_churn_10k", 10000, 2, bench_setup_churn},
+    {"spawn_destroy_churn_100k", 100000, 2, bench_setup_churn},
+    {"name_query_100k", 100000, 1, bench_setup_name_query},
+    {"name_condition_100k", 100000, 1, bench_setup_name_condition},
+    {"many_small_events_500x200", 200, 500, bench_setup_many_events},
+    {"local_events_10x100k", 100000, 10, bench_setup_local_events},
+    {"timers_2k", 1000, 2001, bench_setup_timers},
+};
+
+static unsigned int bench_tick_count(const BenchConfig *config, const BenchCase *bench)
+{
+    if (config->ticks > 0) {
+        return config->ticks < BENCH_MAX_TICKS ? config->ticks : BENCH_MAX_TICKS;
+    }
+
+    double work = (double)(bench->objects > 0 ? bench->objects : 1) * (double)(bench->events > 0 ? bench->events : 1);
+    double ticks = BENCH_TARGET_OBJECT_TICKS / work;
+    if (ticks < BENCH_MIN_TICKS) {
+        return BENCH_MIN_TICKS;
+    }
+    return ticks > BENCH_MAX_TICKS ? BENCH_MAX_TICKS : (unsigned int)ticks;
+}
+
+static bool bench_run(const BenchConfig *config, const BenchCase *bench, BenchResult *result)
+{
+    NutmegEngine *engine = nutmeg_engine_create();
+    if (!engine) {
+        return false;
+    }
+    nutmeg_engine_set_worker_count(engine, config->workers);
+    nutmeg_engine_set_event_fusion(engine, !config->no_fusion);
+
+    NutmegScene *scene = nutmeg_engine_add_scene(engine, bench->name);
+    nutmeg_engine_set_active_scene(engine, bench->name);
+    if (!scene || !bench->setup(engine, scene, bench)) {
+        nutmeg_engine_destroy(engine);
+        free(bench_timers);
+        bench_timers = NULL;
+        return false;
+    }
+
+    for (int i = 0; i < BENCH_WARMUP_TICKS; ++i) {
+        nutmeg_engine_tick(engine, BENCH_DELTA);
+    }
+
+    if (config->no_alloc) {
+        nutmeg_engine_set_allocation_guard(engine, NUTMEG_ALLOCATION_GUARD_ABORT);
+    }
+
+    NutmegMemoryStats before;
+    NutmegMemoryStats after;
+    nutmeg_engine_memory_stats(engine, &before);
+    result->ticks = bench_tick_count(config, bench);
+    for (unsigned int i = 0; i < result->ticks; ++i) {
+        nutmeg_engine_tick(engine, BENCH_DELTA);
+    }
+    nutmeg_engine_memory_stats(engine, &after);
+
+    nutmeg_engine_tick_stats(engine, result->ticks, &result->tick_stats);
+    result->allocations_per_tick = (double)(after.allocations - before.allocations) / (double)result->ticks;
+    result->peak_bytes = after.total_peak_bytes;
+    nutmeg_engine_destroy(engine);
+    free(bench_timers);
+    bench_timers = NULL;
+    return true;
+}
+
+static void bench_write_result(FILE *out, const BenchCase *bench, const BenchResult *result, bool first)
+{
+    const NutmegTickStats *ticks = &result->tick_stats;
+    double objects = (double)(bench->objects > 0 ? bench->objects : 1);
+    double seconds = (double)ticks->mean_ns * 1e-9;
+
+    fprintf(out, "%s\n    {\n", first ? "" : ",");
+    fprintf(out, "      \"name\": \"%s\",\n", bench->name);
+    fprintf(out, "      \"objects\": %zu,\n", bench->objects);
+    fprintf(out, "      \"events\": %zu,\n", bench->events);
+    fprintf(out, "      \"ticks\": %u,\n", result->ticks);
+    fprintf(out, "      \"ns_per_tick\": %llu,\n", ticks->mean_ns);
+    fprintf(out, "      \"ns_per_object_tick\": %.3f,\n", (double)ticks->mean_ns / objects);
+    fprintf(out, "      \"tick_p50_ns\": %llu,\n", ticks->p50_ns);
+    fprintf(out, "      \"tick_p99_ns\": %llu,\n", ticks->p99_ns);
+    fprintf(out, "      \"tick_max_ns\": %llu,\n", ticks->max_ns);
+    fprintf(out, "      \"object_ticks_per_second\": %.0f,\n", seconds > 0.0 ? objects / seconds : 0.0);
+    fprintf(out, "      \"allocations_per_tick\": %.3f,\n", result->allocations_per_tick);
+    fprintf(out, "      \"peak_bytes\": %zu\n", result->peak_bytes);
+    fprintf(out, "    }");
+}
+
+static void bench_usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [--filter TEXT] [--ticks N] [--max-objects N] [--workers N] [--output FILE] [--no-alloc] [--no-fusion] [--list]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    config.filter = NULL;
+    config.ticks = 0;
+    config.max_objects = 1000000;
+    config.workers = 1;
+    config.output = NULL;
+    config.no_alloc = false;
+    config.no_fusion = false;
+
+    size_t case_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--list") == 0) {
+            for (size_t c = 0; c < case_count; ++c) {
+                printf("%s\n", bench_cases[c].name);
+            }
+            return 0;
+        }
+        if (strcmp(arg, "--no-alloc") == 0) {
+            config.no_alloc = true;
+            continue;
+        }
+        if (strcmp(arg, "--no-fusion") == 0) {
+            config.no_fusion = true;
+            continue;
+        }
+        if (!value) {
+            bench_usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(arg, "--filter") == 0) {
+            config.filter = value;
+        } else if (strcmp(arg, "--ticks") == 0) {
+            config.ticks = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--max-objects") == 0) {
+            config.max_objects = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--workers") == 0) {
+            config.workers = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--output") == 0) {
+            config.output = value;
+        } else {
+            bench_usage(argv[0]);
+            return 2;
+        }
+        ++i;
+    }
+
+    FILE *out = stdout;
+    if (config.output) {
+        out = fopen(config.output, "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s\n", config.output);
+            return 1;
+        }
+    }
+
+    fprintf(out, "{\n  \"suite\": \"nutmeg_bench\",\n  \"workers\": %u,\n  \"results\": [", config.workers);
+    bool first = true;
+    int status = 0;
+    for (size_t c = 0; c < case_count; ++c) {
+        const BenchCase *bench = &bench_cases[c];
+        if (bench->objects > config.max_objects || (config.filter && !strstr(bench->name, config.filter))) {
+            continue;
+        }
+
+        fprintf(stderr, "running %s\n", bench->name);
+        BenchResult result;
+        if (!bench_run(&config, bench, &result)) {
+            fprintf(stderr, "%s failed\n", bench->name);
+            status = 1;
+            continue;
+        }
+        bench_write_result(out, bench, &result, first);
+        first = false;
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return status;
+}
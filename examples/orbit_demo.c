@@ -1,27 +1,8 @@
 #include <stdio.h>
-#include <string.h>
 
 #include "nutmeg_engine.h"
 #include "nutmeg_builtin.h"
 
-typedef struct NameFilter {
-    const char *name;
-} NameFilter;
-
-static bool condition_name_equals(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
-{
-    (void)engine;
-    (void)scene;
-
-    if (!object || !userdata) {
-        return false;
-    }
-
-    const NameFilter *filter = (const NameFilter *)userdata;
-    const char *name = nutmeg_object_name(object);
-    return name && strcmp(name, filter->name) == 0;
-}
-
 static void action_log_position(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
 {
     (void)engine;
@@ -59,27 +40,25 @@ int main(void)
 
     /* Event: integrate velocity for all objects each tick */
     NutmegEvent integrate = nutmeg_event_make("Integrate", NUTMEG_EVENT_SCOPE_OBJECTS, false);
-    nutmeg_event_add_action(&integrate, nutmeg_action_integrate, NULL);
+    nutmeg_event_add_action_batch(&integrate, nutmeg_action_integrate_batch, nutmeg_action_integrate, NULL);
     nutmeg_scene_add_event(scene, integrate);
 
     /* Event: accelerate the player every second */
-    static NameFilter player_filter = {"Player"};
     static NutmegTimer player_timer = {1.0f, 0.0f, true};
     static NutmegVelocityChange speed_boost = {{0.25f, 0.0f}};
 
     NutmegEvent accelerate = nutmeg_event_make("Boost", NUTMEG_EVENT_SCOPE_OBJECTS, false);
-    nutmeg_event_add_condition(&accelerate, condition_name_equals, &player_filter);
+    accelerate.query.name = nutmeg_engine_intern(engine, "Player");
     nutmeg_event_add_condition(&accelerate, nutmeg_condition_timer, &player_timer);
     nutmeg_event_add_action(&accelerate, nutmeg_action_add_velocity, &speed_boost);
     nutmeg_event_add_action(&accelerate, nutmeg_action_debug_print, "Speed boost!");
     nutmeg_scene_add_event(scene, accelerate);
 
     /* Event: log satellite position every half second */
-    static NameFilter satellite_filter = {"Satellite"};
     static NutmegTimer satellite_timer = {0.5f, 0.0f, true};
 
     NutmegEvent log_satellite = nutmeg_event_make("LogSatellite", NUTMEG_EVENT_SCOPE_OBJECTS, false);
-    nutmeg_event_add_condition(&log_satellite, condition_name_equals, &satellite_filter);
+    log_satellite.query.name = nutmeg_engine_intern(engine, "Satellite");
     nutmeg_event_add_condition(&log_satellite, nutmeg_condition_timer, &satellite_timer);
     nutmeg_event_add_action(&log_satellite, action_log_position, NULL);
     nutmeg_scene_add_event(scene, log_satellite);
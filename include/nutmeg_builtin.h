@@ -30,6 +30,51 @@ static inline NutmegTimer nutmeg_timer_make(float interval, bool repeat)
 /** Condition returning true when the timer interval has elapsed. */
 bool nutmeg_condition_timer(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
 
+/** Payload for name based conditions; fill it with nutmeg_engine_intern. */
+typedef struct NutmegNameFilter {
+    NutmegSymbol name;
+} NutmegNameFilter;
+
+/** Condition returning true for objects whose interned name matches the filter. Pure. */
+bool nutmeg_condition_name_is(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
+
+/** Batch variant of nutmeg_condition_name_is comparing the span's name column. */
+void nutmeg_condition_name_is_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, unsigned char *mask, void *userdata);
+
+/** Payload for nutmeg_condition_within_radius. */
+typedef struct NutmegProximity {
+    NutmegObjectQuery target; /**< Objects to look for; a zeroed query matches any. */
+    float radius;
+} NutmegProximity;
+
+/**
+ * Condition returning true when another object matching the target lies
+ * within radius of the object. Uses the scene's spatial index. Pure.
+ */
+bool nutmeg_condition_within_radius(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
+
+/**
+ * Condition returning true when the object's collision circle overlaps the
+ * circle of another object (see nutmeg_object_set_radius). The payload is an
+ * optional NutmegObjectQuery restricting the other objects. Pure.
+ */
+bool nutmeg_condition_overlaps(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
+
+/** Payload for nutmeg_condition_nearest. */
+typedef struct NutmegNearest {
+    NutmegObjectQuery target; /**< Objects to look for; a zeroed query matches any. */
+    float max_distance;
+    NutmegObjectHandle nearest; /**< Output: the object found by the last evaluation. */
+} NutmegNearest;
+
+/**
+ * Condition returning true when an object matching the target lies within
+ * max_distance. The closest one is stored in the payload's nearest handle for
+ * the actions that follow, so the payload must not be shared by parallel
+ * events.
+ */
+bool nutmeg_condition_nearest(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
+
 /** Action that integrates velocity onto an object's position. */
 void nutmeg_action_integrate(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
 
@@ -52,6 +97,20 @@ typedef struct NutmegTranslation {
 /** Action that directly moves an object by the delta vector. */
 void nutmeg_action_translate(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
 
+/**
+ * Batch variants of the motion actions above for use with
+ * nutmeg_event_add_action_batch. They take the same payloads and update every
+ * selected object of the span using SSE2/AVX2 kernels chosen at runtime, with
+ * results bit-identical to the per-object actions.
+ */
+void nutmeg_action_integrate_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata);
+void nutmeg_action_accelerate_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata);
+void nutmeg_action_add_velocity_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata);
+void nutmeg_action_translate_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata);
+
+/** Instruction set used by the batch kernels: "avx2", "sse2" or "scalar". */
+const char *nutmeg_builtin_simd_backend(void);
+
 /** Action that prints a textual message for debugging purposes. */
 void nutmeg_action_debug_print(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata);
 
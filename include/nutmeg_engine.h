@@ -32,15 +32,144 @@ typedef struct NutmegVec2 {
 /**
  * Runtime performance telemetry exposed by the engine.
  *
- * The metrics values are normalised to the range [0, 100] and represent
- * percentage style gauges suitable for driving editor visualisations.
+ * The usage values are normalised to the range [0, 100] and represent
+ * percentage style gauges suitable for driving editor visualisations. The
+ * tick percentiles cover the last nutmeg_engine_set_tick_window ticks.
  */
 typedef struct NutmegEngineMetrics {
     float cpu_usage; /**< Estimated CPU utilisation percentage. */
-    float ram_usage; /**< Estimated RAM usage percentage. */
-    float gpu_usage; /**< Estimated GPU utilisation percentage. */
+    float ram_usage; /**< Live engine memory as a percentage of memory_budget. */
+    size_t memory_live;   /**< Bytes currently allocated by the engine. */
+    size_t memory_peak;   /**< Highest memory_live seen so far. */
+    size_t memory_budget; /**< Budget ram_usage is measured against. */
+    float tick_p50_ms;    /**< Median wall time of nutmeg_engine_tick. */
+    float tick_p95_ms;
+    float tick_p99_ms;
+    float tick_max_ms;
+    size_t frame_arena_peak;     /**< Most frame arena bytes used by a single tick. */
+    size_t frame_arena_capacity; /**< Bytes the frame arena currently holds in pages. */
 } NutmegEngineMetrics;
 
+/**
+ * Distribution of nutmeg_engine_tick wall times. Percentiles come from a
+ * log-linear histogram and overestimate by at most 1/16 of the value; the
+ * mean and maximum are exact.
+ */
+typedef struct NutmegTickStats {
+    unsigned long long count; /**< Ticks summarised. */
+    unsigned long long mean_ns;
+    unsigned long long p50_ns;
+    unsigned long long p95_ns;
+    unsigned long long p99_ns;
+    unsigned long long max_ns;
+} NutmegTickStats;
+
+/** Groups engine allocations are accounted under. */
+typedef enum NutmegMemoryCategory {
+    NUTMEG_MEMORY_ENGINE,      /**< Engine and scene bookkeeping, interned strings. */
+    NUTMEG_MEMORY_OBJECTS,     /**< Pooled object chunks. */
+    NUTMEG_MEMORY_INDEXES,     /**< Dense object array, free list, id map, name and query lists. */
+    NUTMEG_MEMORY_EVENTS,      /**< Events, their condition/action arrays and profiling counters. */
+    NUTMEG_MEMORY_COMMANDS,    /**< Deferred spawn/destroy command buffers. */
+    NUTMEG_MEMORY_SPATIAL,     /**< Spatial index. */
+    NUTMEG_MEMORY_FRAME,       /**< Frame arena pages. */
+    NUTMEG_MEMORY_CHECKPOINTS, /**< Scene checkpoint ring and its deltas. */
+    NUTMEG_MEMORY_CATEGORY_COUNT
+} NutmegMemoryCategory;
+
+/**
+ * Byte counters of an engine or a scene, maintained incrementally as memory
+ * is allocated and freed. Peaks are high-water marks since creation;
+ * total_peak_bytes is the peak of the sum, not the sum of the peaks.
+ */
+typedef struct NutmegMemoryStats {
+    size_t live_bytes[NUTMEG_MEMORY_CATEGORY_COUNT];
+    size_t peak_bytes[NUTMEG_MEMORY_CATEGORY_COUNT];
+    size_t total_live_bytes;
+    size_t total_peak_bytes;
+    unsigned long long allocations; /**< Allocation and reallocation calls since creation. */
+} NutmegMemoryStats;
+
+/**
+ * Memory hooks used for every allocation an engine makes. Sizes are passed
+ * back on realloc and free so sized allocators need no headers. realloc may
+ * be NULL, in which case alloc, a copy and free are used instead.
+ *
+ * Returning NULL fails the call that needed the memory wherever the API can
+ * say so: engine and scene creation, background loads, tracing and frame
+ * allocations return NULL or false, a spawn that needs a new chunk or a
+ * larger id map returns NULL, and interning returns NUTMEG_SYMBOL_NONE.
+ * Growing a scene's internal arrays, adding an event, flushing deferred
+ * spawns and destroys, and rebuilding the id map or spatial index on restore
+ * or query have no way to report it and abort the process.
+ */
+typedef struct NutmegAllocator {
+    void *(*alloc)(void *context, size_t size);
+    void *(*realloc)(void *context, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *context, void *ptr, size_t size);
+    void *context;
+} NutmegAllocator;
+
+/** How an engine reacts to allocations made while nutmeg_engine_tick runs. */
+typedef enum NutmegAllocationGuard {
+    NUTMEG_ALLOCATION_GUARD_OFF,
+    NUTMEG_ALLOCATION_GUARD_COUNT, /**< Count them, see nutmeg_engine_guarded_allocations. */
+    NUTMEG_ALLOCATION_GUARD_ABORT  /**< Abort the process at the offending allocation. */
+} NutmegAllocationGuard;
+
+/**
+ * Profiling counters of one event, accumulated while profiling is enabled.
+ * A target is an object for OBJECTS-scope events and the scene otherwise.
+ */
+typedef struct NutmegEventProfile {
+    unsigned long long runs;     /**< Ticks in which the event was evaluated. */
+    unsigned long long triggers; /**< Ticks in which its actions ran for at least one target. */
+    unsigned long long time_ns;  /**< Wall time spent evaluating the event. */
+    unsigned long long tested;   /**< Targets checked against the conditions. */
+    unsigned long long passed;   /**< Targets that passed every condition. */
+} NutmegEventProfile;
+
+/**
+ * Profiling counters of one condition or action slot. For conditions
+ * passed / tested is the slot's pass rate; actions pass every target.
+ */
+typedef struct NutmegSlotProfile {
+    unsigned long long calls;   /**< Callback invocations (per target, or per span for batch calls). */
+    unsigned long long tested;  /**< Targets handed to the slot. */
+    unsigned long long passed;  /**< Targets still selected after the slot. */
+    unsigned long long time_ns; /**< Wall time spent inside the callback. */
+} NutmegSlotProfile;
+
+/**
+ * Interned string. Object names are interned into engine-wide symbols at
+ * spawn time so they can be compared and indexed as integers.
+ */
+typedef unsigned int NutmegSymbol;
+
+/** Symbol of the empty string; unnamed objects carry it. */
+#define NUTMEG_SYMBOL_NONE 0u
+
+/**
+ * Generational reference to an object. Unlike raw NutmegObject pointers a
+ * handle can be validated after the object has been destroyed: once its slot
+ * is reused the generation no longer matches and resolving it yields NULL.
+ * A zero generation denotes the null handle.
+ */
+typedef struct NutmegObjectHandle {
+    unsigned int index;      /**< Slot index inside the owning scene. */
+    unsigned int generation; /**< Slot generation captured at creation. */
+} NutmegObjectHandle;
+
+/**
+ * Generational reference to a scene registered with an engine. It stays
+ * valid while other scenes are added and removed, and stops resolving once
+ * its scene is removed. A zero generation denotes the null handle.
+ */
+typedef struct NutmegSceneHandle {
+    unsigned int index;      /**< Slot index inside the engine's scene registry. */
+    unsigned int generation; /**< Slot generation captured at registration. */
+} NutmegSceneHandle;
+
 /** Engine level pointer type aliases to make the API more readable. */
 typedef struct NutmegEngine NutmegEngine;
 typedef struct NutmegScene NutmegScene;
@@ -59,15 +188,65 @@ typedef bool (*NutmegConditionFn)(NutmegEngine *, NutmegScene *, NutmegObject *,
  */
 typedef void (*NutmegActionFn)(NutmegEngine *, NutmegScene *, NutmegObject *, void *userdata);
 
+/**
+ * Contiguous run of objects handed to batch callbacks. Entry i describes the
+ * object returned by nutmeg_span_object(span, i); ids[i], positions[i] and
+ * velocities[i] alias that object's data. Entries whose selection mask byte is
+ * zero may be dead slots and must be left untouched.
+ */
+typedef struct NutmegObjectSpan {
+    NutmegObject *objects; /**< Opaque; use nutmeg_span_object to index. */
+    const unsigned long *ids;
+    const NutmegSymbol *names;
+    NutmegVec2 *positions;
+    NutmegVec2 *velocities;
+    size_t count;
+} NutmegObjectSpan;
+
+/**
+ * Batch condition evaluated over a whole span at once. On entry mask[i] is
+ * non-zero for every object still selected; the callback clears the bytes of
+ * objects that fail and must never set a cleared byte.
+ */
+typedef void (*NutmegConditionBatchFn)(NutmegEngine *, NutmegScene *, const NutmegObjectSpan *span, unsigned char *mask, void *userdata);
+
+/** Batch action applied to every object of the span whose mask byte is non-zero. */
+typedef void (*NutmegActionBatchFn)(NutmegEngine *, NutmegScene *, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata);
+
+/** Optional behaviour flags stored in NutmegCondition::flags. */
+typedef enum NutmegConditionFlags {
+    /**
+     * The condition has no side effects and its result does not depend on
+     * how often it was evaluated, so adaptive ordering (see
+     * nutmeg_engine_set_adaptive_conditions) may move it among neighbouring
+     * pure conditions. Stateful conditions such as nutmeg_condition_timer or
+     * nutmeg_condition_nearest must not be marked.
+     */
+    NUTMEG_CONDITION_FLAG_PURE = 1 << 0,
+    /**
+     * The result depends neither on the object nor on anything the scene's
+     * actions change during a tick, e.g. a game mode switch. When such
+     * conditions lead an event's list they are evaluated once per tick with
+     * a NULL object before any target is visited, and consecutive events
+     * starting with the same invariant conditions share that evaluation.
+     * Needs a per-object fn; batch-only conditions are never hoisted.
+     */
+    NUTMEG_CONDITION_FLAG_INVARIANT = 1 << 1
+} NutmegConditionFlags;
+
 /** Wrapper storing a condition callback and its payload. */
 typedef struct NutmegCondition {
     NutmegConditionFn fn;
+    NutmegConditionBatchFn batch; /**< Optional span variant of fn. */
     void *userdata;
+    unsigned int flags;           /**< Combination of NutmegConditionFlags. */
+    size_t state_size;            /**< Bytes at userdata saved by scene checkpoints (0 for none). */
 } NutmegCondition;
 
 /** Wrapper storing an action callback and its payload. */
 typedef struct NutmegAction {
     NutmegActionFn fn;
+    NutmegActionBatchFn batch; /**< Optional span variant of fn. */
     void *userdata;
 } NutmegAction;
 
@@ -81,12 +260,47 @@ typedef enum NutmegEventScope {
     NUTMEG_EVENT_SCOPE_OBJECTS
 } NutmegEventScope;
 
+/** Optional behaviour flags stored in NutmegEvent::flags. */
+typedef enum NutmegEventFlags {
+    /**
+     * The event's conditions and actions only read and write the object they
+     * are invoked for, so an OBJECTS-scope pass may be split across the
+     * engine's worker threads (see nutmeg_engine_set_worker_count). Callbacks
+     * must not touch shared state without their own synchronisation.
+     * Implies NUTMEG_EVENT_FLAG_LOCAL.
+     */
+    NUTMEG_EVENT_FLAG_PARALLEL = 1 << 0,
+    /**
+     * The event's conditions and actions only read and write the object they
+     * are invoked for, but need not be thread safe. Consecutive OBJECTS-scope
+     * events flagged LOCAL (or PARALLEL) with the same query are fused into a
+     * single pass that applies all of them, in order, to each object before
+     * moving on to the next (see nutmeg_engine_set_event_fusion).
+     */
+    NUTMEG_EVENT_FLAG_LOCAL = 1 << 1
+} NutmegEventFlags;
+
+/**
+ * Declarative target filter of an OBJECTS-scope event. Zero fields match
+ * anything, so a zeroed query visits every live object. The scene keeps the
+ * set of objects matching each query used by its events up to date as
+ * objects spawn, despawn or change tags, and the tick only visits those
+ * objects instead of rejecting the rest with per-object conditions.
+ */
+typedef struct NutmegObjectQuery {
+    NutmegSymbol name;       /**< Required interned name (NUTMEG_SYMBOL_NONE for any). */
+    unsigned long long tags; /**< Tag bits that must all be set (see nutmeg_engine_tag). */
+    unsigned int type_id;    /**< Required userdata type id (0 for any). */
+} NutmegObjectQuery;
+
 /** Defines a GDevelop/Clickteam style event. */
 typedef struct NutmegEvent {
     const char *name;          /**< Optional debug name. */
     NutmegEventScope scope;    /**< Dispatch target. */
     bool once;                 /**< If true, run at most a single time. */
     bool triggered;            /**< Internal flag to honour once semantics. */
+    unsigned int flags;        /**< Combination of NutmegEventFlags. */
+    NutmegObjectQuery query;   /**< Objects visited by OBJECTS-scope events. */
     NutmegCondition *conditions; /**< Dynamic array of conditions. */
     size_t condition_count;
     size_t condition_capacity;
@@ -100,6 +314,25 @@ typedef struct NutmegEvent {
  */
 NutmegEngine *nutmeg_engine_create(void);
 
+/**
+ * Allocate an engine whose memory, including scenes, objects, indexes and
+ * worker pool bookkeeping, all comes from allocator. The hooks are copied;
+ * their context must outlive the engine. Returns NULL when the hooks are
+ * incomplete or the engine cannot be allocated.
+ */
+NutmegEngine *nutmeg_engine_create_with_allocator(const NutmegAllocator *allocator);
+
+/**
+ * Guard the tick against allocations. Enable it once the scenes are warmed
+ * up to prove steady-state ticks never reach the allocator: in COUNT mode
+ * offending allocations are tallied, in ABORT mode the first one aborts so
+ * a debugger stops at its call site.
+ */
+void nutmeg_engine_set_allocation_guard(NutmegEngine *engine, NutmegAllocationGuard guard);
+
+/** Number of allocations made during ticks while the guard was counting. */
+unsigned long long nutmeg_engine_guarded_allocations(const NutmegEngine *engine);
+
 /** Destroy an engine created with nutmeg_engine_create. */
 void nutmeg_engine_destroy(NutmegEngine *engine);
 
@@ -123,36 +356,401 @@ float nutmeg_engine_last_delta(const NutmegEngine *engine);
  */
 const NutmegEngineMetrics *nutmeg_engine_metrics(const NutmegEngine *engine);
 
-/** Create and register a new scene with the engine. */
+/** Number of recent tick durations the engine keeps. */
+#define NUTMEG_TICK_HISTORY_CAPACITY 4096
+
+/** Default number of ticks the NutmegEngineMetrics percentiles cover. */
+#define NUTMEG_TICK_WINDOW_DEFAULT 120
+
+/** Set how many recent ticks the NutmegEngineMetrics percentiles cover (at most NUTMEG_TICK_HISTORY_CAPACITY). */
+void nutmeg_engine_set_tick_window(NutmegEngine *engine, size_t ticks);
+
+/**
+ * Summarise the durations of the last window ticks, or of every tick since
+ * the engine was created when window is 0. Never blocks the ticking thread,
+ * so it may be called from any thread while the engine runs.
+ */
+bool nutmeg_engine_tick_stats(const NutmegEngine *engine, size_t window, NutmegTickStats *out_stats);
+
+/**
+ * Copy up to capacity of the most recent tick durations in nanoseconds,
+ * oldest first. Safe to call from any thread. Returns the number copied.
+ */
+size_t nutmeg_engine_tick_history(const NutmegEngine *engine, unsigned long long *out_durations_ns, size_t capacity);
+
+/** Default size of the record pool used by nutmeg_engine_trace_start. */
+#define NUTMEG_TRACE_BUFFER_DEFAULT ((size_t)8 * 1024 * 1024)
+
+/**
+ * Record the next tick_count ticks (0 records until stopped) to a Chrome
+ * trace event JSON file, viewable in chrome://tracing or Perfetto. Ticks
+ * show up as nested spans: nutmeg_engine_tick, the scene, each event and
+ * each chunk or query batch it ran over, including those run by workers,
+ * plus a per-scene object count counter.
+ *
+ * Records go into a pool of buffer_bytes (0 selects
+ * NUTMEG_TRACE_BUFFER_DEFAULT) allocated here and are written out by a
+ * background thread. If the writer falls behind, records are dropped
+ * rather than delaying the tick. A trace already open is stopped first.
+ */
+bool nutmeg_engine_trace_start(NutmegEngine *engine, const char *path, unsigned int tick_count, size_t buffer_bytes);
+
+/** Stop tracing, wait for pending records to be written and close the file. Returns the number of dropped records. */
+unsigned long long nutmeg_engine_trace_stop(NutmegEngine *engine);
+
+/** Returns true while ticks are being recorded. */
+bool nutmeg_engine_tracing(const NutmegEngine *engine);
+
+/** Default memory budget reported in NutmegEngineMetrics. */
+#define NUTMEG_MEMORY_BUDGET_DEFAULT ((size_t)256 * 1024 * 1024)
+
+/** Set the byte budget NutmegEngineMetrics::ram_usage is measured against. */
+void nutmeg_engine_set_memory_budget(NutmegEngine *engine, size_t budget_bytes);
+
+/** Read the memory counters of the whole engine, scenes included. */
+bool nutmeg_engine_memory_stats(const NutmegEngine *engine, NutmegMemoryStats *out_stats);
+
+/** Read the memory counters of one scene. */
+bool nutmeg_scene_memory_stats(const NutmegScene *scene, NutmegMemoryStats *out_stats);
+
+/**
+ * Enable or disable the event profiler. While enabled every event and
+ * condition/action slot of the ticking scenes records wall time from a
+ * monotonic nanosecond clock, invocation counts and pass rates. Disabled
+ * profiling costs one branch per event and target.
+ */
+void nutmeg_engine_set_profiling(NutmegEngine *engine, bool enabled);
+
+/** True while the event profiler is enabled. */
+bool nutmeg_engine_profiling(const NutmegEngine *engine);
+
+/** Zero the profiling counters of every scene. */
+void nutmeg_engine_reset_profile(NutmegEngine *engine);
+
+/** Number of events registered with a scene; events are indexed in insertion order. */
+size_t nutmeg_scene_event_count(const NutmegScene *scene);
+
+/** Read the counters of an event. Returns false for an invalid index. */
+bool nutmeg_scene_event_profile(const NutmegScene *scene, size_t event_index, NutmegEventProfile *out_profile);
+
+/** Read the counters of a condition slot of an event. Returns false for an invalid index. */
+bool nutmeg_scene_condition_profile(const NutmegScene *scene, size_t event_index, size_t condition_index, NutmegSlotProfile *out_profile);
+
+/** Read the counters of an action slot of an event. Returns false for an invalid index. */
+bool nutmeg_scene_action_profile(const NutmegScene *scene, size_t event_index, size_t action_index, NutmegSlotProfile *out_profile);
+
+/** Pass to nutmeg_engine_set_worker_count to use one worker per hardware thread. */
+#define NUTMEG_WORKER_COUNT_AUTO 0u
+
+/**
+ * Configure parallel event dispatch. With a worker count above one, events
+ * flagged NUTMEG_EVENT_FLAG_PARALLEL split their object range across a pool of
+ * that many threads (the ticking thread included); every event still finishes
+ * before the next one starts. A count of one restores sequential dispatch.
+ * Returns false if the worker threads could not be started.
+ */
+bool nutmeg_engine_set_worker_count(NutmegEngine *engine, unsigned int worker_count);
+
+/** Number of threads used for parallel events (1 when disabled). */
+unsigned int nutmeg_engine_worker_count(const NutmegEngine *engine);
+
+/** Ticks between the samples adaptive condition ordering takes of each event. */
+#define NUTMEG_CONDITION_SAMPLE_INTERVAL 32
+
+/**
+ * Enable or disable adaptive condition ordering. Every
+ * NUTMEG_CONDITION_SAMPLE_INTERVAL ticks each event is evaluated with
+ * per-condition timing, and every run of consecutive conditions flagged
+ * NUTMEG_CONDITION_FLAG_PURE is re-sorted so the cheapest and most selective
+ * ones run first. Unflagged conditions keep their position, so stateful
+ * conditions see the same targets as before. Disabling keeps the current
+ * order. Profiling and condition indexes always refer to insertion order.
+ */
+void nutmeg_engine_set_adaptive_conditions(NutmegEngine *engine, bool enabled);
+
+/** True while adaptive condition ordering is enabled. */
+bool nutmeg_engine_adaptive_conditions(const NutmegEngine *engine);
+
+/** Most consecutive events the compiler fuses into a single pass. */
+#define NUTMEG_EVENT_FUSE_MAX 16
+
+/**
+ * Enable or disable fusion of consecutive NUTMEG_EVENT_FLAG_LOCAL events
+ * (enabled by default). A fused run is only split across the worker pool
+ * when every event in it is flagged NUTMEG_EVENT_FLAG_PARALLEL. While the
+ * profiler records, or on ticks that sample the conditions of one of its
+ * events, a run is dispatched one event at a time so each keeps its own
+ * timings.
+ */
+void nutmeg_engine_set_event_fusion(NutmegEngine *engine, bool enabled);
+
+/** True when consecutive local events are fused. */
+bool nutmeg_engine_event_fusion(const NutmegEngine *engine);
+
+/**
+ * Intern a string into an engine-wide symbol. Returns NUTMEG_SYMBOL_NONE for
+ * NULL or empty strings. Interning is thread-safe.
+ */
+NutmegSymbol nutmeg_engine_intern(NutmegEngine *engine, const char *string);
+
+/** Lookup the symbol of a string without interning it (NUTMEG_SYMBOL_NONE when absent). */
+NutmegSymbol nutmeg_engine_find_symbol(NutmegEngine *engine, const char *string);
+
+/** Retrieve the string of a symbol, or NULL for unknown symbols. */
+const char *nutmeg_engine_symbol_name(NutmegEngine *engine, NutmegSymbol symbol);
+
+/** Number of distinct tags an engine can hand out. */
+#define NUTMEG_TAG_CAPACITY 64
+
+/**
+ * Retrieve the bit of a named tag, assigning the next free bit on first use.
+ * Returns 0 for NULL or empty names and once all NUTMEG_TAG_CAPACITY tags
+ * are taken. Tag bits are shared by every scene of the engine.
+ */
+unsigned long long nutmeg_engine_tag(NutmegEngine *engine, const char *tag);
+
+/**
+ * Create and register a new scene with the engine. Scenes are indexed by
+ * name, so a non-empty name must not be in use by another scene; NULL is
+ * returned when it is. Scenes with an empty (or NULL) name can only be
+ * reached through their pointer or handle.
+ */
 NutmegScene *nutmeg_engine_add_scene(NutmegEngine *engine, const char *name);
 
-/** Lookup a scene by name. Returns NULL when missing. */
+/**
+ * Unregister a scene and release everything it owns. Its handles stop
+ * resolving, and when it was the active scene no scene is active
+ * afterwards. Returns false for a scene of another engine, or when called
+ * while scenes are ticking.
+ */
+bool nutmeg_engine_remove_scene(NutmegEngine *engine, NutmegScene *scene);
+
+/** Lookup a scene by name in O(1). Returns NULL when missing. */
 NutmegScene *nutmeg_engine_find_scene(NutmegEngine *engine, const char *name);
 
+/** Number of scenes registered with the engine. */
+size_t nutmeg_engine_scene_count(const NutmegEngine *engine);
+
+/** Capture the handle of a registered scene. */
+NutmegSceneHandle nutmeg_scene_handle(const NutmegScene *scene);
+
+/** Resolve a scene handle, or NULL once the scene was removed. */
+NutmegScene *nutmeg_engine_resolve_scene(NutmegEngine *engine, NutmegSceneHandle handle);
+
+/** Name a scene was registered under ("" when unnamed). */
+const char *nutmeg_scene_name(const NutmegScene *scene);
+
+/**
+ * Builds a scene on the loader thread: spawn objects, add events, load a
+ * snapshot. The scene is not registered yet, so nothing else touches it.
+ * The engine may only be used to intern names and tags; its other scenes
+ * keep ticking meanwhile. nutmeg_scene_set_schedule may be called on the
+ * scene and takes effect when it is published. Return false to discard the
+ * scene.
+ */
+typedef bool (*NutmegSceneBuildFn)(NutmegEngine *engine, NutmegScene *scene, void *userdata);
+
+/** Receives a loaded scene on the ticking thread, or NULL when the load failed. */
+typedef void (*NutmegSceneLoadedFn)(NutmegEngine *engine, NutmegScene *scene, void *userdata);
+
+/**
+ * Build a scene in the background. The scene is created right away, handed
+ * to build on the engine's loader thread, and registered at the first call
+ * to nutmeg_engine_tick after build returns, before that tick's steps, so a
+ * scene never appears halfway through a tick. loaded (which may be NULL)
+ * then runs on the ticking thread; it can activate the scene, which then
+ * ticks in that same call. Loads are built one at a time, in order. The
+ * load fails when build returns false or the name was taken meanwhile.
+ * Returns false when the name is in use by a scene or a pending load, when
+ * called while scenes are ticking, or when the loader thread could not be
+ * started. Names and tags interned by build
+ * for the first time are engine memory and count against the allocation
+ * guard; the rest of the scene's memory is charged to the engine when it
+ * is registered.
+ */
+bool nutmeg_engine_load_scene_async(NutmegEngine *engine, const char *name, NutmegSceneBuildFn build, NutmegSceneLoadedFn loaded, void *userdata);
+
+/** Number of background loads not registered yet. */
+size_t nutmeg_engine_pending_scene_loads(const NutmegEngine *engine);
+
+/**
+ * Wait for every background load to be built and register them now, for
+ * loading screens and shutdown. Must not be called from inside a tick.
+ * nutmeg_engine_destroy discards unfinished loads without calling loaded.
+ */
+void nutmeg_engine_finish_scene_loads(NutmegEngine *engine);
+
 /** Activate the named scene. */
 bool nutmeg_engine_set_active_scene(NutmegEngine *engine, const char *name);
 
+/** Activate the scene a handle refers to. Returns false for a stale handle. */
+bool nutmeg_engine_activate_scene(NutmegEngine *engine, NutmegSceneHandle handle);
+
 /** Retrieve the currently active scene (may be NULL). */
 NutmegScene *nutmeg_engine_get_active_scene(NutmegEngine *engine);
 
-/** Spawn a new object inside a scene. */
+/**
+ * Schedule a scene to keep simulating in the background. Each engine step
+ * (every fixed step when a fixed timestep is set) ticks the active scene,
+ * then every scene whose rate_divider steps have elapsed, with the time of
+ * all of those steps as its delta. Scenes due in the same step tick in
+ * descending priority order; equal priorities keep the order they were
+ * scheduled in. A rate_divider of 0 takes the scene off the schedule, so it
+ * only ticks while it is active. The active scene ticks on every step
+ * whatever its divider. Returns false when called while scenes are ticking,
+ * except from a NutmegSceneBuildFn on the scene it builds.
+ */
+bool nutmeg_scene_set_schedule(NutmegScene *scene, unsigned int rate_divider, int priority);
+
+/** Rate divider of a scene (0 when it only ticks while active). */
+unsigned int nutmeg_scene_rate_divider(const NutmegScene *scene);
+
+/** Priority of a scene within a step. */
+int nutmeg_scene_priority(const NutmegScene *scene);
+
+/**
+ * Time simulated by the scene's current or most recent tick. Equals
+ * nutmeg_engine_last_delta for the active scene; a background scene sees
+ * the time of every step it waited. The builtins use this delta.
+ */
+float nutmeg_scene_last_delta(const NutmegScene *scene);
+
+/**
+ * Tick the scenes due in the same step concurrently, one per worker of the
+ * pool (see nutmeg_engine_set_worker_count); disabled by default. Scenes
+ * share no objects, but their callbacks then run on worker threads and must
+ * not touch other scenes or add scenes to the engine. The parallel events
+ * of a scene ticked this way run on its worker alone.
+ */
+void nutmeg_engine_set_concurrent_scenes(NutmegEngine *engine, bool enabled);
+
+/** True when due scenes tick concurrently. */
+bool nutmeg_engine_concurrent_scenes(const NutmegEngine *engine);
+
+/**
+ * Spawn a new object inside a scene.
+ *
+ * When called while the scene is ticking (for example from an action) the
+ * spawn is recorded in the scene's command buffer and applied once the tick
+ * finishes. The returned object can be configured immediately but is not
+ * visited by events, enumerated or found by id until then.
+ */
 NutmegObject *nutmeg_scene_spawn_object(NutmegScene *scene, const char *name);
 
-/** Destroy an object created inside the given scene. */
+/**
+ * Destroy an object created inside the given scene. Destroys issued while the
+ * scene is ticking hide the object from the remainder of the tick and release
+ * it at the end of the tick.
+ */
 void nutmeg_scene_destroy_object(NutmegScene *scene, NutmegObject *object);
 
 /** Retrieve a stable identifier for an object. */
 unsigned long nutmeg_object_id(const NutmegObject *object);
 
+/** Lookup a live object by its identifier in O(1). Returns NULL when missing. */
+NutmegObject *nutmeg_scene_find_object(NutmegScene *scene, unsigned long id);
+
+/** Capture a generational handle for a live object (null handle otherwise). */
+NutmegObjectHandle nutmeg_object_handle(const NutmegObject *object);
+
+/** Resolve a handle to its object, or NULL when the object no longer exists. */
+NutmegObject *nutmeg_scene_resolve_handle(NutmegScene *scene, NutmegObjectHandle handle);
+
+/** Return true when the handle still refers to a live object of the scene. */
+bool nutmeg_scene_handle_valid(NutmegScene *scene, NutmegObjectHandle handle);
+
+/**
+ * Destroy the object referenced by a handle in O(1). Returns false when the
+ * handle is stale.
+ */
+bool nutmeg_scene_destroy_handle(NutmegScene *scene, NutmegObjectHandle handle);
+
 /** Query the name string associated with an object. */
 const char *nutmeg_object_name(const NutmegObject *object);
 
+/** Query the interned name of an object; compare it against nutmeg_engine_intern results. */
+NutmegSymbol nutmeg_object_name_symbol(const NutmegObject *object);
+
+/**
+ * Enumerate the live objects carrying a given name. The scene keeps one list
+ * per name up to date as objects spawn and despawn, so this is O(1). The
+ * array is owned by the scene and valid until the next structural change.
+ */
+NutmegObject **nutmeg_scene_objects_named(NutmegScene *scene, NutmegSymbol name, size_t *out_count);
+
+/**
+ * Enumerate the live objects matching a query. The scene starts tracking the
+ * query on first use (an O(n) scan) and keeps its result current from then
+ * on; queries of events added to the scene are tracked from the start. The
+ * array is owned by the scene and valid until the next structural change.
+ */
+NutmegObject **nutmeg_scene_query_objects(NutmegScene *scene, const NutmegObjectQuery *query, size_t *out_count);
+
+/**
+ * Tag bits of an object. Changes made while the scene ticks are reflected in
+ * event queries from the next tick on.
+ */
+void nutmeg_object_add_tags(NutmegObject *object, unsigned long long tags);
+void nutmeg_object_remove_tags(NutmegObject *object, unsigned long long tags);
+unsigned long long nutmeg_object_tags(const NutmegObject *object);
+
+/**
+ * Application defined type id describing the object's userdata, matched by
+ * NutmegObjectQuery::type_id. Objects start with type 0.
+ */
+void nutmeg_object_set_userdata_type(NutmegObject *object, unsigned int type_id);
+unsigned int nutmeg_object_userdata_type(const NutmegObject *object);
+
+/** Default cell edge length of a scene's spatial index. */
+#define NUTMEG_SPATIAL_CELL_SIZE_DEFAULT 64.0f
+
+/** Visitor for spatial queries; return false to stop the query early. */
+typedef bool (*NutmegObjectVisitFn)(NutmegObject *object, void *userdata);
+
 /**
- * Access mutable vector data for an object.
+ * Set the cell edge length of the scene's spatial index. Cells around the
+ * typical query radius work best.
+ *
+ * The index is a hashed uniform grid over object positions. It is rebuilt in
+ * O(n) by the first spatial query of each tick and reused by the rest of the
+ * tick, including from parallel events, so positions changed later in the
+ * same tick are only seen from the next tick on.
+ */
+void nutmeg_scene_set_spatial_cell_size(NutmegScene *scene, float cell_size);
+
+/**
+ * Visit the live objects matching filter (NULL for any) whose position lies
+ * within radius of center. Returns the number of objects visited.
+ */
+size_t nutmeg_scene_query_radius(NutmegScene *scene, NutmegVec2 center, float radius, const NutmegObjectQuery *filter, NutmegObjectVisitFn fn, void *userdata);
+
+/**
+ * Visit the live objects matching filter (NULL for any) whose collision
+ * circle overlaps the circle at center. Returns the number of objects visited.
+ */
+size_t nutmeg_scene_query_overlap(NutmegScene *scene, NutmegVec2 center, float radius, const NutmegObjectQuery *filter, NutmegObjectVisitFn fn, void *userdata);
+
+/**
+ * Find the live object matching filter (NULL for any) closest to point and
+ * no farther than max_distance, ignoring exclude. Returns NULL when none.
+ */
+NutmegObject *nutmeg_scene_nearest_object(NutmegScene *scene, NutmegVec2 point, float max_distance, const NutmegObjectQuery *filter, const NutmegObject *exclude);
+
+/** Collision radius used by overlap queries. Objects start with radius 0. */
+void nutmeg_object_set_radius(NutmegObject *object, float radius);
+float nutmeg_object_radius(const NutmegObject *object);
+
+/**
+ * Access mutable vector data for an object. Objects are stored in pooled
+ * structure-of-arrays chunks; the returned pointers stay valid until the
+ * object is destroyed.
  */
 NutmegVec2 *nutmeg_object_position(NutmegObject *object);
 NutmegVec2 *nutmeg_object_velocity(NutmegObject *object);
 
+/** Retrieve the object at an index of a batch callback span. */
+NutmegObject *nutmeg_span_object(const NutmegObjectSpan *span, size_t index);
+
 /** User storage per object. */
 void nutmeg_object_set_userdata(NutmegObject *object, void *userdata);
 void *nutmeg_object_userdata(NutmegObject *object);
@@ -160,6 +758,63 @@ void *nutmeg_object_userdata(NutmegObject *object);
 /** Retrieve a pointer to the owning scene. */
 NutmegScene *nutmeg_object_scene(NutmegObject *object);
 
+/**
+ * Write the scene's live objects to path as a binary snapshot: ids, names,
+ * positions, velocities, radii, tags and userdata type ids, plus the next
+ * id the scene hands out. Userdata pointers and events are not part of it.
+ * Returns false while the scene is ticking or when the file cannot be
+ * written.
+ */
+bool nutmeg_scene_save_snapshot(NutmegScene *scene, const char *path);
+
+/**
+ * Populate an empty scene from a snapshot file. The file is memory-mapped
+ * and its columns are copied into the object chunks a block at a time, so
+ * a load costs a handful of allocations instead of one spawn per object.
+ * Objects keep their ids; names and tags are interned into this engine, so
+ * the snapshot may come from another engine or process. Returns false,
+ * leaving the scene empty, when the scene holds objects or is ticking, or
+ * the file is not a snapshot of this format version and byte order.
+ */
+bool nutmeg_scene_load_snapshot(NutmegScene *scene, const char *path);
+
+/** nutmeg_scene_load_snapshot from a snapshot image already in memory. */
+bool nutmeg_scene_load_snapshot_memory(NutmegScene *scene, const void *data, size_t size);
+
+/** Checkpoints a scene keeps when nutmeg_scene_reserve_checkpoints was never called. */
+#define NUTMEG_CHECKPOINT_CAPACITY_DEFAULT 16
+
+/**
+ * Size the scene's checkpoint ring, dropping the checkpoints taken so far.
+ * Returns false while the scene is ticking or on allocation failure.
+ */
+bool nutmeg_scene_reserve_checkpoints(NutmegScene *scene, size_t capacity);
+
+/**
+ * Record the scene's simulation state for nutmeg_scene_restore: every
+ * object's data, ids, slots and index order, the triggered flags of the
+ * scene's events and the payloads of conditions with a state size (see
+ * nutmeg_event_set_condition_state_size; timers have one). A checkpoint
+ * stores only the bytes that changed since the previous one, in buffers
+ * that are reused once the ring wraps, so taking one per tick costs a
+ * compare pass over the object data and no allocation in steady state.
+ * When the ring is full the oldest checkpoint is dropped. Returns the
+ * checkpoint's id, or 0 while the scene is ticking or on allocation failure.
+ */
+unsigned long long nutmeg_scene_checkpoint(NutmegScene *scene);
+
+/**
+ * Return the scene to a checkpoint and drop the checkpoints taken after
+ * it; the checkpoint itself can be restored again. Objects spawned since
+ * are gone and destroyed ones are back with their ids, handles and userdata
+ * pointers, though not the memory userdata points to. Handles to objects
+ * spawned since stay stale, even once their slots are reused. Events added
+ * since keep their state. When no object was spawned, destroyed or re-tagged in
+ * between, only object data is copied back. Returns false while the scene
+ * is ticking or when the checkpoint is no longer in the ring.
+ */
+bool nutmeg_scene_restore(NutmegScene *scene, unsigned long long checkpoint_id);
+
 /**
  * Append an event to the scene. Ownership of the event structure and its
  * dynamically allocated condition/action arrays transfers to the scene. The
@@ -176,9 +831,66 @@ NutmegEvent nutmeg_event_make(const char *name, NutmegEventScope scope, bool onc
 void nutmeg_event_add_condition(NutmegEvent *event, NutmegConditionFn fn, void *userdata);
 void nutmeg_event_add_action(NutmegEvent *event, NutmegActionFn fn, void *userdata);
 
-/** Tick the engine forward by delta seconds. */
+/**
+ * Add a condition with a batch implementation. When every condition and
+ * action of an OBJECTS-scope event has a batch callback, the tick evaluates
+ * the conditions over each span of objects to build a selection mask and then
+ * runs the actions over that selection, instead of calling per object. fn is
+ * an optional per-object equivalent used otherwise; slots without one are
+ * invoked with single-object spans, and treated as passing (conditions) or
+ * skipped (actions) by events that do not target objects.
+ */
+void nutmeg_event_add_condition_batch(NutmegEvent *event, NutmegConditionBatchFn batch, NutmegConditionFn fn, void *userdata);
+
+/** Add an action with a batch implementation. See nutmeg_event_add_condition_batch. */
+void nutmeg_event_add_action_batch(NutmegEvent *event, NutmegActionBatchFn batch, NutmegActionFn fn, void *userdata);
+
+/** Set the NutmegConditionFlags of a condition already added to the event. */
+void nutmeg_event_set_condition_flags(NutmegEvent *event, size_t condition_index, unsigned int flags);
+
+/**
+ * Declare that a condition keeps state_size bytes of state in its userdata,
+ * which scene checkpoints then save and restore. Conditions added with
+ * nutmeg_condition_timer are set up for their NutmegTimer already. The
+ * payload must outlive the scene's checkpoints.
+ */
+void nutmeg_event_set_condition_state_size(NutmegEvent *event, size_t condition_index, size_t state_size);
+
+/**
+ * Tick the engine forward by delta seconds. The active scene is evaluated
+ * exactly once per call, or once per fixed step in fixed-timestep mode.
+ */
 void nutmeg_engine_tick(NutmegEngine *engine, float delta_seconds);
 
+/**
+ * Scratch memory for condition and action callbacks, valid until the current
+ * nutmeg_engine_tick returns; there is nothing to free. align must be a power
+ * of two, 0 picks 16. Safe to call from parallel events. The arena grows in
+ * pages and keeps them, so steady-state ticks do not allocate. Returns NULL
+ * when size is 0 or a page cannot be allocated.
+ */
+void *nutmeg_engine_frame_alloc(NutmegEngine *engine, size_t size, size_t align);
+
+/**
+ * Switch to fixed-timestep mode. Deltas passed to nutmeg_engine_tick are
+ * accumulated and the scene is stepped in whole step_seconds increments, at
+ * most max_steps times per call (at least one); time beyond that cap is
+ * dropped rather than caught up later. Events then always observe the same
+ * delta, independent of the frame rate. A step of zero restores variable
+ * timestep mode.
+ */
+void nutmeg_engine_set_fixed_timestep(NutmegEngine *engine, float step_seconds, unsigned int max_steps);
+
+/** Step length in fixed-timestep mode, or 0 in variable timestep mode. */
+float nutmeg_engine_fixed_timestep(const NutmegEngine *engine);
+
+/**
+ * Fraction in [0, 1) of a fixed step accumulated but not yet simulated.
+ * Renderers blend the previous and current state by this amount to hide the
+ * step granularity. Always 0 in variable timestep mode.
+ */
+float nutmeg_engine_interpolation_alpha(const NutmegEngine *engine);
+
 /**
  * Enumerate the objects in a scene. Returns an array pointer owned by the
  * scene. The caller should not modify or free it. The array is valid until the
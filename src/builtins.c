@@ -1,10 +1,17 @@
 #include "nutmeg_builtin.h"
 
+#include "builtins_simd.h"
+
 #include <stdio.h>
 
+/* Time a builtin advances by: the ticking scene's delta, which a background scene accumulates over several steps. */
+static float nutmeg_builtin_delta(const NutmegEngine *engine, const NutmegScene *scene)
+{
+    return scene ? nutmeg_scene_last_delta(scene) : nutmeg_engine_last_delta(engine);
+}
+
 bool nutmeg_condition_timer(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
 {
-    (void)scene;
     (void)object;
 
     if (!engine || !userdata) {
@@ -16,7 +23,7 @@ bool nutmeg_condition_timer(NutmegEngine *engine, NutmegScene *scene, NutmegObje
         return true;
     }
 
-    timer->accumulator += nutmeg_engine_last_delta(engine);
+    timer->accumulator += nutmeg_builtin_delta(engine, scene);
     if (timer->accumulator >= timer->interval) {
         if (timer->repeat) {
             timer->accumulator -= timer->interval;
@@ -29,16 +36,101 @@ bool nutmeg_condition_timer(NutmegEngine *engine, NutmegScene *scene, NutmegObje
     return false;
 }
 
-void nutmeg_action_integrate(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+bool nutmeg_condition_name_is(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
 {
+    (void)engine;
     (void)scene;
+
+    if (!object || !userdata) {
+        return false;
+    }
+
+    const NutmegNameFilter *filter = (const NutmegNameFilter *)userdata;
+    return nutmeg_object_name_symbol(object) == filter->name;
+}
+
+void nutmeg_condition_name_is_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, unsigned char *mask, void *userdata)
+{
+    (void)engine;
+    (void)scene;
+
+    if (!span || !mask) {
+        return;
+    }
+
+    NutmegSymbol name = userdata ? ((const NutmegNameFilter *)userdata)->name : NUTMEG_SYMBOL_NONE;
+    for (size_t i = 0; i < span->count; ++i) {
+        mask[i] = (unsigned char)(mask[i] && (userdata && span->names[i] == name));
+    }
+}
+
+typedef struct NutmegOtherSearch {
+    const NutmegObject *self;
+    bool found;
+} NutmegOtherSearch;
+
+/* Spatial visitor stopping at the first object other than the one asking. */
+static bool nutmeg_visit_other(NutmegObject *other, void *userdata)
+{
+    NutmegOtherSearch *search = (NutmegOtherSearch *)userdata;
+    if (other == search->self) {
+        return true;
+    }
+    search->found = true;
+    return false;
+}
+
+bool nutmeg_condition_within_radius(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+{
+    (void)engine;
+
+    if (!scene || !object || !userdata) {
+        return false;
+    }
+
+    const NutmegProximity *proximity = (const NutmegProximity *)userdata;
+    NutmegOtherSearch search = {object, false};
+    nutmeg_scene_query_radius(scene, *nutmeg_object_position(object), proximity->radius, &proximity->target, nutmeg_visit_other, &search);
+    return search.found;
+}
+
+bool nutmeg_condition_overlaps(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+{
+    (void)engine;
+
+    if (!scene || !object) {
+        return false;
+    }
+
+    const NutmegObjectQuery *target = (const NutmegObjectQuery *)userdata;
+    NutmegOtherSearch search = {object, false};
+    nutmeg_scene_query_overlap(scene, *nutmeg_object_position(object), nutmeg_object_radius(object), target, nutmeg_visit_other, &search);
+    return search.found;
+}
+
+bool nutmeg_condition_nearest(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+{
+    (void)engine;
+
+    if (!scene || !object || !userdata) {
+        return false;
+    }
+
+    NutmegNearest *nearest = (NutmegNearest *)userdata;
+    NutmegObject *found = nutmeg_scene_nearest_object(scene, *nutmeg_object_position(object), nearest->max_distance, &nearest->target, object);
+    nearest->nearest = nutmeg_object_handle(found);
+    return found != NULL;
+}
+
+void nutmeg_action_integrate(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
+{
     (void)userdata;
 
     if (!engine || !object) {
         return;
     }
 
-    float dt = nutmeg_engine_last_delta(engine);
+    float dt = nutmeg_builtin_delta(engine, scene);
     NutmegVec2 *position = nutmeg_object_position(object);
     NutmegVec2 *velocity = nutmeg_object_velocity(object);
     position->x += velocity->x * dt;
@@ -47,13 +139,11 @@ void nutmeg_action_integrate(NutmegEngine *engine, NutmegScene *scene, NutmegObj
 
 void nutmeg_action_accelerate(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
 {
-    (void)scene;
-
     if (!engine || !object || !userdata) {
         return;
     }
 
-    float dt = nutmeg_engine_last_delta(engine);
+    float dt = nutmeg_builtin_delta(engine, scene);
     NutmegVec2 *velocity = nutmeg_object_velocity(object);
     NutmegVec2 *acceleration = (NutmegVec2 *)userdata;
     velocity->x += acceleration->x * dt;
@@ -90,6 +180,58 @@ void nutmeg_action_translate(NutmegEngine *engine, NutmegScene *scene, NutmegObj
     position->y += translation->delta.y;
 }
 
+void nutmeg_action_integrate_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata)
+{
+    (void)userdata;
+
+    if (!engine || !span || !mask) {
+        return;
+    }
+
+    float dt = nutmeg_builtin_delta(engine, scene);
+    nutmeg_simd_integrate(span->positions, span->velocities, mask, span->count, dt);
+}
+
+void nutmeg_action_accelerate_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata)
+{
+    if (!engine || !span || !mask || !userdata) {
+        return;
+    }
+
+    const NutmegVec2 *acceleration = (const NutmegVec2 *)userdata;
+    float dt = nutmeg_builtin_delta(engine, scene);
+    NutmegVec2 offset;
+    offset.x = acceleration->x * dt;
+    offset.y = acceleration->y * dt;
+    nutmeg_simd_offset(span->velocities, mask, span->count, offset);
+}
+
+void nutmeg_action_add_velocity_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata)
+{
+    (void)engine;
+    (void)scene;
+
+    if (!span || !mask || !userdata) {
+        return;
+    }
+
+    const NutmegVelocityChange *change = (const NutmegVelocityChange *)userdata;
+    nutmeg_simd_offset(span->velocities, mask, span->count, change->delta);
+}
+
+void nutmeg_action_translate_batch(NutmegEngine *engine, NutmegScene *scene, const NutmegObjectSpan *span, const unsigned char *mask, void *userdata)
+{
+    (void)engine;
+    (void)scene;
+
+    if (!span || !mask || !userdata) {
+        return;
+    }
+
+    const NutmegTranslation *translation = (const NutmegTranslation *)userdata;
+    nutmeg_simd_offset(span->positions, mask, span->count, translation->delta);
+}
+
 void nutmeg_action_debug_print(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, void *userdata)
 {
     (void)engine;
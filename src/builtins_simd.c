@@ -0,0 +1,278 @@
+#include "builtins_simd.h"
+
+#include "nutmeg_builtin.h"
+#include "platform.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NUTMEG_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(NUTMEG_SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define NUTMEG_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(NUTMEG_SIMD_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define NUTMEG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NUTMEG_TARGET_AVX2
+#endif
+
+#if defined(_MSC_VER) && defined(NUTMEG_SIMD_AVX2)
+#include <intrin.h>
+#endif
+
+/* Kernels process blocks of this many objects (16 floats). */
+#define NUTMEG_SIMD_BLOCK 8
+
+enum {
+    NUTMEG_SIMD_LEVEL_SCALAR = 1,
+    NUTMEG_SIMD_LEVEL_SSE2,
+    NUTMEG_SIMD_LEVEL_AVX2
+};
+
+enum {
+    NUTMEG_MASK_NONE,
+    NUTMEG_MASK_ALL,
+    NUTMEG_MASK_MIXED
+};
+
+/* Classify the selection of one block so full blocks can skip the per-lane checks. */
+static int nutmeg_mask_block(const unsigned char *mask)
+{
+    unsigned long long word;
+    memcpy(&word, mask, sizeof(word));
+    if (word == 0) {
+        return NUTMEG_MASK_NONE;
+    }
+
+    /* classic "has zero byte" test: no byte of the block is zero */
+    const unsigned long long ones = 0x0101010101010101ULL;
+    const unsigned long long highs = 0x8080808080808080ULL;
+    if (((word - ones) & ~word & highs) == 0) {
+        return NUTMEG_MASK_ALL;
+    }
+    return NUTMEG_MASK_MIXED;
+}
+
+static void nutmeg_integrate_scalar(NutmegVec2 *positions, const NutmegVec2 *velocities, const unsigned char *mask, size_t begin, size_t end, float scale)
+{
+    for (size_t i = begin; i < end; ++i) {
+        if (mask[i]) {
+            positions[i].x += velocities[i].x * scale;
+            positions[i].y += velocities[i].y * scale;
+        }
+    }
+}
+
+static void nutmeg_offset_scalar(NutmegVec2 *vectors, const unsigned char *mask, size_t begin, size_t end, NutmegVec2 offset)
+{
+    for (size_t i = begin; i < end; ++i) {
+        if (mask[i]) {
+            vectors[i].x += offset.x;
+            vectors[i].y += offset.y;
+        }
+    }
+}
+
+#if defined(NUTMEG_SIMD_SSE2)
+
+static void nutmeg_integrate_sse2(NutmegVec2 *positions, const NutmegVec2 *velocities, const unsigned char *mask, size_t count, float scale)
+{
+    const __m128 factor = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + NUTMEG_SIMD_BLOCK <= count; i += NUTMEG_SIMD_BLOCK) {
+        int selection = nutmeg_mask_block(mask + i);
+        if (selection == NUTMEG_MASK_NONE) {
+            continue;
+        }
+        if (selection == NUTMEG_MASK_MIXED) {
+            nutmeg_integrate_scalar(positions, velocities, mask, i, i + NUTMEG_SIMD_BLOCK, scale);
+            continue;
+        }
+
+        float *p = &positions[i].x;
+        const float *v = &velocities[i].x;
+        for (size_t k = 0; k < 2 * NUTMEG_SIMD_BLOCK; k += 4) {
+            __m128 position = _mm_loadu_ps(p + k);
+            __m128 velocity = _mm_loadu_ps(v + k);
+            _mm_storeu_ps(p + k, _mm_add_ps(position, _mm_mul_ps(velocity, factor)));
+        }
+    }
+    nutmeg_integrate_scalar(positions, velocities, mask, i, count, scale);
+}
+
+static void nutmeg_offset_sse2(NutmegVec2 *vectors, const unsigned char *mask, size_t count, NutmegVec2 offset)
+{
+    const __m128 delta = _mm_setr_ps(offset.x, offset.y, offset.x, offset.y);
+    size_t i = 0;
+    for (; i + NUTMEG_SIMD_BLOCK <= count; i += NUTMEG_SIMD_BLOCK) {
+        int selection = nutmeg_mask_block(mask + i);
+        if (selection == NUTMEG_MASK_NONE) {
+            continue;
+        }
+        if (selection == NUTMEG_MASK_MIXED) {
+            nutmeg_offset_scalar(vectors, mask, i, i + NUTMEG_SIMD_BLOCK, offset);
+            continue;
+        }
+
+        float *p = &vectors[i].x;
+        for (size_t k = 0; k < 2 * NUTMEG_SIMD_BLOCK; k += 4) {
+            _mm_storeu_ps(p + k, _mm_add_ps(_mm_loadu_ps(p + k), delta));
+        }
+    }
+    nutmeg_offset_scalar(vectors, mask, i, count, offset);
+}
+
+#endif
+
+#if defined(NUTMEG_SIMD_AVX2)
+
+NUTMEG_TARGET_AVX2
+static void nutmeg_integrate_avx2(NutmegVec2 *positions, const NutmegVec2 *velocities, const unsigned char *mask, size_t count, float scale)
+{
+    const __m256 factor = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + NUTMEG_SIMD_BLOCK <= count; i += NUTMEG_SIMD_BLOCK) {
+        int selection = nutmeg_mask_block(mask + i);
+        if (selection == NUTMEG_MASK_NONE) {
+            continue;
+        }
+        if (selection == NUTMEG_MASK_MIXED) {
+            nutmeg_integrate_scalar(positions, velocities, mask, i, i + NUTMEG_SIMD_BLOCK, scale);
+            continue;
+        }
+
+        float *p = &positions[i].x;
+        const float *v = &velocities[i].x;
+        for (size_t k = 0; k < 2 * NUTMEG_SIMD_BLOCK; k += 8) {
+            __m256 position = _mm256_loadu_ps(p + k);
+            __m256 velocity = _mm256_loadu_ps(v + k);
+            _mm256_storeu_ps(p + k, _mm256_add_ps(position, _mm256_mul_ps(velocity, factor)));
+        }
+    }
+    nutmeg_integrate_scalar(positions, velocities, mask, i, count, scale);
+}
+
+NUTMEG_TARGET_AVX2
+static void nutmeg_offset_avx2(NutmegVec2 *vectors, const unsigned char *mask, size_t count, NutmegVec2 offset)
+{
+    const __m256 delta = _mm256_setr_ps(offset.x, offset.y, offset.x, offset.y, offset.x, offset.y, offset.x, offset.y);
+    size_t i = 0;
+    for (; i + NUTMEG_SIMD_BLOCK <= count; i += NUTMEG_SIMD_BLOCK) {
+        int selection = nutmeg_mask_block(mask + i);
+        if (selection == NUTMEG_MASK_NONE) {
+            continue;
+        }
+        if (selection == NUTMEG_MASK_MIXED) {
+            nutmeg_offset_scalar(vectors, mask, i, i + NUTMEG_SIMD_BLOCK, offset);
+            continue;
+        }
+
+        float *p = &vectors[i].x;
+        for (size_t k = 0; k < 2 * NUTMEG_SIMD_BLOCK; k += 8) {
+            _mm256_storeu_ps(p + k, _mm256_add_ps(_mm256_loadu_ps(p + k), delta));
+        }
+    }
+    nutmeg_offset_scalar(vectors, mask, i, count, offset);
+}
+
+static bool nutmeg_cpu_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+static NutmegAtomicU64 nutmeg_simd_level_cache = 0;
+
+static int nutmeg_simd_level(void)
+{
+    unsigned long long level = nutmeg_atomic_load_u64(&nutmeg_simd_level_cache);
+    if (level != 0) {
+        return (int)level;
+    }
+
+    level = NUTMEG_SIMD_LEVEL_SCALAR;
+#if defined(NUTMEG_SIMD_SSE2)
+    level = NUTMEG_SIMD_LEVEL_SSE2;
+#endif
+#if defined(NUTMEG_SIMD_AVX2)
+    if (nutmeg_cpu_has_avx2()) {
+        level = NUTMEG_SIMD_LEVEL_AVX2;
+    }
+#endif
+
+    nutmeg_atomic_store_u64(&nutmeg_simd_level_cache, level);
+    return (int)level;
+}
+
+void nutmeg_simd_integrate(NutmegVec2 *positions, const NutmegVec2 *velocities, const unsigned char *mask, size_t count, float scale)
+{
+    switch (nutmeg_simd_level()) {
+#if defined(NUTMEG_SIMD_AVX2)
+        case NUTMEG_SIMD_LEVEL_AVX2:
+            nutmeg_integrate_avx2(positions, velocities, mask, count, scale);
+            return;
+#endif
+#if defined(NUTMEG_SIMD_SSE2)
+        case NUTMEG_SIMD_LEVEL_SSE2:
+            nutmeg_integrate_sse2(positions, velocities, mask, count, scale);
+            return;
+#endif
+        default:
+            nutmeg_integrate_scalar(positions, velocities, mask, 0, count, scale);
+            return;
+    }
+}
+
+void nutmeg_simd_offset(NutmegVec2 *vectors, const unsigned char *mask, size_t count, NutmegVec2 offset)
+{
+    switch (nutmeg_simd_level()) {
+#if defined(NUTMEG_SIMD_AVX2)
+        case NUTMEG_SIMD_LEVEL_AVX2:
+            nutmeg_offset_avx2(vectors, mask, count, offset);
+            return;
+#endif
+#if defined(NUTMEG_SIMD_SSE2)
+        case NUTMEG_SIMD_LEVEL_SSE2:
+            nutmeg_offset_sse2(vectors, mask, count, offset);
+            return;
+#endif
+        default:
+            nutmeg_offset_scalar(vectors, mask, 0, count, offset);
+            return;
+    }
+}
+
+const char *nutmeg_builtin_simd_backend(void)
+{
+    switch (nutmeg_simd_level()) {
+        case NUTMEG_SIMD_LEVEL_AVX2:
+            return "avx2";
+        case NUTMEG_SIMD_LEVEL_SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
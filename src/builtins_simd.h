@@ -0,0 +1,19 @@
+#ifndef NUTMEG_BUILTINS_SIMD_H
+#define NUTMEG_BUILTINS_SIMD_H
+
+#include "nutmeg_engine.h"
+
+/*
+ * Vector kernels behind the batch motion builtins. Each kernel only updates
+ * entries whose mask byte is non-zero and performs exactly the same float
+ * multiply/add sequence as the scalar builtins, so results are bit-identical
+ * whichever instruction set is selected at runtime (AVX2, SSE2 or scalar).
+ */
+
+/** positions[i] += velocities[i] * scale for every selected entry. */
+void nutmeg_simd_integrate(NutmegVec2 *positions, const NutmegVec2 *velocities, const unsigned char *mask, size_t count, float scale);
+
+/** vectors[i] += offset for every selected entry. */
+void nutmeg_simd_offset(NutmegVec2 *vectors, const unsigned char *mask, size_t count, NutmegVec2 offset);
+
+#endif /* NUTMEG_BUILTINS_SIMD_H */
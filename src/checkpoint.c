@@ -0,0 +1,218 @@
+#include "checkpoint.h"
+
+#include <string.h>
+
+/* Granularity of the image comparison; neighbouring changed blocks share a run. */
+#define NUTMEG_CHECKPOINT_BLOCK 64
+
+/* Header of an undo run; the run's previous bytes follow it. */
+typedef struct NutmegCheckpointRun {
+    size_t offset;
+    size_t size;
+} NutmegCheckpointRun;
+
+static void nutmeg_checkpoint_buffer_free(NutmegMemoryAccount *account, NutmegCheckpointBuffer *buffer)
+{
+    nutmeg_memory_free(account, NUTMEG_MEMORY_CHECKPOINTS, buffer->data, buffer->capacity);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static void nutmeg_checkpoint_buffer_swap(NutmegCheckpointBuffer *a, NutmegCheckpointBuffer *b)
+{
+    NutmegCheckpointBuffer swapped = *a;
+    *a = *b;
+    *b = swapped;
+}
+
+void nutmeg_checkpoint_ring_init(NutmegCheckpointRing *ring, NutmegMemoryAccount *account)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->account = account;
+    ring->next_id = 1;
+}
+
+static void nutmeg_checkpoint_entries_free(NutmegCheckpointRing *ring)
+{
+    for (size_t i = 0; i < ring->capacity; ++i) {
+        nutmeg_checkpoint_buffer_free(ring->account, &ring->entries[i].delta);
+        nutmeg_checkpoint_buffer_free(ring->account, &ring->entries[i].index);
+        nutmeg_checkpoint_buffer_free(ring->account, &ring->entries[i].state);
+    }
+    nutmeg_memory_free(ring->account, NUTMEG_MEMORY_CHECKPOINTS, ring->entries, ring->capacity * sizeof(NutmegCheckpoint));
+    ring->entries = NULL;
+    ring->capacity = 0;
+    ring->first = 0;
+    ring->count = 0;
+}
+
+void nutmeg_checkpoint_ring_free(NutmegCheckpointRing *ring)
+{
+    nutmeg_checkpoint_entries_free(ring);
+    nutmeg_memory_free(ring->account, NUTMEG_MEMORY_CHECKPOINTS, ring->shadow, ring->shadow_capacity);
+    ring->shadow = NULL;
+    ring->shadow_size = 0;
+    ring->shadow_capacity = 0;
+}
+
+bool nutmeg_checkpoint_ring_reserve(NutmegCheckpointRing *ring, size_t capacity)
+{
+    nutmeg_checkpoint_entries_free(ring);
+    if (capacity == 0) {
+        return true;
+    }
+
+    ring->entries = (NutmegCheckpoint *)nutmeg_memory_alloc(ring->account, NUTMEG_MEMORY_CHECKPOINTS, capacity * sizeof(NutmegCheckpoint));
+    if (!ring->entries) {
+        return false;
+    }
+    ring->capacity = capacity;
+    return true;
+}
+
+NutmegCheckpoint *nutmeg_checkpoint_ring_push(NutmegCheckpointRing *ring)
+{
+    if (ring->count == ring->capacity) {
+        ring->first = (ring->first + 1) % ring->capacity;
+        ring->count--;
+        if (ring->count > 0) {
+            /* the new oldest inherits the evicted structure it shares, and needs no runs */
+            NutmegCheckpoint *evicted = &ring->entries[(ring->first + ring->capacity - 1) % ring->capacity];
+            NutmegCheckpoint *oldest = &ring->entries[ring->first];
+            if (!oldest->has_index) {
+                nutmeg_checkpoint_buffer_swap(&oldest->index, &evicted->index);
+                oldest->has_index = true;
+            }
+            oldest->delta.size = 0;
+        }
+    }
+
+    NutmegCheckpoint *checkpoint = &ring->entries[(ring->first + ring->count) % ring->capacity];
+    ring->count++;
+    checkpoint->id = ring->next_id++;
+    checkpoint->structure_version = 0;
+    checkpoint->has_index = false;
+    checkpoint->delta.size = 0;
+    checkpoint->index.size = 0;
+    checkpoint->state.size = 0;
+    return checkpoint;
+}
+
+NutmegCheckpoint *nutmeg_checkpoint_ring_at(NutmegCheckpointRing *ring, size_t position)
+{
+    return &ring->entries[(ring->first + position) % ring->capacity];
+}
+
+bool nutmeg_checkpoint_ring_find(const NutmegCheckpointRing *ring, unsigned long long id, size_t *out_position)
+{
+    for (size_t position = 0; position < ring->count; ++position) {
+        if (ring->entries[(ring->first + position) % ring->capacity].id == id) {
+            *out_position = position;
+            return true;
+        }
+    }
+    return false;
+}
+
+void nutmeg_checkpoint_ring_truncate(NutmegCheckpointRing *ring, size_t count)
+{
+    /* ids are not handed out again, so a dropped id never names a later checkpoint */
+    if (count < ring->count) {
+        ring->count = count;
+    }
+}
+
+static bool nutmeg_checkpoint_reserve(NutmegMemoryAccount *account, unsigned char **data, size_t *capacity, size_t size)
+{
+    if (size <= *capacity) {
+        return true;
+    }
+
+    size_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < size) {
+        new_capacity *= 2;
+    }
+    unsigned char *resized = (unsigned char *)nutmeg_memory_realloc(account, NUTMEG_MEMORY_CHECKPOINTS, *data, *capacity, new_capacity);
+    if (!resized) {
+        return false;
+    }
+    *data = resized;
+    *capacity = new_capacity;
+    return true;
+}
+
+bool nutmeg_checkpoint_shadow_grow(NutmegCheckpointRing *ring, size_t size)
+{
+    if (!nutmeg_checkpoint_reserve(ring->account, &ring->shadow, &ring->shadow_capacity, size)) {
+        return false;
+    }
+    if (size > ring->shadow_size) {
+        ring->shadow_size = size;
+    }
+    return true;
+}
+
+void *nutmeg_checkpoint_append(NutmegCheckpointRing *ring, NutmegCheckpointBuffer *buffer, const void *data, size_t size)
+{
+    if (!nutmeg_checkpoint_reserve(ring->account, &buffer->data, &buffer->capacity, buffer->size + size)) {
+        return NULL;
+    }
+
+    unsigned char *start = buffer->data + buffer->size;
+    if (data) {
+        memcpy(start, data, size);
+    } else {
+        memset(start, 0, size);
+    }
+    buffer->size += size;
+    return start;
+}
+
+bool nutmeg_checkpoint_diff(NutmegCheckpointRing *ring, NutmegCheckpoint *checkpoint, size_t offset, const void *current, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)current;
+    unsigned char *shadow = ring->shadow + offset;
+    bool record = ring->count > 1;
+
+    size_t at = 0;
+    while (at < size) {
+        size_t block = size - at < NUTMEG_CHECKPOINT_BLOCK ? size - at : NUTMEG_CHECKPOINT_BLOCK;
+        if (memcmp(shadow + at, bytes + at, block) == 0) {
+            at += block;
+            continue;
+        }
+
+        NutmegCheckpointRun run;
+        run.offset = offset + at;
+        run.size = block;
+        while (at + run.size < size) {
+            size_t next = size - at - run.size < NUTMEG_CHECKPOINT_BLOCK ? size - at - run.size : NUTMEG_CHECKPOINT_BLOCK;
+            if (memcmp(shadow + at + run.size, bytes + at + run.size, next) == 0) {
+                break;
+            }
+            run.size += next;
+        }
+
+        if (record) {
+            if (!nutmeg_checkpoint_reserve(ring->account, &checkpoint->delta.data, &checkpoint->delta.capacity, checkpoint->delta.size + sizeof(run) + run.size)) {
+                return false;
+            }
+            memcpy(checkpoint->delta.data + checkpoint->delta.size, &run, sizeof(run));
+            memcpy(checkpoint->delta.data + checkpoint->delta.size + sizeof(run), shadow + at, run.size);
+            checkpoint->delta.size += sizeof(run) + run.size;
+        }
+        memcpy(shadow + at, bytes + at, run.size);
+        at += run.size;
+    }
+    return true;
+}
+
+void nutmeg_checkpoint_undo(NutmegCheckpointRing *ring, const NutmegCheckpoint *checkpoint)
+{
+    size_t at = 0;
+    while (at < checkpoint->delta.size) {
+        NutmegCheckpointRun run;
+        memcpy(&run, checkpoint->delta.data + at, sizeof(run));
+        memcpy(ring->shadow + run.offset, checkpoint->delta.data + at + sizeof(run), run.size);
+        at += sizeof(run) + run.size;
+    }
+}
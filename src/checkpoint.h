@@ -0,0 +1,83 @@
+#ifndef NUTMEG_CHECKPOINT_H
+#define NUTMEG_CHECKPOINT_H
+
+#include "memory.h"
+
+/*
+ * Ring of scene checkpoints. The ring keeps a shadow copy of the byte image
+ * the newest checkpoint captured; each checkpoint stores only the runs of
+ * that image which changed since the previous one, together with their
+ * previous bytes. Rolling back to an older checkpoint writes those runs
+ * back into the shadow, newest first. The oldest checkpoint keeps no runs,
+ * since nothing is ever restored from before it. Buffers keep their
+ * capacity when an entry is reused, so a ring that has wrapped once stops
+ * allocating.
+ */
+
+/** Growable byte buffer owned by a checkpoint. */
+typedef struct NutmegCheckpointBuffer {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} NutmegCheckpointBuffer;
+
+typedef struct NutmegCheckpoint {
+    unsigned long long id;
+    unsigned long long structure_version; /**< Scene structure the checkpoint saw. */
+    bool has_index;                       /**< index is set; otherwise the previous checkpoint's applies. */
+    NutmegCheckpointBuffer delta;         /**< Undo runs back to the previous checkpoint's image. */
+    NutmegCheckpointBuffer index;         /**< Caller-defined description of the structure. */
+    NutmegCheckpointBuffer state;         /**< Caller-defined data stored in full. */
+} NutmegCheckpoint;
+
+typedef struct NutmegCheckpointRing {
+    NutmegMemoryAccount *account;
+    NutmegCheckpoint *entries;
+    size_t capacity;
+    size_t first; /**< Entry of the oldest checkpoint. */
+    size_t count;
+    unsigned long long next_id;
+    unsigned char *shadow; /**< Image as of the newest checkpoint. */
+    size_t shadow_size;
+    size_t shadow_capacity;
+} NutmegCheckpointRing;
+
+void nutmeg_checkpoint_ring_init(NutmegCheckpointRing *ring, NutmegMemoryAccount *account);
+void nutmeg_checkpoint_ring_free(NutmegCheckpointRing *ring);
+
+/** Resize the ring to capacity entries, dropping every checkpoint. Returns false when the entries cannot be allocated. */
+bool nutmeg_checkpoint_ring_reserve(NutmegCheckpointRing *ring, size_t capacity);
+
+/**
+ * Start a new newest checkpoint with empty buffers, evicting the oldest one
+ * when the ring is full. The ring must have capacity.
+ */
+NutmegCheckpoint *nutmeg_checkpoint_ring_push(NutmegCheckpointRing *ring);
+
+/** Checkpoint at position (0 is the oldest). */
+NutmegCheckpoint *nutmeg_checkpoint_ring_at(NutmegCheckpointRing *ring, size_t position);
+
+/** Position of the checkpoint with an id, or false when it is not in the ring. */
+bool nutmeg_checkpoint_ring_find(const NutmegCheckpointRing *ring, unsigned long long id, size_t *out_position);
+
+/** Drop every checkpoint after the first count. */
+void nutmeg_checkpoint_ring_truncate(NutmegCheckpointRing *ring, size_t count);
+
+/** Extend the shadow to size bytes; the caller fills the new tail. Returns false on allocation failure. */
+bool nutmeg_checkpoint_shadow_grow(NutmegCheckpointRing *ring, size_t size);
+
+/**
+ * Compare size bytes of current against the shadow at offset, record the
+ * runs that differ in the newest checkpoint's delta and bring the shadow up
+ * to date. Returns false on allocation failure; the runs recorded so far
+ * stay valid for nutmeg_checkpoint_undo.
+ */
+bool nutmeg_checkpoint_diff(NutmegCheckpointRing *ring, NutmegCheckpoint *checkpoint, size_t offset, const void *current, size_t size);
+
+/** Write a checkpoint's undo runs back into the shadow. */
+void nutmeg_checkpoint_undo(NutmegCheckpointRing *ring, const NutmegCheckpoint *checkpoint);
+
+/** Append size bytes (zeroed when data is NULL) to a buffer. Returns where they start, or NULL on allocation failure. */
+void *nutmeg_checkpoint_append(NutmegCheckpointRing *ring, NutmegCheckpointBuffer *buffer, const void *data, size_t size);
+
+#endif /* NUTMEG_CHECKPOINT_H */
@@ -138,7 +138,9 @@ void nm_editor_app_main_loop(NmEditorApp *app)
             if (snapshot) {
                 meters.cpu = snapshot->cpu_usage;
                 meters.ram = snapshot->ram_usage;
-                meters.gpu = snapshot->gpu_usage;
+                // p99 tick time against a 60 Hz frame budget
+                const float tick_usage = snapshot->tick_p99_ms / (1000.0f / 60.0f) * 100.0f;
+                meters.tick = tick_usage > 100.0f ? 100.0f : tick_usage;
             }
         }
 
@@ -130,7 +130,7 @@ void nm_editor_draw_sidebar(NmEditorUIState &state, const NmEditorMeters &meters
 
     nm_draw_meter_bar("CPU", state.meter_smoothed[0], layout, 0, state);
     nm_draw_meter_bar("RAM", state.meter_smoothed[1], layout, 1, state);
-    nm_draw_meter_bar("GPU", state.meter_smoothed[2], layout, 2, state);
+    nm_draw_meter_bar("TICK", state.meter_smoothed[2], layout, 2, state);
 
     ImGui::End();
 }
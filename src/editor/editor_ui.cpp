@@ -71,7 +71,7 @@ static void nm_editor_update_metrics(NmEditorUIState &state, const NmEditorMeter
     const float smoothing = 0.18f;
     const float history_smoothing = 0.12f;
 
-    const float values[3] = {meters.cpu, meters.ram, meters.gpu};
+    const float values[3] = {meters.cpu, meters.ram, meters.tick};
     for (int i = 0; i < 3; ++i) {
         state.meter_smoothed[i] = state.meter_smoothed[i] * (1.0f - smoothing) + values[i] * smoothing;
         state.meter_history[i][state.meter_cursor] = state.meter_history[i][state.meter_cursor] * (1.0f - history_smoothing) + values[i] * history_smoothing;
@@ -7,7 +7,7 @@
 struct NmEditorMeters {
     float cpu = 0.0f;
     float ram = 0.0f;
-    float gpu = 0.0f;
+    float tick = 0.0f;
 };
 
 struct NmEditorUIState {
@@ -1,47 +1,329 @@
 #include "nutmeg_engine.h"
+#include "nutmeg_builtin.h"
+
+#include "checkpoint.h"
+#include "frame_arena.h"
+#include "memory.h"
+#include "platform.h"
+#include "scene_loader.h"
+#include "scene_registry.h"
+#include "snapshot.h"
+#include "spatial_hash.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
+#include "tick_stats.h"
+#include "trace.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <stdlib.h>
-#include <string.h>
 
+/** Number of object slots stored in a single pooled chunk. */
+#define NUTMEG_OBJECT_CHUNK_CAPACITY 256
+
+typedef struct NutmegObjectChunk NutmegObjectChunk;
+
+/**
+ * Object handle handed out to callers. It only locates the object's slot; the
+ * object data itself lives in the column arrays of the owning chunk so that
+ * per-tick passes touch contiguous memory.
+ */
 struct NutmegObject {
-    unsigned long id;
-    bool alive;
-    char name[64];
-    NutmegScene *scene;
-    NutmegVec2 position;
-    NutmegVec2 velocity;
+    NutmegObjectChunk *chunk;
+    size_t index;
+};
+
+/** Structural changes recorded against an object while its scene ticks. */
+enum {
+    NUTMEG_OBJECT_PENDING_SPAWN = 1 << 0,
+    NUTMEG_OBJECT_PENDING_DESTROY = 1 << 1,
+    NUTMEG_OBJECT_PENDING_REINDEX = 1 << 2
+};
+
+/** Rarely accessed per-object data, kept out of the hot columns. */
+typedef struct NutmegObjectCold {
+    const char *name;   /**< Interned string owned by the engine's symbol table. */
     void *userdata;
+    size_t dense_index; /**< Position inside NutmegScene::objects. */
+    size_t name_index;  /**< Position inside the scene's list for the object's name. */
+    unsigned long long tags;
+    unsigned int type_id; /**< Userdata type matched by queries. */
+    unsigned int pending; /**< NUTMEG_OBJECT_PENDING_* flags. */
+} NutmegObjectCold;
+
+/**
+ * Fixed size block of object slots stored as structure-of-arrays. Chunks are
+ * never moved once allocated, so object handles and the vector pointers
+ * returned by nutmeg_object_position/velocity stay valid while the object is
+ * alive.
+ */
+struct NutmegObjectChunk {
+    NutmegScene *scene;
+    size_t base;       /**< Scene slot index of the chunk's first object. */
+    size_t live_count;
+    size_t high_water; /**< Slots [0, high_water) have been handed out at least once. */
+    NutmegVec2 positions[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    NutmegVec2 velocities[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    float radii[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    unsigned long ids[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    NutmegSymbol names[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    unsigned int generations[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    NutmegAtomicU8 alive[NUTMEG_OBJECT_CHUNK_CAPACITY]; /**< Cleared by workers mid-tick, so accessed through nutmeg_atomic_*_u8. */
+    NutmegObject objects[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    unsigned int generation_peaks[NUTMEG_OBJECT_CHUNK_CAPACITY]; /**< Highest generation a published object has carried; never restored. */
+    NutmegObjectCold *cold;
 };
 
+/**
+ * Open addressing map from object id to scene slot. Uses linear probing with
+ * backward shift deletion; id 0 marks an empty bucket.
+ */
+typedef struct NutmegIdMap {
+    unsigned long *ids;
+    size_t *slots;
+    size_t count;
+    size_t capacity; /**< Always zero or a power of two. */
+} NutmegIdMap;
+
+/** Growable array of object pointers. */
+typedef struct NutmegObjectList {
+    NutmegObject **objects;
+    size_t count;
+    size_t capacity;
+} NutmegObjectList;
+
+/** Marks slots outside a query group in NutmegQueryGroup::positions. */
+#define NUTMEG_QUERY_NOT_MEMBER ((size_t)-1)
+
+/**
+ * Live objects matching one query. positions is indexed by scene slot and
+ * gives the object's place in members, so membership changes are O(1).
+ */
+typedef struct NutmegQueryGroup {
+    NutmegObjectQuery query;
+    NutmegObjectList members;
+    size_t *positions;
+    size_t position_capacity;
+} NutmegQueryGroup;
+
+/**
+ * Spawns and destroys issued while a scene ticks. They are applied in one
+ * batch once the tick finishes so event iteration never observes a partially
+ * mutated object set.
+ */
+typedef struct NutmegCommandBuffer {
+    size_t *spawn_slots;
+    size_t spawn_count;
+    size_t spawn_capacity;
+    size_t *destroy_slots;
+    size_t destroy_count;
+    size_t destroy_capacity;
+    size_t *reindex_slots; /**< Objects whose tags or type changed. */
+    size_t reindex_count;
+    size_t reindex_capacity;
+} NutmegCommandBuffer;
+
+/** Profiling counters of a condition or action slot; shared by parallel tasks. */
+typedef struct NutmegSlotStats {
+    NutmegAtomicU64 calls;
+    NutmegAtomicU64 tested;
+    NutmegAtomicU64 passed;
+    NutmegAtomicU64 time_ns;
+} NutmegSlotStats;
+
+struct NutmegConditionPlan;
+
+/** Profiling counters of an event, see NutmegEventProfile. */
+typedef struct NutmegEventStats {
+    NutmegAtomicU64 runs;
+    NutmegAtomicU64 triggers;
+    NutmegAtomicU64 time_ns;
+    NutmegAtomicU64 tested;
+    NutmegAtomicU64 passed;
+    NutmegSlotStats *slots; /**< Conditions first (in evaluation order), then actions. */
+    struct NutmegConditionPlan *plan; /**< Adaptive ordering state, NULL when no condition can move. */
+} NutmegEventStats;
+
+/** What adaptive ordering knows about the condition at one position of an event. */
+typedef struct NutmegConditionEstimate {
+    size_t origin;              /**< Insertion index of the condition now at this position. */
+    unsigned long long tested;  /**< Slot counters when the current sample began. */
+    unsigned long long passed;
+    unsigned long long time_ns;
+    double cost_ns;             /**< Smoothed wall time per tested target. */
+    double pass_rate;           /**< Smoothed share of tested targets that passed. */
+    bool sampled;               /**< cost_ns and pass_rate hold at least one sample. */
+} NutmegConditionEstimate;
+
+/** Adaptive ordering state of an event whose conditions include a run of pure ones. */
+typedef struct NutmegConditionPlan {
+    NutmegEventStats sample;            /**< Counters filled on sampling ticks while the profiler is off. */
+    NutmegConditionEstimate *estimates; /**< One per condition position. */
+} NutmegConditionPlan;
+
+typedef enum NutmegOpCode {
+    NUTMEG_OP_GUARD, /**< Evaluate hoisted conditions once; skip the guarded instructions if one fails. */
+    NUTMEG_OP_EVENT  /**< Dispatch an event over its targets. */
+} NutmegOpCode;
+
+/**
+ * One instruction of a compiled event list. An EVENT instruction carries
+ * everything the dispatch needs, so the tick does not go back to the
+ * source event except to record that a once-event fired.
+ */
+typedef struct NutmegOp {
+    NutmegOpCode code;
+    const char *name;
+    NutmegEventScope scope;
+    unsigned int flags;
+    NutmegObjectQuery query;
+    bool batched;                     /**< Every slot has a batch implementation. */
+    size_t event_index;               /**< Source event; for a guard, the first guarded one. */
+    size_t skip;                      /**< Guard only: instructions it covers. */
+    const NutmegCondition *conditions;
+    size_t condition_count;
+    const NutmegAction *actions;
+    size_t action_count;
+    size_t first_condition;           /**< Offsets of conditions and actions in the program arrays. */
+    size_t first_action;
+    size_t slot_offset;               /**< Profiler slot of conditions[0] within the event's slots. */
+    size_t fused;                     /**< Instructions, this one first, that can run as one pass. */
+} NutmegOp;
+
+/**
+ * A scene's event list lowered to a flat instruction stream. Finished
+ * once-events are left out, and leading conditions flagged
+ * NUTMEG_CONDITION_FLAG_INVARIANT are hoisted into a guard evaluated once
+ * per tick instead of once per object, shared by consecutive events with
+ * the same hoisted conditions. Runs of consecutive local events over the
+ * same query are marked on their first instruction so the tick can fuse
+ * them into one pass. Conditions and actions of all instructions
+ * live in two contiguous arrays. Rebuilt before the next tick whenever the
+ * event list changes.
+ */
+typedef struct NutmegProgram {
+    NutmegOp *ops;
+    size_t op_count;
+    size_t op_capacity;
+    NutmegCondition *conditions;
+    size_t condition_count;
+    size_t condition_capacity;
+    NutmegAction *actions;
+    size_t action_count;
+    size_t action_capacity;
+    bool dirty;
+} NutmegProgram;
+
+/* Run of consecutive schedule entries sharing a priority. */
+typedef struct NutmegScheduleBucket {
+    int priority;
+    NutmegScene *head;
+    NutmegScene *tail;
+} NutmegScheduleBucket;
+
 struct NutmegScene {
-    char name[64];
+    char *name;
+    NutmegSceneHandle handle; /**< Registry slot; the null handle until the scene is registered. */
     NutmegEngine *engine;
-    NutmegObject **objects;
+    NutmegMemoryAccount memory; /**< Charged for every allocation owned by the scene. */
+    NutmegObjectChunk **chunks; /**< Never moves during a tick: workers index it without a lock. */
+    size_t chunk_count;
+    size_t chunk_capacity;
+    NutmegObjectChunk **pending_chunks; /**< Created by spawns during a tick, under command_lock; the flush appends them to chunks. */
+    size_t pending_chunk_count;
+    size_t pending_chunk_capacity;
+    size_t *free_slots;     /**< Stack of recycled slot indices. */
+    size_t free_count;
+    size_t free_capacity;
+    size_t slot_count;      /**< Slots [0, slot_count) have been handed out at least once. */
+    NutmegObject **objects; /**< Dense enumeration of live objects. */
     size_t object_count;
     size_t object_capacity;
+    NutmegIdMap id_map;
+    NutmegObjectList *name_lists; /**< Live objects per name, indexed by symbol. */
+    size_t name_list_count;
+    size_t name_list_capacity;
+    NutmegQueryGroup *query_groups; /**< Tracked queries that need more than a name list. */
+    size_t query_group_count;
+    size_t query_group_capacity;
+    NutmegCommandBuffer commands;
+    NutmegMutex command_lock; /**< Serialises deferred changes issued from parallel events. */
+    NutmegSpatialHash spatial;
+    NutmegMutex spatial_lock;      /**< Serialises rebuilds requested from parallel events. */
+    NutmegAtomicU64 spatial_valid; /**< Non-zero while the spatial index is current. */
+    unsigned int defer_depth; /**< Non-zero while structural changes are deferred. */
     NutmegEvent *events;
     size_t event_count;
     size_t event_capacity;
+    NutmegEventStats *event_stats; /**< Profiling counters, parallel to events. */
+    size_t event_stats_capacity;
+    NutmegProgram program;         /**< What the tick actually runs, compiled from events. */
+    unsigned long sample_clock;    /**< Ticks counted towards the next condition sample. */
     unsigned long next_object_id;
+    float last_delta;          /**< Time simulated by the current or last tick. */
+    float pending_delta;       /**< Time of the steps since the last tick, simulated by the next one. */
+    unsigned int rate_divider; /**< Ticks once per rate_divider steps in the background; 0 when not scheduled. */
+    unsigned int steps_waited; /**< Steps since the last tick. */
+    int priority;              /**< Scenes due in a step tick in descending priority order. */
+    NutmegScene *schedule_prev; /**< Neighbours in the engine's schedule while rate_divider is non-zero. */
+    NutmegScene *schedule_next;
+    unsigned int tick_lane;    /**< Trace lane of the thread ticking the scene. */
+    bool tick_nested;          /**< Ticked by a pool task, so parallel events stay on that thread. */
+    NutmegCheckpointRing checkpoints;
+    unsigned long long structure_version; /**< Names the current object set and index order, see nutmeg_scene_restructured. */
+    unsigned long long structure_counter; /**< Last structure_version handed out. */
 };
 
 struct NutmegEngine {
-    NutmegScene **scenes;
+    NutmegAllocator allocator;  /**< Copy of the hooks every account of this engine allocates through. */
+    NutmegMemoryAccount memory; /**< Engine-wide allocations plus the totals of all scenes. */
+    size_t memory_budget;
+    NutmegAllocationGuard allocation_guard; /**< Applied to the account chain while nutmeg_engine_tick runs. */
+    NutmegSceneRegistry scenes;
     size_t scene_count;
-    size_t scene_capacity;
+    NutmegScene *schedule;    /**< Scenes with a rate divider, linked by descending priority. */
+    size_t schedule_count;
+    NutmegScheduleBucket *schedule_buckets; /**< One per priority in the schedule, by descending priority. */
+    size_t schedule_bucket_count;
+    size_t schedule_bucket_capacity;
+    NutmegScene **due_scenes; /**< Scenes ticking in the current step: the schedule plus the active scene. */
+    size_t due_capacity;
+    bool concurrent_scenes;
+    bool stepping;            /**< Scenes are being ticked; the schedule must not change. */
     NutmegScene *active_scene;
     float time;
     float last_delta;
+    float fixed_step;         /**< Zero in variable timestep mode. */
+    unsigned int max_steps;   /**< Catch-up cap per nutmeg_engine_tick call. */
+    double accumulator;       /**< Time received but not yet simulated. */
+    float interpolation_alpha;
     void *userdata;
     NutmegEngineMetrics metrics;
-    float gpu_meter_phase;
+    size_t tick_window;
+    NutmegTickRing tick_ring;           /**< Recent tick durations, read lock-free by other threads. */
+    NutmegTickHistogram tick_histogram; /**< Every tick duration since creation. */
+    NutmegTrace *trace;                 /**< Open trace file, NULL when not tracing. */
+    NutmegSceneLoader *loader;          /**< Started by the first background load. */
+    NutmegFrameArena frame_arena;       /**< Callback scratch memory, reset after every tick. */
+    bool profiling;
+    bool adaptive_conditions;
+    bool event_fusion;
+    NutmegSymbolTable symbols;
+    NutmegSymbol tags[NUTMEG_TAG_CAPACITY]; /**< Name of each assigned tag bit. */
+    unsigned int tag_count;
+    NutmegMutex tag_lock;
+    NutmegThreadPool *pool;              /**< NULL when events run sequentially. */
+    NutmegObjectChunk **parallel_chunks; /**< Chunk snapshot reused by parallel passes. */
+    size_t parallel_chunk_capacity;
 };
 
-static void *nutmeg_realloc_array(void *ptr, size_t elem_size, size_t *capacity, size_t min_capacity)
+/*
+ * Grow an array to hold at least min_capacity elements, charging the growth
+ * to account (NULL for event arrays built before the event joins a scene).
+ */
+static void *nutmeg_realloc_array(NutmegMemoryAccount *account, NutmegMemoryCategory category, void *ptr, size_t elem_size, size_t *capacity, size_t min_capacity)
 {
     if (*capacity >= min_capacity) {
         return ptr;
@@ -52,7 +334,7 @@ static void *nutmeg_realloc_array(void *ptr, size_t elem_size, size_t *capacity,
         new_capacity *= 2;
     }
 
-    void *resized = realloc(ptr, new_capacity * elem_size);
+    void *resized = nutmeg_memory_realloc(account, category, ptr, *capacity * elem_size, new_capacity * elem_size);
     if (!resized) {
         /* allocation failure is fatal */
         abort();
@@ -62,40 +344,275 @@ static void *nutmeg_realloc_array(void *ptr, size_t elem_size, size_t *capacity,
     return resized;
 }
 
-static NutmegScene *nutmeg_scene_create(NutmegEngine *engine, const char *name)
+/* Free an array grown with nutmeg_realloc_array. */
+static void nutmeg_free_array(NutmegMemoryAccount *account, NutmegMemoryCategory category, void *ptr, size_t elem_size, size_t capacity)
+{
+    nutmeg_memory_free(account, category, ptr, elem_size * capacity);
+}
+
+/* The trace spans should be recorded into, or NULL. */
+static NutmegTrace *nutmeg_engine_recording_trace(const NutmegEngine *engine)
+{
+    return engine->trace && engine->trace->recording ? engine->trace : NULL;
+}
+
+static size_t nutmeg_id_map_bucket(const NutmegIdMap *map, unsigned long id)
+{
+    /* Fibonacci hashing spreads the sequential ids across the table. */
+    unsigned long long hash = (unsigned long long)id * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash >> 32) & (map->capacity - 1);
+}
+
+static void nutmeg_id_map_free(NutmegIdMap *map, NutmegMemoryAccount *account)
+{
+    nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, map->ids, sizeof(unsigned long), map->capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, map->slots, sizeof(size_t), map->capacity);
+    map->ids = NULL;
+    map->slots = NULL;
+    map->count = 0;
+    map->capacity = 0;
+}
+
+static void nutmeg_id_map_insert_unchecked(NutmegIdMap *map, unsigned long id, size_t slot)
+{
+    size_t bucket = nutmeg_id_map_bucket(map, id);
+    while (map->ids[bucket] != 0) {
+        bucket = (bucket + 1) & (map->capacity - 1);
+    }
+    map->ids[bucket] = id;
+    map->slots[bucket] = slot;
+    map->count++;
+}
+
+static bool nutmeg_id_map_reserve(NutmegIdMap *map, NutmegMemoryAccount *account, size_t count)
+{
+    /* keep the load factor at or below 1/2 so probe chains stay short */
+    if (count * 2 > map->capacity) {
+        size_t new_capacity = map->capacity ? map->capacity * 2 : 64;
+        while (count * 2 > new_capacity) {
+            new_capacity *= 2;
+        }
+        unsigned long *ids = (unsigned long *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_INDEXES, new_capacity * sizeof(unsigned long));
+        size_t *slots = (size_t *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_INDEXES, new_capacity * sizeof(size_t));
+        if (!ids || !slots) {
+            nutmeg_memory_free(account, NUTMEG_MEMORY_INDEXES, ids, new_capacity * sizeof(unsigned long));
+            nutmeg_memory_free(account, NUTMEG_MEMORY_INDEXES, slots, new_capacity * sizeof(size_t));
+            return false;
+        }
+
+        NutmegIdMap grown = {ids, slots, 0, new_capacity};
+        for (size_t i = 0; i < map->capacity; ++i) {
+            if (map->ids[i] != 0) {
+                nutmeg_id_map_insert_unchecked(&grown, map->ids[i], map->slots[i]);
+            }
+        }
+        nutmeg_id_map_free(map, account);
+        *map = grown;
+    }
+    return true;
+}
+
+static bool nutmeg_id_map_find(const NutmegIdMap *map, unsigned long id, size_t *out_slot)
+{
+    if (map->capacity == 0 || id == 0) {
+        return false;
+    }
+
+    size_t bucket = nutmeg_id_map_bucket(map, id);
+    while (map->ids[bucket] != 0) {
+        if (map->ids[bucket] == id) {
+            *out_slot = map->slots[bucket];
+            return true;
+        }
+        bucket = (bucket + 1) & (map->capacity - 1);
+    }
+    return false;
+}
+
+static void nutmeg_id_map_remove(NutmegIdMap *map, unsigned long id)
+{
+    if (map->capacity == 0 || id == 0) {
+        return;
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t bucket = nutmeg_id_map_bucket(map, id);
+    while (map->ids[bucket] != id) {
+        if (map->ids[bucket] == 0) {
+            return;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    /* shift following entries back so lookups never need tombstones */
+    size_t hole = bucket;
+    size_t next = (hole + 1) & mask;
+    while (map->ids[next] != 0) {
+        size_t home = nutmeg_id_map_bucket(map, map->ids[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->ids[hole] = map->ids[next];
+            map->slots[hole] = map->slots[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    map->ids[hole] = 0;
+    map->count--;
+}
+
+/*
+ * Create an unregistered scene charged to parent. A scene built off the
+ * ticking thread starts with no parent and is attached to the engine
+ * account when it is registered.
+ */
+static NutmegScene *nutmeg_scene_create(NutmegEngine *engine, const char *name, NutmegMemoryAccount *parent)
 {
-    NutmegScene *scene = (NutmegScene *)calloc(1, sizeof(*scene));
+    nutmeg_memory_count_allocation(parent);
+    NutmegScene *scene = (NutmegScene *)nutmeg_allocator_alloc(&engine->allocator, sizeof(*scene));
     if (!scene) {
         return NULL;
     }
+    memset(scene, 0, sizeof(*scene));
+
+    if (!nutmeg_mutex_init(&scene->command_lock)) {
+        nutmeg_allocator_free(&engine->allocator, scene, sizeof(*scene));
+        return NULL;
+    }
+    if (!nutmeg_mutex_init(&scene->spatial_lock)) {
+        nutmeg_mutex_destroy(&scene->command_lock);
+        nutmeg_allocator_free(&engine->allocator, scene, sizeof(*scene));
+        return NULL;
+    }
+
+    /* the scene account is embedded in the scene, so the struct is charged once it exists */
+    nutmeg_memory_account_init(&scene->memory, parent, &engine->allocator);
+    nutmeg_memory_charge(&scene->memory, NUTMEG_MEMORY_ENGINE, sizeof(*scene));
+
+    size_t name_length = name ? strlen(name) : 0;
+    scene->name = (char *)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_ENGINE, name_length + 1);
+    if (!scene->name) {
+        nutmeg_memory_release(&scene->memory, NUTMEG_MEMORY_ENGINE, sizeof(*scene));
+        nutmeg_mutex_destroy(&scene->spatial_lock);
+        nutmeg_mutex_destroy(&scene->command_lock);
+        nutmeg_allocator_free(&engine->allocator, scene, sizeof(*scene));
+        return NULL;
+    }
+    memcpy(scene->name, name ? name : "", name_length);
 
     scene->engine = engine;
+    scene->chunks = NULL;
+    scene->chunk_count = 0;
+    scene->chunk_capacity = 0;
+    scene->pending_chunks = NULL;
+    scene->pending_chunk_count = 0;
+    scene->pending_chunk_capacity = 0;
+    scene->free_slots = NULL;
+    scene->free_count = 0;
+    scene->free_capacity = 0;
+    scene->slot_count = 0;
     scene->objects = NULL;
     scene->object_count = 0;
     scene->object_capacity = 0;
+    scene->id_map.ids = NULL;
+    scene->id_map.slots = NULL;
+    scene->id_map.count = 0;
+    scene->id_map.capacity = 0;
+    scene->name_lists = NULL;
+    scene->name_list_count = 0;
+    scene->name_list_capacity = 0;
+    scene->query_groups = NULL;
+    scene->query_group_count = 0;
+    scene->query_group_capacity = 0;
+    memset(&scene->commands, 0, sizeof(scene->commands));
+    nutmeg_spatial_hash_init(&scene->spatial, &scene->memory, NUTMEG_SPATIAL_CELL_SIZE_DEFAULT);
+    scene->spatial_valid = 0;
+    scene->defer_depth = 0;
     scene->events = NULL;
     scene->event_count = 0;
     scene->event_capacity = 0;
+    scene->event_stats = NULL;
+    scene->event_stats_capacity = 0;
+    memset(&scene->program, 0, sizeof(scene->program));
+    scene->sample_clock = 0;
     scene->next_object_id = 1;
+    scene->last_delta = 0.0f;
+    scene->pending_delta = 0.0f;
+    scene->rate_divider = 0;
+    scene->steps_waited = 0;
+    scene->priority = 0;
+    scene->schedule_prev = NULL;
+    scene->schedule_next = NULL;
+    scene->tick_lane = 0;
+    scene->tick_nested = false;
+    nutmeg_checkpoint_ring_init(&scene->checkpoints, &scene->memory);
+    scene->structure_version = 0;
+    scene->structure_counter = 0;
 
-    if (name) {
-        strncpy(scene->name, name, sizeof(scene->name) - 1);
-        scene->name[sizeof(scene->name) - 1] = '\0';
-    } else {
-        scene->name[0] = '\0';
+    return scene;
+}
+
+/* True when two neighbouring conditions are pure, the only case adaptive ordering can change. */
+static bool nutmeg_event_is_reorderable(const NutmegEvent *event)
+{
+    for (size_t i = 1; i < event->condition_count; ++i) {
+        if ((event->conditions[i - 1].flags & NUTMEG_CONDITION_FLAG_PURE) && (event->conditions[i].flags & NUTMEG_CONDITION_FLAG_PURE)) {
+            return true;
+        }
     }
+    return false;
+}
 
-    return scene;
+static NutmegConditionPlan *nutmeg_condition_plan_create(NutmegMemoryAccount *account, const NutmegEvent *event)
+{
+    size_t slot_count = event->condition_count + event->action_count;
+    NutmegConditionPlan *plan = (NutmegConditionPlan *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_EVENTS, sizeof(*plan));
+    if (plan) {
+        plan->sample.slots = (NutmegSlotStats *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_EVENTS, slot_count * sizeof(NutmegSlotStats));
+        plan->estimates = (NutmegConditionEstimate *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_EVENTS, event->condition_count * sizeof(NutmegConditionEstimate));
+    }
+    if (!plan || !plan->sample.slots || !plan->estimates) {
+        /* allocation failure is fatal */
+        abort();
+    }
+
+    for (size_t i = 0; i < event->condition_count; ++i) {
+        plan->estimates[i].origin = i;
+    }
+    return plan;
+}
+
+static void nutmeg_condition_plan_free(NutmegMemoryAccount *account, NutmegConditionPlan *plan, const NutmegEvent *event)
+{
+    if (!plan) {
+        return;
+    }
+
+    nutmeg_memory_free(account, NUTMEG_MEMORY_EVENTS, plan->sample.slots, (event->condition_count + event->action_count) * sizeof(NutmegSlotStats));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_EVENTS, plan->estimates, event->condition_count * sizeof(NutmegConditionEstimate));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_EVENTS, plan, sizeof(*plan));
 }
 
-static void nutmeg_event_free(NutmegEvent *event)
+/* Position the condition inserted at condition_index currently runs at. */
+static size_t nutmeg_condition_position(const NutmegEventStats *stats, size_t condition_index)
+{
+    if (stats->plan) {
+        for (size_t k = 0;; ++k) {
+            if (stats->plan->estimates[k].origin == condition_index) {
+                return k;
+            }
+        }
+    }
+    return condition_index;
+}
+
+static void nutmeg_event_free(NutmegMemoryAccount *account, NutmegEvent *event)
 {
     if (!event) {
         return;
     }
 
-    free(event->conditions);
-    free(event->actions);
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, event->conditions, sizeof(NutmegCondition), event->condition_capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, event->actions, sizeof(NutmegAction), event->action_capacity);
     event->conditions = NULL;
     event->actions = NULL;
     event->condition_count = 0;
@@ -110,41 +627,59 @@ static void nutmeg_scene_free(NutmegScene *scene)
         return;
     }
 
-    for (size_t i = 0; i < scene->object_count; ++i) {
-        free(scene->objects[i]);
+    NutmegMemoryAccount *account = &scene->memory;
+    for (size_t i = 0; i < scene->chunk_count; ++i) {
+        nutmeg_memory_free(account, NUTMEG_MEMORY_OBJECTS, scene->chunks[i]->cold, NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(NutmegObjectCold));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_OBJECTS, scene->chunks[i], sizeof(NutmegObjectChunk));
     }
-    free(scene->objects);
-    scene->objects = NULL;
-
-    for (size_t i = 0; i < scene->event_count; ++i) {
-        nutmeg_event_free(&scene->events[i]);
+    nutmeg_free_array(account, NUTMEG_MEMORY_OBJECTS, scene->chunks, sizeof(NutmegObjectChunk *), scene->chunk_capacity);
+    scene->chunks = NULL;
+    for (size_t i = 0; i < scene->pending_chunk_count; ++i) {
+        nutmeg_memory_free(account, NUTMEG_MEMORY_OBJECTS, scene->pending_chunks[i]->cold, NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(NutmegObjectCold));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_OBJECTS, scene->pending_chunks[i], sizeof(NutmegObjectChunk));
     }
-    free(scene->events);
-    scene->events = NULL;
-
-    free(scene);
-}
-
-static size_t nutmeg_scene_estimated_memory(const NutmegScene *scene)
-{
-    if (!scene) {
-        return 0;
+    nutmeg_free_array(account, NUTMEG_MEMORY_OBJECTS, scene->pending_chunks, sizeof(NutmegObjectChunk *), scene->pending_chunk_capacity);
+    scene->pending_chunks = NULL;
+    nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, scene->free_slots, sizeof(size_t), scene->free_capacity);
+    scene->free_slots = NULL;
+    nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, scene->objects, sizeof(NutmegObject *), scene->object_capacity);
+    scene->objects = NULL;
+    nutmeg_id_map_free(&scene->id_map, account);
+    for (size_t i = 0; i < scene->name_list_count; ++i) {
+        nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, scene->name_lists[i].objects, sizeof(NutmegObject *), scene->name_lists[i].capacity);
     }
-
-    size_t total = sizeof(*scene);
-    total += scene->object_capacity * sizeof(NutmegObject *);
-    for (size_t i = 0; i < scene->object_count; ++i) {
-        total += sizeof(*scene->objects[i]);
+    nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, scene->name_lists, sizeof(NutmegObjectList), scene->name_list_capacity);
+    for (size_t i = 0; i < scene->query_group_count; ++i) {
+        NutmegQueryGroup *group = &scene->query_groups[i];
+        nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, group->members.objects, sizeof(NutmegObject *), group->members.capacity);
+        nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, group->positions, sizeof(size_t), group->position_capacity);
     }
+    nutmeg_free_array(account, NUTMEG_MEMORY_INDEXES, scene->query_groups, sizeof(NutmegQueryGroup), scene->query_group_capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_COMMANDS, scene->commands.spawn_slots, sizeof(size_t), scene->commands.spawn_capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_COMMANDS, scene->commands.destroy_slots, sizeof(size_t), scene->commands.destroy_capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_COMMANDS, scene->commands.reindex_slots, sizeof(size_t), scene->commands.reindex_capacity);
 
-    total += scene->event_capacity * sizeof(NutmegEvent);
     for (size_t i = 0; i < scene->event_count; ++i) {
-        const NutmegEvent *event = &scene->events[i];
-        total += event->condition_capacity * sizeof(NutmegCondition);
-        total += event->action_capacity * sizeof(NutmegAction);
+        NutmegEvent *event = &scene->events[i];
+        nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, scene->event_stats[i].slots, sizeof(NutmegSlotStats), event->condition_count + event->action_count);
+        nutmeg_condition_plan_free(account, scene->event_stats[i].plan, event);
+        nutmeg_event_free(account, event);
     }
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, scene->events, sizeof(NutmegEvent), scene->event_capacity);
+    scene->events = NULL;
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, scene->event_stats, sizeof(NutmegEventStats), scene->event_stats_capacity);
+    scene->event_stats = NULL;
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, scene->program.ops, sizeof(NutmegOp), scene->program.op_capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, scene->program.conditions, sizeof(NutmegCondition), scene->program.condition_capacity);
+    nutmeg_free_array(account, NUTMEG_MEMORY_EVENTS, scene->program.actions, sizeof(NutmegAction), scene->program.action_capacity);
 
-    return total;
+    nutmeg_checkpoint_ring_free(&scene->checkpoints);
+    nutmeg_spatial_hash_free(&scene->spatial);
+    nutmeg_mutex_destroy(&scene->spatial_lock);
+    nutmeg_mutex_destroy(&scene->command_lock);
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, scene->name, strlen(scene->name) + 1);
+    nutmeg_memory_release(account, NUTMEG_MEMORY_ENGINE, sizeof(*scene));
+    nutmeg_allocator_free(&scene->engine->allocator, scene, sizeof(*scene));
 }
 
 static float nutmeg_clamp_percentage(float value)
@@ -158,7 +693,7 @@ static float nutmeg_clamp_percentage(float value)
     return value;
 }
 
-static void nutmeg_engine_update_metrics(NutmegEngine *engine, double tick_cpu_time, float delta_seconds)
+static void nutmeg_engine_update_metrics(NutmegEngine *engine, double tick_cpu_time, unsigned long long tick_wall_ns, float delta_seconds)
 {
     if (!engine) {
         return;
@@ -169,42 +704,103 @@ static void nutmeg_engine_update_metrics(NutmegEngine *engine, double tick_cpu_t
         cpu_usage = (float)((tick_cpu_time / (double)delta_seconds) * 100.0);
     }
 
-    size_t total_memory = sizeof(*engine) + engine->scene_capacity * sizeof(NutmegScene *);
-    for (size_t i = 0; i < engine->scene_count; ++i) {
-        total_memory += nutmeg_scene_estimated_memory(engine->scenes[i]);
+    /* the accounts are maintained on every allocation, reading them is O(1) */
+    size_t memory_live = (size_t)nutmeg_atomic_load_u64(&engine->memory.total_live);
+    size_t memory_peak = (size_t)nutmeg_atomic_load_u64(&engine->memory.total_peak);
+    float ram_usage = 0.0f;
+    if (engine->memory_budget > 0) {
+        ram_usage = nutmeg_clamp_percentage((float)((double)memory_live / (double)engine->memory_budget * 100.0));
     }
 
-    const float budget_mb = 256.0f;
-    float ram_usage = (float)total_memory / (1024.0f * 1024.0f);
-    ram_usage = nutmeg_clamp_percentage((ram_usage / budget_mb) * 100.0f);
-
-    engine->gpu_meter_phase += delta_seconds * 0.8f;
-    float oscillation = (sinf(engine->gpu_meter_phase) + 1.0f) * 15.0f;
-    float gpu_usage = nutmeg_clamp_percentage(0.6f * cpu_usage + oscillation);
+    nutmeg_tick_ring_push(&engine->tick_ring, tick_wall_ns);
+    nutmeg_tick_histogram_record(&engine->tick_histogram, tick_wall_ns);
+    NutmegTickStats ticks;
+    nutmeg_tick_ring_stats(&engine->tick_ring, engine->tick_window, &ticks);
 
     engine->metrics.cpu_usage = nutmeg_clamp_percentage(cpu_usage);
     engine->metrics.ram_usage = ram_usage;
-    engine->metrics.gpu_usage = nutmeg_clamp_percentage(0.5f * engine->metrics.gpu_usage + 0.5f * gpu_usage);
+    engine->metrics.memory_live = memory_live;
+    engine->metrics.memory_peak = memory_peak;
+    engine->metrics.memory_budget = engine->memory_budget;
+    engine->metrics.frame_arena_peak = engine->frame_arena.high_water;
+    engine->metrics.frame_arena_capacity = engine->frame_arena.capacity;
+    engine->metrics.tick_p50_ms = (float)((double)ticks.p50_ns * 1e-6);
+    engine->metrics.tick_p95_ms = (float)((double)ticks.p95_ns * 1e-6);
+    engine->metrics.tick_p99_ms = (float)((double)ticks.p99_ns * 1e-6);
+    engine->metrics.tick_max_ms = (float)((double)ticks.max_ns * 1e-6);
 }
 
 NutmegEngine *nutmeg_engine_create(void)
 {
-    NutmegEngine *engine = (NutmegEngine *)calloc(1, sizeof(*engine));
+    return nutmeg_engine_create_with_allocator(&nutmeg_default_allocator);
+}
+
+NutmegEngine *nutmeg_engine_create_with_allocator(const NutmegAllocator *allocator)
+{
+    if (!nutmeg_allocator_is_valid(allocator)) {
+        return NULL;
+    }
+
+    NutmegEngine *engine = (NutmegEngine *)nutmeg_allocator_alloc(allocator, sizeof(*engine));
     if (!engine) {
         return NULL;
     }
+    memset(engine, 0, sizeof(*engine));
+
+    /* the account points at the engine's own copy so the caller's struct need not outlive this call */
+    engine->allocator = *allocator;
+    nutmeg_memory_account_init(&engine->memory, NULL, &engine->allocator);
+    nutmeg_memory_count_allocation(&engine->memory);
+    nutmeg_memory_charge(&engine->memory, NUTMEG_MEMORY_ENGINE, sizeof(*engine));
+    engine->memory_budget = NUTMEG_MEMORY_BUDGET_DEFAULT;
+    engine->allocation_guard = NUTMEG_ALLOCATION_GUARD_OFF;
+
+    if (!nutmeg_symbol_table_init(&engine->symbols, &engine->memory)) {
+        nutmeg_allocator_free(allocator, engine, sizeof(*engine));
+        return NULL;
+    }
+    if (!nutmeg_mutex_init(&engine->tag_lock)) {
+        nutmeg_symbol_table_free(&engine->symbols);
+        nutmeg_allocator_free(allocator, engine, sizeof(*engine));
+        return NULL;
+    }
+    if (!nutmeg_frame_arena_init(&engine->frame_arena, &engine->memory)) {
+        nutmeg_mutex_destroy(&engine->tag_lock);
+        nutmeg_symbol_table_free(&engine->symbols);
+        nutmeg_allocator_free(allocator, engine, sizeof(*engine));
+        return NULL;
+    }
 
-    engine->scenes = NULL;
+    nutmeg_scene_registry_init(&engine->scenes, &engine->memory);
     engine->scene_count = 0;
-    engine->scene_capacity = 0;
+    engine->schedule = NULL;
+    engine->schedule_count = 0;
+    engine->schedule_buckets = NULL;
+    engine->schedule_bucket_count = 0;
+    engine->schedule_bucket_capacity = 0;
+    engine->due_scenes = NULL;
+    engine->due_capacity = 0;
+    engine->concurrent_scenes = false;
+    engine->stepping = false;
     engine->active_scene = NULL;
     engine->time = 0.0f;
     engine->last_delta = 0.0f;
+    engine->fixed_step = 0.0f;
+    engine->max_steps = 1;
+    engine->accumulator = 0.0;
+    engine->interpolation_alpha = 0.0f;
     engine->userdata = NULL;
     engine->metrics.cpu_usage = 0.0f;
     engine->metrics.ram_usage = 0.0f;
-    engine->metrics.gpu_usage = 0.0f;
-    engine->gpu_meter_phase = 0.0f;
+    engine->tick_window = NUTMEG_TICK_WINDOW_DEFAULT;
+    engine->trace = NULL;
+    engine->loader = NULL;
+    engine->profiling = false;
+    engine->adaptive_conditions = false;
+    engine->event_fusion = true;
+    engine->pool = NULL;
+    engine->parallel_chunks = NULL;
+    engine->parallel_chunk_capacity = 0;
     return engine;
 }
 
@@ -214,12 +810,51 @@ void nutmeg_engine_destroy(NutmegEngine *engine)
         return;
     }
 
-    for (size_t i = 0; i < engine->scene_count; ++i) {
-        nutmeg_scene_free(engine->scenes[i]);
+    if (engine->trace) {
+        nutmeg_trace_destroy(engine->trace);
+    }
+    if (engine->loader) {
+        /* waits for the scene being built; nothing left over was registered */
+        NutmegSceneLoad *load = nutmeg_scene_loader_destroy(engine->loader);
+        while (load) {
+            NutmegSceneLoad *next = load->next;
+            nutmeg_scene_free(load->scene);
+            nutmeg_memory_free(&engine->memory, NUTMEG_MEMORY_ENGINE, load, sizeof(*load));
+            load = next;
+        }
+    }
+    for (size_t i = 0; i < engine->scenes.slot_count; ++i) {
+        if (engine->scenes.slots[i].scene) {
+            nutmeg_scene_free(engine->scenes.slots[i].scene);
+        }
+    }
+
+    nutmeg_thread_pool_destroy(engine->pool);
+    nutmeg_free_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->parallel_chunks, sizeof(NutmegObjectChunk *), engine->parallel_chunk_capacity);
+    nutmeg_scene_registry_free(&engine->scenes);
+    nutmeg_free_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->schedule_buckets, sizeof(NutmegScheduleBucket), engine->schedule_bucket_capacity);
+    nutmeg_free_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->due_scenes, sizeof(NutmegScene *), engine->due_capacity);
+    nutmeg_frame_arena_free(&engine->frame_arena);
+    nutmeg_mutex_destroy(&engine->tag_lock);
+    nutmeg_symbol_table_free(&engine->symbols);
+
+    /* copy the hooks out first: the engine struct holds them */
+    NutmegAllocator allocator = engine->allocator;
+    nutmeg_allocator_free(&allocator, engine, sizeof(*engine));
+}
+
+void nutmeg_engine_set_allocation_guard(NutmegEngine *engine, NutmegAllocationGuard guard)
+{
+    if (!engine) {
+        return;
     }
 
-    free(engine->scenes);
-    free(engine);
+    engine->allocation_guard = guard;
+}
+
+unsigned long long nutmeg_engine_guarded_allocations(const NutmegEngine *engine)
+{
+    return engine ? nutmeg_atomic_load_u64((NutmegAtomicU64 *)&engine->memory.guarded_allocations) : 0;
 }
 
 void nutmeg_engine_set_userdata(NutmegEngine *engine, void *userdata)
@@ -253,294 +888,3068 @@ const NutmegEngineMetrics *nutmeg_engine_metrics(const NutmegEngine *engine)
     return engine ? &engine->metrics : NULL;
 }
 
-NutmegScene *nutmeg_engine_add_scene(NutmegEngine *engine, const char *name)
+void nutmeg_engine_set_tick_window(NutmegEngine *engine, size_t ticks)
 {
     if (!engine) {
-        return NULL;
-    }
-
-    NutmegScene *scene = nutmeg_scene_create(engine, name);
-    if (!scene) {
-        return NULL;
+        return;
     }
-
-    engine->scenes = (NutmegScene **)nutmeg_realloc_array(engine->scenes, sizeof(NutmegScene *), &engine->scene_capacity, engine->scene_count + 1);
-    engine->scenes[engine->scene_count++] = scene;
-
-    if (!engine->active_scene) {
-        engine->active_scene = scene;
+    if (ticks > NUTMEG_TICK_HISTORY_CAPACITY) {
+        ticks = NUTMEG_TICK_HISTORY_CAPACITY;
     }
-
-    return scene;
+    engine->tick_window = ticks > 0 ? ticks : 1;
 }
 
-NutmegScene *nutmeg_engine_find_scene(NutmegEngine *engine, const char *name)
+bool nutmeg_engine_tick_stats(const NutmegEngine *engine, size_t window, NutmegTickStats *out_stats)
 {
-    if (!engine || !name) {
-        return NULL;
+    if (!engine || !out_stats) {
+        return false;
     }
 
-    for (size_t i = 0; i < engine->scene_count; ++i) {
-        NutmegScene *scene = engine->scenes[i];
-        if (strncmp(scene->name, name, sizeof(scene->name)) == 0) {
-            return scene;
-        }
+    if (window == 0) {
+        nutmeg_tick_histogram_stats((NutmegTickHistogram *)&engine->tick_histogram, out_stats);
+    } else {
+        nutmeg_tick_ring_stats((NutmegTickRing *)&engine->tick_ring, window, out_stats);
     }
+    return true;
+}
 
-    return NULL;
+size_t nutmeg_engine_tick_history(const NutmegEngine *engine, unsigned long long *out_durations_ns, size_t capacity)
+{
+    if (!engine || !out_durations_ns) {
+        return 0;
+    }
+    return nutmeg_tick_ring_copy((NutmegTickRing *)&engine->tick_ring, out_durations_ns, capacity);
 }
 
-bool nutmeg_engine_set_active_scene(NutmegEngine *engine, const char *name)
+bool nutmeg_engine_trace_start(NutmegEngine *engine, const char *path, unsigned int tick_count, size_t buffer_bytes)
 {
-    if (!engine) {
+    if (!engine || !path) {
         return false;
     }
 
-    if (name == NULL) {
-        engine->active_scene = NULL;
-        return true;
+    if (engine->trace) {
+        nutmeg_engine_trace_stop(engine);
     }
+    engine->trace = nutmeg_trace_create(&engine->memory, path, buffer_bytes > 0 ? buffer_bytes : NUTMEG_TRACE_BUFFER_DEFAULT, tick_count);
+    return engine->trace != NULL;
+}
 
-    NutmegScene *scene = nutmeg_engine_find_scene(engine, name);
-    if (!scene) {
-        return false;
+unsigned long long nutmeg_engine_trace_stop(NutmegEngine *engine)
+{
+    if (!engine || !engine->trace) {
+        return 0;
     }
 
-    engine->active_scene = scene;
-    return true;
+    unsigned long long dropped = nutmeg_trace_destroy(engine->trace);
+    engine->trace = NULL;
+    return dropped;
 }
 
-NutmegScene *nutmeg_engine_get_active_scene(NutmegEngine *engine)
+bool nutmeg_engine_tracing(const NutmegEngine *engine)
 {
-    if (!engine) {
-        return NULL;
-    }
-    return engine->active_scene;
+    return engine && nutmeg_engine_recording_trace(engine) != NULL;
 }
 
-NutmegObject *nutmeg_scene_spawn_object(NutmegScene *scene, const char *name)
+void nutmeg_engine_set_memory_budget(NutmegEngine *engine, size_t budget_bytes)
 {
-    if (!scene) {
-        return NULL;
+    if (!engine) {
+        return;
     }
+    engine->memory_budget = budget_bytes;
+}
 
-    NutmegObject *object = (NutmegObject *)calloc(1, sizeof(*object));
-    if (!object) {
-        return NULL;
+bool nutmeg_engine_memory_stats(const NutmegEngine *engine, NutmegMemoryStats *out_stats)
+{
+    if (!engine || !out_stats) {
+        return false;
     }
+    nutmeg_memory_read((NutmegMemoryAccount *)&engine->memory, out_stats);
+    return true;
+}
 
-    object->scene = scene;
-    object->alive = true;
-    object->id = scene->next_object_id++;
-    object->position.x = 0.0f;
-    object->position.y = 0.0f;
-    object->velocity.x = 0.0f;
-    object->velocity.y = 0.0f;
-    object->userdata = NULL;
-
-    if (name) {
-        strncpy(object->name, name, sizeof(object->name) - 1);
-        object->name[sizeof(object->name) - 1] = '\0';
-    } else {
-        object->name[0] = '\0';
+bool nutmeg_scene_memory_stats(const NutmegScene *scene, NutmegMemoryStats *out_stats)
+{
+    if (!scene || !out_stats) {
+        return false;
     }
-
-    scene->objects = (NutmegObject **)nutmeg_realloc_array(scene->objects, sizeof(NutmegObject *), &scene->object_capacity, scene->object_count + 1);
-    scene->objects[scene->object_count++] = object;
-
-    return object;
+    nutmeg_memory_read((NutmegMemoryAccount *)&scene->memory, out_stats);
+    return true;
 }
 
-static void nutmeg_scene_remove_object(NutmegScene *scene, size_t index)
+void nutmeg_engine_set_profiling(NutmegEngine *engine, bool enabled)
 {
-    if (index >= scene->object_count) {
+    if (!engine) {
         return;
     }
+    engine->profiling = enabled;
+}
 
-    free(scene->objects[index]);
-    scene->objects[index] = NULL;
-
-    size_t last = scene->object_count - 1;
-    if (index != last) {
-        scene->objects[index] = scene->objects[last];
-    }
-    scene->objects[last] = NULL;
-    scene->object_count--;
+bool nutmeg_engine_profiling(const NutmegEngine *engine)
+{
+    return engine ? engine->profiling : false;
 }
 
-void nutmeg_scene_destroy_object(NutmegScene *scene, NutmegObject *object)
+void nutmeg_engine_reset_profile(NutmegEngine *engine)
 {
-    if (!scene || !object) {
+    if (!engine) {
         return;
     }
 
-    for (size_t i = 0; i < scene->object_count; ++i) {
-        if (scene->objects[i] == object) {
-            nutmeg_scene_remove_object(scene, i);
-            break;
+    for (size_t i = 0; i < engine->scenes.slot_count; ++i) {
+        NutmegScene *scene = engine->scenes.slots[i].scene;
+        if (!scene) {
+            continue;
+        }
+        for (size_t e = 0; e < scene->event_count; ++e) {
+            NutmegEventStats *stats = &scene->event_stats[e];
+            size_t slot_count = scene->events[e].condition_count + scene->events[e].action_count;
+            NutmegSlotStats *slots = stats->slots;
+            struct NutmegConditionPlan *plan = stats->plan;
+            memset(stats, 0, sizeof(*stats));
+            stats->slots = slots;
+            stats->plan = plan;
+            if (slot_count > 0) {
+                memset(slots, 0, slot_count * sizeof(NutmegSlotStats));
+            }
         }
     }
 }
 
-unsigned long nutmeg_object_id(const NutmegObject *object)
+size_t nutmeg_scene_event_count(const NutmegScene *scene)
 {
-    return object ? object->id : 0UL;
+    return scene ? scene->event_count : 0;
 }
 
-const char *nutmeg_object_name(const NutmegObject *object)
+bool nutmeg_scene_event_profile(const NutmegScene *scene, size_t event_index, NutmegEventProfile *out_profile)
 {
-    return object ? object->name : NULL;
+    if (!scene || !out_profile || event_index >= scene->event_count) {
+        return false;
+    }
+
+    NutmegEventStats *stats = &scene->event_stats[event_index];
+    out_profile->runs = nutmeg_atomic_load_u64(&stats->runs);
+    out_profile->triggers = nutmeg_atomic_load_u64(&stats->triggers);
+    out_profile->time_ns = nutmeg_atomic_load_u64(&stats->time_ns);
+    out_profile->tested = nutmeg_atomic_load_u64(&stats->tested);
+    out_profile->passed = nutmeg_atomic_load_u64(&stats->passed);
+    return true;
 }
 
-NutmegVec2 *nutmeg_object_position(NutmegObject *object)
+static void nutmeg_slot_profile_read(NutmegSlotStats *slot, NutmegSlotProfile *out_profile)
 {
-    return object ? &object->position : NULL;
+    out_profile->calls = nutmeg_atomic_load_u64(&slot->calls);
+    out_profile->tested = nutmeg_atomic_load_u64(&slot->tested);
+    out_profile->passed = nutmeg_atomic_load_u64(&slot->passed);
+    out_profile->time_ns = nutmeg_atomic_load_u64(&slot->time_ns);
 }
 
-NutmegVec2 *nutmeg_object_velocity(NutmegObject *object)
+bool nutmeg_scene_condition_profile(const NutmegScene *scene, size_t event_index, size_t condition_index, NutmegSlotProfile *out_profile)
 {
-    return object ? &object->velocity : NULL;
+    if (!scene || !out_profile || event_index >= scene->event_count || condition_index >= scene->events[event_index].condition_count) {
+        return false;
+    }
+
+    const NutmegEventStats *stats = &scene->event_stats[event_index];
+    nutmeg_slot_profile_read(&stats->slots[nutmeg_condition_position(stats, condition_index)], out_profile);
+    return true;
 }
 
-void nutmeg_object_set_userdata(NutmegObject *object, void *userdata)
+bool nutmeg_scene_action_profile(const NutmegScene *scene, size_t event_index, size_t action_index, NutmegSlotProfile *out_profile)
 {
-    if (!object) {
-        return;
+    if (!scene || !out_profile || event_index >= scene->event_count || action_index >= scene->events[event_index].action_count) {
+        return false;
     }
-    object->userdata = userdata;
+
+    const NutmegEvent *event = &scene->events[event_index];
+    nutmeg_slot_profile_read(&scene->event_stats[event_index].slots[event->condition_count + action_index], out_profile);
+    return true;
 }
 
-void *nutmeg_object_userdata(NutmegObject *object)
+NutmegSymbol nutmeg_engine_intern(NutmegEngine *engine, const char *string)
 {
-    return object ? object->userdata : NULL;
+    return engine ? nutmeg_symbol_table_intern(&engine->symbols, string) : NUTMEG_SYMBOL_NONE;
 }
 
-NutmegScene *nutmeg_object_scene(NutmegObject *object)
+NutmegSymbol nutmeg_engine_find_symbol(NutmegEngine *engine, const char *string)
 {
-    return object ? object->scene : NULL;
+    return engine ? nutmeg_symbol_table_find(&engine->symbols, string) : NUTMEG_SYMBOL_NONE;
 }
 
-void nutmeg_scene_add_event(NutmegScene *scene, NutmegEvent event)
+const char *nutmeg_engine_symbol_name(NutmegEngine *engine, NutmegSymbol symbol)
 {
-    if (!scene) {
-        return;
-    }
+    return engine ? nutmeg_symbol_table_name(&engine->symbols, symbol) : NULL;
+}
+
+unsigned long long nutmeg_engine_tag(NutmegEngine *engine, const char *tag)
+{
+    if (!engine) {
+        return 0;
+    }
+
+    NutmegSymbol symbol = nutmeg_symbol_table_intern(&engine->symbols, tag);
+    if (symbol == NUTMEG_SYMBOL_NONE) {
+        return 0;
+    }
+
+    unsigned long long bit = 0;
+    nutmeg_mutex_lock(&engine->tag_lock);
+    unsigned int index = 0;
+    while (index < engine->tag_count && engine->tags[index] != symbol) {
+        ++index;
+    }
+    if (index == engine->tag_count && index < NUTMEG_TAG_CAPACITY) {
+        engine->tags[engine->tag_count++] = symbol;
+    }
+    if (index < engine->tag_count) {
+        bit = 1ULL << index;
+    }
+    nutmeg_mutex_unlock(&engine->tag_lock);
+    return bit;
+}
+
+bool nutmeg_engine_set_worker_count(NutmegEngine *engine, unsigned int worker_count)
+{
+    if (!engine) {
+        return false;
+    }
+
+    if (worker_count == NUTMEG_WORKER_COUNT_AUTO) {
+        worker_count = nutmeg_hardware_concurrency();
+    }
+    if (worker_count == nutmeg_thread_pool_size(engine->pool)) {
+        return true;
+    }
+
+    nutmeg_thread_pool_destroy(engine->pool);
+    engine->pool = NULL;
+    if (worker_count < 2) {
+        return true;
+    }
+
+    engine->pool = nutmeg_thread_pool_create(&engine->memory, worker_count);
+    return engine->pool != NULL;
+}
+
+unsigned int nutmeg_engine_worker_count(const NutmegEngine *engine)
+{
+    return engine ? nutmeg_thread_pool_size(engine->pool) : 1u;
+}
+
+void nutmeg_engine_set_adaptive_conditions(NutmegEngine *engine, bool enabled)
+{
+    if (!engine) {
+        return;
+    }
+
+    engine->adaptive_conditions = enabled;
+}
+
+bool nutmeg_engine_adaptive_conditions(const NutmegEngine *engine)
+{
+    return engine ? engine->adaptive_conditions : false;
+}
+
+void nutmeg_engine_set_event_fusion(NutmegEngine *engine, bool enabled)
+{
+    if (!engine) {
+        return;
+    }
+
+    engine->event_fusion = enabled;
+}
+
+bool nutmeg_engine_event_fusion(const NutmegEngine *engine)
+{
+    return engine ? engine->event_fusion : false;
+}
+
+/* First bucket whose priority is not above the given one. */
+static size_t nutmeg_engine_schedule_bucket(const NutmegEngine *engine, int priority)
+{
+    size_t low = 0;
+    size_t high = engine->schedule_bucket_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (engine->schedule_buckets[mid].priority > priority) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Link a scene with a rate divider into the schedule at the end of its
+ * priority's bucket, so scenes of one priority keep the order they were
+ * scheduled in. Finding the bucket is a binary search over the distinct
+ * priorities; the bucket array only shifts when a priority is new.
+ */
+static void nutmeg_engine_schedule_insert(NutmegEngine *engine, NutmegScene *scene)
+{
+    engine->due_scenes = (NutmegScene **)nutmeg_realloc_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->due_scenes, sizeof(NutmegScene *), &engine->due_capacity, engine->schedule_count + 2);
+
+    size_t at = nutmeg_engine_schedule_bucket(engine, scene->priority);
+    if (at == engine->schedule_bucket_count || engine->schedule_buckets[at].priority != scene->priority) {
+        engine->schedule_buckets = (NutmegScheduleBucket *)nutmeg_realloc_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->schedule_buckets, sizeof(NutmegScheduleBucket), &engine->schedule_bucket_capacity, engine->schedule_bucket_count + 1);
+        memmove(&engine->schedule_buckets[at + 1], &engine->schedule_buckets[at], (engine->schedule_bucket_count - at) * sizeof(NutmegScheduleBucket));
+        engine->schedule_bucket_count++;
+        engine->schedule_buckets[at].priority = scene->priority;
+        engine->schedule_buckets[at].head = NULL;
+        engine->schedule_buckets[at].tail = NULL;
+    }
+
+    NutmegScheduleBucket *bucket = &engine->schedule_buckets[at];
+    NutmegScene *prev = bucket->tail ? bucket->tail : (at > 0 ? engine->schedule_buckets[at - 1].tail : NULL);
+    scene->schedule_prev = prev;
+    scene->schedule_next = prev ? prev->schedule_next : engine->schedule;
+    if (scene->schedule_next) {
+        scene->schedule_next->schedule_prev = scene;
+    }
+    if (prev) {
+        prev->schedule_next = scene;
+    } else {
+        engine->schedule = scene;
+    }
+    if (!bucket->head) {
+        bucket->head = scene;
+    }
+    bucket->tail = scene;
+    engine->schedule_count++;
+}
+
+/* Unlink a scheduled scene, dropping its bucket when it was the last of its priority. */
+static void nutmeg_engine_schedule_erase(NutmegEngine *engine, NutmegScene *scene)
+{
+    size_t at = nutmeg_engine_schedule_bucket(engine, scene->priority);
+    NutmegScheduleBucket *bucket = &engine->schedule_buckets[at];
+    if (bucket->head == scene && bucket->tail == scene) {
+        memmove(&engine->schedule_buckets[at], &engine->schedule_buckets[at + 1], (engine->schedule_bucket_count - at - 1) * sizeof(NutmegScheduleBucket));
+        engine->schedule_bucket_count--;
+    } else if (bucket->head == scene) {
+        bucket->head = scene->schedule_next;
+    } else if (bucket->tail == scene) {
+        bucket->tail = scene->schedule_prev;
+    }
+
+    if (scene->schedule_prev) {
+        scene->schedule_prev->schedule_next = scene->schedule_next;
+    } else {
+        engine->schedule = scene->schedule_next;
+    }
+    if (scene->schedule_next) {
+        scene->schedule_next->schedule_prev = scene->schedule_prev;
+    }
+    scene->schedule_prev = NULL;
+    scene->schedule_next = NULL;
+    engine->schedule_count--;
+}
+
+/* Register a created scene with the engine. Returns false when its name is taken or on allocation failure. */
+static bool nutmeg_engine_register_scene(NutmegEngine *engine, NutmegScene *scene)
+{
+    if (nutmeg_engine_find_scene(engine, scene->name) || !nutmeg_scene_registry_insert(&engine->scenes, scene, scene->name, &scene->handle)) {
+        return false;
+    }
+
+    /* room for the active scene next to the schedule */
+    engine->due_scenes = (NutmegScene **)nutmeg_realloc_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->due_scenes, sizeof(NutmegScene *), &engine->due_capacity, engine->schedule_count + 1);
+    if (scene->rate_divider > 0) {
+        nutmeg_engine_schedule_insert(engine, scene);
+    }
+    engine->scene_count++;
+
+    if (!engine->active_scene) {
+        engine->active_scene = scene;
+    }
+    return true;
+}
+
+NutmegScene *nutmeg_engine_add_scene(NutmegEngine *engine, const char *name)
+{
+    if (!engine) {
+        return NULL;
+    }
+
+    NutmegScene *scene = nutmeg_scene_create(engine, name, &engine->memory);
+    if (!scene) {
+        return NULL;
+    }
+    if (!nutmeg_engine_register_scene(engine, scene)) {
+        nutmeg_scene_free(scene);
+        return NULL;
+    }
+    return scene;
+}
+
+bool nutmeg_engine_remove_scene(NutmegEngine *engine, NutmegScene *scene)
+{
+    if (!engine || !scene || scene->engine != engine || scene->handle.generation == 0 || engine->stepping) {
+        return false;
+    }
+
+    if (scene->rate_divider > 0) {
+        nutmeg_engine_schedule_erase(engine, scene);
+    }
+    engine->scene_count--;
+    nutmeg_scene_registry_remove(&engine->scenes, scene->handle.index);
+    if (engine->active_scene == scene) {
+        engine->active_scene = NULL;
+    }
+    nutmeg_scene_free(scene);
+    return true;
+}
+
+NutmegScene *nutmeg_engine_find_scene(NutmegEngine *engine, const char *name)
+{
+    if (!engine || !name) {
+        return NULL;
+    }
+
+    return nutmeg_scene_registry_find(&engine->scenes, name);
+}
+
+size_t nutmeg_engine_scene_count(const NutmegEngine *engine)
+{
+    return engine ? engine->scene_count : 0;
+}
+
+NutmegSceneHandle nutmeg_scene_handle(const NutmegScene *scene)
+{
+    NutmegSceneHandle handle;
+    handle.index = 0;
+    handle.generation = 0;
+
+    if (scene) {
+        handle = scene->handle;
+    }
+    return handle;
+}
+
+NutmegScene *nutmeg_engine_resolve_scene(NutmegEngine *engine, NutmegSceneHandle handle)
+{
+    if (!engine || handle.generation == 0) {
+        return NULL;
+    }
+    return nutmeg_scene_registry_resolve(&engine->scenes, handle);
+}
+
+const char *nutmeg_scene_name(const NutmegScene *scene)
+{
+    return scene ? scene->name : NULL;
+}
+
+bool nutmeg_engine_set_active_scene(NutmegEngine *engine, const char *name)
+{
+    if (!engine) {
+        return false;
+    }
+
+    if (name == NULL) {
+        engine->active_scene = NULL;
+        return true;
+    }
+
+    NutmegScene *scene = nutmeg_engine_find_scene(engine, name);
+    if (!scene) {
+        return false;
+    }
+
+    engine->active_scene = scene;
+    return true;
+}
+
+bool nutmeg_engine_load_scene_async(NutmegEngine *engine, const char *name, NutmegSceneBuildFn build, NutmegSceneLoadedFn loaded, void *userdata)
+{
+    if (!engine || !build || engine->stepping) {
+        return false;
+    }
+    if (nutmeg_engine_find_scene(engine, name) || (engine->loader && name && name[0] != '\0' && nutmeg_scene_loader_has_name(engine->loader, name))) {
+        return false;
+    }
+
+    if (!engine->loader) {
+        engine->loader = nutmeg_scene_loader_create(&engine->memory, engine);
+        if (!engine->loader) {
+            return false;
+        }
+    }
+
+    NutmegSceneLoad *load = (NutmegSceneLoad *)nutmeg_memory_alloc(&engine->memory, NUTMEG_MEMORY_ENGINE, sizeof(*load));
+    if (!load) {
+        return false;
+    }
+    /* detached, so the loader's allocations escape the tick's allocation guard */
+    load->scene = nutmeg_scene_create(engine, name, NULL);
+    if (!load->scene) {
+        nutmeg_memory_free(&engine->memory, NUTMEG_MEMORY_ENGINE, load, sizeof(*load));
+        return false;
+    }
+    load->build = build;
+    load->loaded = loaded;
+    load->userdata = userdata;
+    nutmeg_scene_loader_submit(engine->loader, load);
+    return true;
+}
+
+/* Register the scenes the loader has built (waiting for every queued one when wait is set) and deliver them. */
+static void nutmeg_engine_publish_loads(NutmegEngine *engine, bool wait)
+{
+    if (!engine->loader) {
+        return;
+    }
+
+    NutmegSceneLoad *load = nutmeg_scene_loader_take(engine->loader, wait);
+    while (load) {
+        NutmegSceneLoad *next = load->next;
+        NutmegScene *scene = load->scene;
+        nutmeg_memory_account_attach(&scene->memory, &engine->memory);
+        if (!load->built || !nutmeg_engine_register_scene(engine, scene)) {
+            nutmeg_scene_free(scene);
+            scene = NULL;
+        }
+        if (load->loaded) {
+            load->loaded(engine, scene, load->userdata);
+        }
+        nutmeg_memory_free(&engine->memory, NUTMEG_MEMORY_ENGINE, load, sizeof(*load));
+        load = next;
+    }
+}
+
+size_t nutmeg_engine_pending_scene_loads(const NutmegEngine *engine)
+{
+    return engine && engine->loader ? nutmeg_scene_loader_pending(engine->loader) : 0;
+}
+
+void nutmeg_engine_finish_scene_loads(NutmegEngine *engine)
+{
+    if (engine && !engine->stepping) {
+        nutmeg_engine_publish_loads(engine, true);
+    }
+}
+
+bool nutmeg_engine_activate_scene(NutmegEngine *engine, NutmegSceneHandle handle)
+{
+    NutmegScene *scene = nutmeg_engine_resolve_scene(engine, handle);
+    if (!scene) {
+        return false;
+    }
+
+    engine->active_scene = scene;
+    return true;
+}
+
+NutmegScene *nutmeg_engine_get_active_scene(NutmegEngine *engine)
+{
+    if (!engine) {
+        return NULL;
+    }
+    return engine->active_scene;
+}
+
+bool nutmeg_scene_set_schedule(NutmegScene *scene, unsigned int rate_divider, int priority)
+{
+    if (!scene) {
+        return false;
+    }
+
+    /*
+     * A scene still being built on the loader thread is not registered: keep
+     * the settings and leave the engine, which the ticking thread owns, alone.
+     * nutmeg_engine_register_scene schedules it when it is published.
+     */
+    NutmegEngine *engine = scene->engine;
+    bool registered = scene->handle.generation != 0;
+    if (registered && engine->stepping) {
+        return false;
+    }
+
+    if (registered && scene->rate_divider > 0) {
+        nutmeg_engine_schedule_erase(engine, scene);
+    }
+    scene->rate_divider = rate_divider;
+    scene->priority = priority;
+    scene->steps_waited = 0;
+    scene->pending_delta = 0.0f;
+    if (registered && rate_divider > 0) {
+        nutmeg_engine_schedule_insert(engine, scene);
+    }
+    return true;
+}
+
+unsigned int nutmeg_scene_rate_divider(const NutmegScene *scene)
+{
+    return scene ? scene->rate_divider : 0u;
+}
+
+int nutmeg_scene_priority(const NutmegScene *scene)
+{
+    return scene ? scene->priority : 0;
+}
+
+float nutmeg_scene_last_delta(const NutmegScene *scene)
+{
+    return scene ? scene->last_delta : 0.0f;
+}
+
+void nutmeg_engine_set_concurrent_scenes(NutmegEngine *engine, bool enabled)
+{
+    if (engine) {
+        engine->concurrent_scenes = enabled;
+    }
+}
+
+bool nutmeg_engine_concurrent_scenes(const NutmegEngine *engine)
+{
+    return engine ? engine->concurrent_scenes : false;
+}
+
+static NutmegObjectChunk *nutmeg_object_chunk_create(NutmegScene *scene, size_t base)
+{
+    NutmegObjectChunk *chunk = (NutmegObjectChunk *)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_OBJECTS, sizeof(*chunk));
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->cold = (NutmegObjectCold *)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_OBJECTS, NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(NutmegObjectCold));
+    if (!chunk->cold) {
+        nutmeg_memory_free(&scene->memory, NUTMEG_MEMORY_OBJECTS, chunk, sizeof(*chunk));
+        return NULL;
+    }
+
+    chunk->scene = scene;
+    chunk->base = base;
+    for (size_t i = 0; i < NUTMEG_OBJECT_CHUNK_CAPACITY; ++i) {
+        chunk->objects[i].chunk = chunk;
+        chunk->objects[i].index = i;
+        chunk->generations[i] = 1;
+        chunk->generation_peaks[i] = 0;
+    }
+    return chunk;
+}
+
+/*
+ * Give the scene's structure (which objects are live, where, and the order
+ * of the dense array, free list, name lists and query groups) a version
+ * never used before. Checkpoints taken with the same version share their
+ * description of it, and restoring one skips rebuilding the indexes when
+ * the scene still has that version.
+ */
+static void nutmeg_scene_restructured(NutmegScene *scene)
+{
+    scene->structure_version = ++scene->structure_counter;
+}
+
+/* Generation for a slot whose objects have carried every generation up to peak. Zero is never used. */
+static unsigned int nutmeg_generation_after(unsigned int peak)
+{
+    return peak + 1 == 0 ? 1 : peak + 1;
+}
+
+/*
+ * Returns the object in a free slot, allocating a chunk when needed. While
+ * the scene is ticking, new chunks wait on the pending list so the chunk
+ * table other workers read stays put until the flush.
+ */
+static NutmegObject *nutmeg_scene_acquire_slot(NutmegScene *scene)
+{
+    if (scene->free_count > 0) {
+        size_t slot = scene->free_slots[--scene->free_count];
+        return &scene->chunks[slot / NUTMEG_OBJECT_CHUNK_CAPACITY]->objects[slot % NUTMEG_OBJECT_CHUNK_CAPACITY];
+    }
+
+    size_t slot = scene->slot_count;
+    size_t chunk_index = slot / NUTMEG_OBJECT_CHUNK_CAPACITY;
+    NutmegObjectChunk *chunk = NULL;
+    if (chunk_index < scene->chunk_count) {
+        chunk = scene->chunks[chunk_index];
+    } else if (chunk_index < scene->chunk_count + scene->pending_chunk_count) {
+        chunk = scene->pending_chunks[chunk_index - scene->chunk_count];
+    } else {
+        chunk = nutmeg_object_chunk_create(scene, slot);
+        if (!chunk) {
+            return NULL;
+        }
+        if (scene->defer_depth > 0) {
+            scene->pending_chunks = (NutmegObjectChunk **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_OBJECTS, scene->pending_chunks, sizeof(NutmegObjectChunk *), &scene->pending_chunk_capacity, scene->pending_chunk_count + 1);
+            scene->pending_chunks[scene->pending_chunk_count++] = chunk;
+        } else {
+            scene->chunks = (NutmegObjectChunk **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_OBJECTS, scene->chunks, sizeof(NutmegObjectChunk *), &scene->chunk_capacity, scene->chunk_count + 1);
+            scene->chunks[scene->chunk_count++] = chunk;
+        }
+    }
+
+    scene->slot_count++;
+    return &chunk->objects[slot % NUTMEG_OBJECT_CHUNK_CAPACITY];
+}
+
+/* Return a slot to the free list, whether it was never populated or its object was removed. */
+static void nutmeg_scene_release_slot(NutmegScene *scene, size_t slot)
+{
+    scene->free_slots = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->free_slots, sizeof(size_t), &scene->free_capacity, scene->free_count + 1);
+    scene->free_slots[scene->free_count++] = slot;
+}
+
+/* Locate the object stored in a slot. The slot must have been handed out. */
+static NutmegObject *nutmeg_scene_object_at(NutmegScene *scene, size_t slot)
+{
+    return &scene->chunks[slot / NUTMEG_OBJECT_CHUNK_CAPACITY]->objects[slot % NUTMEG_OBJECT_CHUNK_CAPACITY];
+}
+
+/*
+ * Reserve a slot and initialise its columns. The object stays invisible to
+ * iteration until nutmeg_scene_commit_object publishes it; in particular the
+ * chunk's alive flags and high water mark are left untouched, so events that
+ * are iterating the chunk concurrently never observe the new slot.
+ */
+static NutmegObject *nutmeg_scene_prepare_object(NutmegScene *scene, const char *name)
+{
+    NutmegSymbolTable *symbols = &scene->engine->symbols;
+    NutmegSymbol symbol = nutmeg_symbol_table_intern(symbols, name);
+    if (symbol == NUTMEG_SYMBOL_NONE && name && name[0] != '\0') {
+        return NULL;
+    }
+
+    NutmegObject *object = nutmeg_scene_acquire_slot(scene);
+    if (!object) {
+        return NULL;
+    }
+
+    NutmegObjectChunk *chunk = object->chunk;
+    size_t index = object->index;
+    NutmegObjectCold *cold = &chunk->cold[index];
+
+    chunk->ids[index] = scene->next_object_id++;
+    chunk->names[index] = symbol;
+    chunk->positions[index].x = 0.0f;
+    chunk->positions[index].y = 0.0f;
+    chunk->velocities[index].x = 0.0f;
+    chunk->velocities[index].y = 0.0f;
+    chunk->radii[index] = 0.0f;
+    cold->name = nutmeg_symbol_table_name(symbols, symbol);
+    cold->userdata = NULL;
+    cold->tags = 0;
+    cold->type_id = 0;
+    cold->pending = 0;
+    return object;
+}
+
+/* Track a committed object in the list for its name. */
+static void nutmeg_scene_index_name(NutmegScene *scene, NutmegObject *object)
+{
+    NutmegSymbol symbol = object->chunk->names[object->index];
+    if (symbol == NUTMEG_SYMBOL_NONE) {
+        return;
+    }
+
+    if (symbol >= scene->name_list_count) {
+        scene->name_lists = (NutmegObjectList *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->name_lists, sizeof(NutmegObjectList), &scene->name_list_capacity, (size_t)symbol + 1);
+        memset(&scene->name_lists[scene->name_list_count], 0, ((size_t)symbol + 1 - scene->name_list_count) * sizeof(NutmegObjectList));
+        scene->name_list_count = (size_t)symbol + 1;
+    }
+
+    NutmegObjectList *list = &scene->name_lists[symbol];
+    list->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, list->objects, sizeof(NutmegObject *), &list->capacity, list->count + 1);
+    object->chunk->cold[object->index].name_index = list->count;
+    list->objects[list->count++] = object;
+}
+
+static void nutmeg_scene_unindex_name(NutmegScene *scene, NutmegObject *object)
+{
+    NutmegSymbol symbol = object->chunk->names[object->index];
+    if (symbol == NUTMEG_SYMBOL_NONE) {
+        return;
+    }
+
+    NutmegObjectList *list = &scene->name_lists[symbol];
+    size_t position = object->chunk->cold[object->index].name_index;
+    size_t last = list->count - 1;
+    if (position != last) {
+        NutmegObject *moved = list->objects[last];
+        list->objects[position] = moved;
+        moved->chunk->cold[moved->index].name_index = position;
+    }
+    list->count--;
+}
+
+static bool nutmeg_query_is_empty(const NutmegObjectQuery *query)
+{
+    return query->name == NUTMEG_SYMBOL_NONE && query->tags == 0 && query->type_id == 0;
+}
+
+/* Queries on the name alone are answered by the name lists and need no group. */
+static bool nutmeg_query_is_name_only(const NutmegObjectQuery *query)
+{
+    return query->name != NUTMEG_SYMBOL_NONE && query->tags == 0 && query->type_id == 0;
+}
+
+static bool nutmeg_query_matches(const NutmegObjectQuery *query, const NutmegObject *object)
+{
+    const NutmegObjectChunk *chunk = object->chunk;
+    const NutmegObjectCold *cold = &chunk->cold[object->index];
+    if (query->name != NUTMEG_SYMBOL_NONE && chunk->names[object->index] != query->name) {
+        return false;
+    }
+    if ((cold->tags & query->tags) != query->tags) {
+        return false;
+    }
+    return query->type_id == 0 || cold->type_id == query->type_id;
+}
+
+static void nutmeg_query_group_insert(NutmegScene *scene, NutmegQueryGroup *group, NutmegObject *object, size_t slot)
+{
+    if (slot >= group->position_capacity) {
+        size_t old_capacity = group->position_capacity;
+        group->positions = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, group->positions, sizeof(size_t), &group->position_capacity, slot + 1);
+        for (size_t i = old_capacity; i < group->position_capacity; ++i) {
+            group->positions[i] = NUTMEG_QUERY_NOT_MEMBER;
+        }
+    }
+
+    NutmegObjectList *members = &group->members;
+    members->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, members->objects, sizeof(NutmegObject *), &members->capacity, members->count + 1);
+    group->positions[slot] = members->count;
+    members->objects[members->count++] = object;
+    nutmeg_scene_restructured(scene);
+}
+
+static void nutmeg_query_group_erase(NutmegScene *scene, NutmegQueryGroup *group, size_t slot)
+{
+    NutmegObjectList *members = &group->members;
+    size_t position = group->positions[slot];
+    size_t last = members->count - 1;
+    if (position != last) {
+        NutmegObject *moved = members->objects[last];
+        members->objects[position] = moved;
+        group->positions[moved->chunk->base + moved->index] = position;
+    }
+    members->count--;
+    group->positions[slot] = NUTMEG_QUERY_NOT_MEMBER;
+    nutmeg_scene_restructured(scene);
+}
+
+/* Bring the object's membership of every query group in line with its current state. */
+static void nutmeg_scene_index_queries(NutmegScene *scene, NutmegObject *object)
+{
+    size_t slot = object->chunk->base + object->index;
+    bool alive = nutmeg_atomic_load_u8(&object->chunk->alive[object->index]);
+    for (size_t g = 0; g < scene->query_group_count; ++g) {
+        NutmegQueryGroup *group = &scene->query_groups[g];
+        bool member = slot < group->position_capacity && group->positions[slot] != NUTMEG_QUERY_NOT_MEMBER;
+        bool matches = alive && nutmeg_query_matches(&group->query, object);
+        if (matches && !member) {
+            nutmeg_query_group_insert(scene, group, object, slot);
+        } else if (!matches && member) {
+            nutmeg_query_group_erase(scene, group, slot);
+        }
+    }
+}
+
+/* Find the group tracking a query, creating and populating it on first use. */
+static NutmegQueryGroup *nutmeg_scene_query_group(NutmegScene *scene, const NutmegObjectQuery *query)
+{
+    for (size_t g = 0; g < scene->query_group_count; ++g) {
+        NutmegQueryGroup *group = &scene->query_groups[g];
+        if (group->query.name == query->name && group->query.tags == query->tags && group->query.type_id == query->type_id) {
+            return group;
+        }
+    }
+
+    scene->query_groups = (NutmegQueryGroup *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->query_groups, sizeof(NutmegQueryGroup), &scene->query_group_capacity, scene->query_group_count + 1);
+    NutmegQueryGroup *group = &scene->query_groups[scene->query_group_count++];
+    memset(group, 0, sizeof(*group));
+    group->query = *query;
+
+    for (size_t i = 0; i < scene->object_count; ++i) {
+        NutmegObject *object = scene->objects[i];
+        if (nutmeg_atomic_load_u8(&object->chunk->alive[object->index]) && nutmeg_query_matches(query, object)) {
+            nutmeg_query_group_insert(scene, group, object, object->chunk->base + object->index);
+        }
+    }
+    return group;
+}
+
+/*
+ * Resolve the objects a query selects. Returns false for the empty query,
+ * which selects every live object and is served by walking the chunks.
+ */
+static bool nutmeg_scene_query_members(NutmegScene *scene, const NutmegObjectQuery *query, NutmegObject ***out_members, size_t *out_count)
+{
+    *out_members = NULL;
+    *out_count = 0;
+    if (nutmeg_query_is_empty(query)) {
+        return false;
+    }
+
+    if (nutmeg_query_is_name_only(query)) {
+        if (query->name < scene->name_list_count) {
+            *out_members = scene->name_lists[query->name].objects;
+            *out_count = scene->name_lists[query->name].count;
+        }
+        return true;
+    }
+
+    NutmegQueryGroup *group = nutmeg_scene_query_group(scene, query);
+    *out_members = group->members.objects;
+    *out_count = group->members.count;
+    return true;
+}
+
+/*
+ * Make a prepared object visible to iteration and to the name and query
+ * indexes, but not to lookups by id. The caller must have reserved room in
+ * the dense object array.
+ */
+static void nutmeg_scene_publish_object(NutmegScene *scene, NutmegObject *object)
+{
+    NutmegObjectChunk *chunk = object->chunk;
+    size_t index = object->index;
+
+    nutmeg_atomic_store_u8(&chunk->alive[index], 1);
+    chunk->generation_peaks[index] = chunk->generations[index];
+    chunk->live_count++;
+    if (index >= chunk->high_water) {
+        chunk->high_water = index + 1;
+    }
+    chunk->cold[index].dense_index = scene->object_count;
+    scene->objects[scene->object_count++] = object;
+    nutmeg_scene_index_name(scene, object);
+    nutmeg_scene_index_queries(scene, object);
+    nutmeg_atomic_store_u64(&scene->spatial_valid, 0);
+    nutmeg_scene_restructured(scene);
+}
+
+/*
+ * Make a prepared object visible. The caller must have reserved room in the
+ * dense object array and the id map.
+ */
+static void nutmeg_scene_commit_object(NutmegScene *scene, NutmegObject *object)
+{
+    nutmeg_id_map_insert_unchecked(&scene->id_map, object->chunk->ids[object->index], object->chunk->base + object->index);
+    nutmeg_scene_publish_object(scene, object);
+}
+
+NutmegObject *nutmeg_scene_spawn_object(NutmegScene *scene, const char *name)
+{
+    if (!scene) {
+        return NULL;
+    }
+
+    if (scene->defer_depth > 0) {
+        NutmegCommandBuffer *commands = &scene->commands;
+        nutmeg_mutex_lock(&scene->command_lock);
+        NutmegObject *object = nutmeg_scene_prepare_object(scene, name);
+        if (object) {
+            object->chunk->cold[object->index].pending = NUTMEG_OBJECT_PENDING_SPAWN;
+            commands->spawn_slots = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_COMMANDS, commands->spawn_slots, sizeof(size_t), &commands->spawn_capacity, commands->spawn_count + 1);
+            commands->spawn_slots[commands->spawn_count++] = object->chunk->base + object->index;
+        }
+        nutmeg_mutex_unlock(&scene->command_lock);
+        return object;
+    }
+
+    if (!nutmeg_id_map_reserve(&scene->id_map, &scene->memory, scene->id_map.count + 1)) {
+        return NULL;
+    }
+
+    NutmegObject *object = nutmeg_scene_prepare_object(scene, name);
+    if (!object) {
+        return NULL;
+    }
+
+    scene->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->objects, sizeof(NutmegObject *), &scene->object_capacity, scene->object_count + 1);
+    nutmeg_scene_commit_object(scene, object);
+    return object;
+}
+
+static void nutmeg_scene_remove_object(NutmegScene *scene, NutmegObject *object)
+{
+    NutmegObjectChunk *chunk = object->chunk;
+    size_t index = object->index;
+    size_t dense_index = chunk->cold[index].dense_index;
+
+    nutmeg_id_map_remove(&scene->id_map, chunk->ids[index]);
+    nutmeg_scene_unindex_name(scene, object);
+    nutmeg_atomic_store_u8(&chunk->alive[index], 0);
+    chunk->live_count--;
+    nutmeg_scene_index_queries(scene, object);
+    nutmeg_atomic_store_u64(&scene->spatial_valid, 0);
+    chunk->cold[index].userdata = NULL;
+    chunk->cold[index].pending = 0;
+
+    /* bumping the generation invalidates every outstanding handle to the slot */
+    chunk->generations[index] = nutmeg_generation_after(chunk->generation_peaks[index]);
+
+    nutmeg_scene_release_slot(scene, chunk->base + index);
+
+    size_t last = scene->object_count - 1;
+    if (dense_index != last) {
+        NutmegObject *moved = scene->objects[last];
+        scene->objects[dense_index] = moved;
+        moved->chunk->cold[moved->index].dense_index = dense_index;
+    }
+    scene->objects[last] = NULL;
+    scene->object_count--;
+    nutmeg_scene_restructured(scene);
+}
+
+/*
+ * Returns true for objects that are alive or waiting to be spawned, and
+ * false once a destroy has been issued for them.
+ */
+static bool nutmeg_object_is_live(const NutmegObject *object)
+{
+    const NutmegObjectChunk *chunk = object->chunk;
+    if (nutmeg_atomic_load_u8(&chunk->alive[object->index])) {
+        return true;
+    }
+    return chunk->cold[object->index].pending == NUTMEG_OBJECT_PENDING_SPAWN;
+}
+
+/* Destroy immediately, or record the destroy while the scene is ticking. */
+static void nutmeg_scene_release_object(NutmegScene *scene, NutmegObject *object)
+{
+    if (scene->defer_depth == 0) {
+        nutmeg_scene_remove_object(scene, object);
+        return;
+    }
+
+    NutmegCommandBuffer *commands = &scene->commands;
+    NutmegObjectChunk *chunk = object->chunk;
+
+    nutmeg_mutex_lock(&scene->command_lock);
+    if (!(chunk->cold[object->index].pending & NUTMEG_OBJECT_PENDING_DESTROY)) {
+        /*
+         * Hide the object from the rest of the tick straight away. Workers
+         * read alive without the lock, so the flag is cleared last: whoever
+         * sees it cleared also sees the pending destroy.
+         */
+        chunk->cold[object->index].pending |= NUTMEG_OBJECT_PENDING_DESTROY;
+        nutmeg_atomic_store_u8(&chunk->alive[object->index], 0);
+        commands->destroy_slots = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_COMMANDS, commands->destroy_slots, sizeof(size_t), &commands->destroy_capacity, commands->destroy_count + 1);
+        commands->destroy_slots[commands->destroy_count++] = chunk->base + object->index;
+    }
+    nutmeg_mutex_unlock(&scene->command_lock);
+}
+
+/* Apply every recorded spawn and destroy in a single batch. */
+static void nutmeg_scene_flush_commands(NutmegScene *scene)
+{
+    NutmegCommandBuffer *commands = &scene->commands;
+
+    /* no worker is running any more, so the chunk table may move */
+    if (scene->pending_chunk_count > 0) {
+        scene->chunks = (NutmegObjectChunk **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_OBJECTS, scene->chunks, sizeof(NutmegObjectChunk *), &scene->chunk_capacity, scene->chunk_count + scene->pending_chunk_count);
+        memcpy(&scene->chunks[scene->chunk_count], scene->pending_chunks, scene->pending_chunk_count * sizeof(NutmegObjectChunk *));
+        scene->chunk_count += scene->pending_chunk_count;
+        scene->pending_chunk_count = 0;
+    }
+
+    if (commands->spawn_count > 0) {
+        size_t total = scene->object_count + commands->spawn_count;
+        scene->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->objects, sizeof(NutmegObject *), &scene->object_capacity, total);
+        if (!nutmeg_id_map_reserve(&scene->id_map, &scene->memory, scene->id_map.count + commands->spawn_count)) {
+            /* allocation failure is fatal */
+            abort();
+        }
+
+        for (size_t i = 0; i < commands->spawn_count; ++i) {
+            NutmegObject *object = nutmeg_scene_object_at(scene, commands->spawn_slots[i]);
+            object->chunk->cold[object->index].pending &= ~(unsigned int)NUTMEG_OBJECT_PENDING_SPAWN;
+            nutmeg_scene_commit_object(scene, object);
+        }
+        commands->spawn_count = 0;
+    }
+
+    /* before the destroys, so every recorded slot still holds its object */
+    for (size_t i = 0; i < commands->reindex_count; ++i) {
+        NutmegObject *object = nutmeg_scene_object_at(scene, commands->reindex_slots[i]);
+        object->chunk->cold[object->index].pending &= ~(unsigned int)NUTMEG_OBJECT_PENDING_REINDEX;
+        nutmeg_scene_index_queries(scene, object);
+    }
+    commands->reindex_count = 0;
+
+    if (commands->destroy_count > 0) {
+        scene->free_slots = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->free_slots, sizeof(size_t), &scene->free_capacity, scene->free_count + commands->destroy_count);
+        for (size_t i = 0; i < commands->destroy_count; ++i) {
+            nutmeg_scene_remove_object(scene, nutmeg_scene_object_at(scene, commands->destroy_slots[i]));
+        }
+        commands->destroy_count = 0;
+    }
+}
+
+void nutmeg_scene_destroy_object(NutmegScene *scene, NutmegObject *object)
+{
+    if (!scene || !object) {
+        return;
+    }
+
+    if (object->chunk->scene == scene && nutmeg_object_is_live(object)) {
+        nutmeg_scene_release_object(scene, object);
+    }
+}
+
+/*
+ * Locate the object stored in a slot, or NULL when the slot is out of range.
+ * Bounded by the chunk table, which stays fixed for a tick, rather than by
+ * slot_count, which spawns on other workers advance; slots never handed out
+ * hold no live object. Slots past the table may belong to chunks spawned
+ * into this tick, which only the command lock makes safe to read.
+ */
+static NutmegObject *nutmeg_scene_slot_object(NutmegScene *scene, size_t slot)
+{
+    size_t chunk_index = slot / NUTMEG_OBJECT_CHUNK_CAPACITY;
+    if (chunk_index >= scene->chunk_count) {
+        NutmegObject *object = NULL;
+        if (scene->defer_depth > 0) {
+            nutmeg_mutex_lock(&scene->command_lock);
+            if (chunk_index - scene->chunk_count < scene->pending_chunk_count) {
+                object = &scene->pending_chunks[chunk_index - scene->chunk_count]->objects[slot % NUTMEG_OBJECT_CHUNK_CAPACITY];
+            }
+            nutmeg_mutex_unlock(&scene->command_lock);
+        }
+        return object;
+    }
+    return nutmeg_scene_object_at(scene, slot);
+}
+
+NutmegObjectHandle nutmeg_object_handle(const NutmegObject *object)
+{
+    NutmegObjectHandle handle;
+    handle.index = 0;
+    handle.generation = 0;
+
+    if (object && nutmeg_object_is_live(object)) {
+        handle.index = (unsigned int)(object->chunk->base + object->index);
+        handle.generation = object->chunk->generations[object->index];
+    }
+    return handle;
+}
+
+NutmegObject *nutmeg_scene_resolve_handle(NutmegScene *scene, NutmegObjectHandle handle)
+{
+    if (!scene || handle.generation == 0) {
+        return NULL;
+    }
+
+    NutmegObject *object = nutmeg_scene_slot_object(scene, handle.index);
+    if (!object || object->chunk->generations[object->index] != handle.generation || !nutmeg_object_is_live(object)) {
+        return NULL;
+    }
+    return object;
+}
+
+bool nutmeg_scene_handle_valid(NutmegScene *scene, NutmegObjectHandle handle)
+{
+    return nutmeg_scene_resolve_handle(scene, handle) != NULL;
+}
+
+bool nutmeg_scene_destroy_handle(NutmegScene *scene, NutmegObjectHandle handle)
+{
+    NutmegObject *object = nutmeg_scene_resolve_handle(scene, handle);
+    if (!object) {
+        return false;
+    }
+
+    nutmeg_scene_release_object(scene, object);
+    return true;
+}
+
+NutmegObject *nutmeg_scene_find_object(NutmegScene *scene, unsigned long id)
+{
+    if (!scene) {
+        return NULL;
+    }
+
+    size_t slot = 0;
+    if (!nutmeg_id_map_find(&scene->id_map, id, &slot)) {
+        return NULL;
+    }
+    return nutmeg_scene_slot_object(scene, slot);
+}
+
+unsigned long nutmeg_object_id(const NutmegObject *object)
+{
+    return object ? object->chunk->ids[object->index] : 0UL;
+}
+
+const char *nutmeg_object_name(const NutmegObject *object)
+{
+    return object ? object->chunk->cold[object->index].name : NULL;
+}
+
+NutmegSymbol nutmeg_object_name_symbol(const NutmegObject *object)
+{
+    return object ? object->chunk->names[object->index] : NUTMEG_SYMBOL_NONE;
+}
+
+NutmegVec2 *nutmeg_object_position(NutmegObject *object)
+{
+    return object ? &object->chunk->positions[object->index] : NULL;
+}
+
+NutmegVec2 *nutmeg_object_velocity(NutmegObject *object)
+{
+    return object ? &object->chunk->velocities[object->index] : NULL;
+}
+
+float nutmeg_object_radius(const NutmegObject *object)
+{
+    return object ? object->chunk->radii[object->index] : 0.0f;
+}
+
+void nutmeg_object_set_radius(NutmegObject *object, float radius)
+{
+    if (!object) {
+        return;
+    }
+    object->chunk->radii[object->index] = radius > 0.0f ? radius : 0.0f;
+}
+
+NutmegObject *nutmeg_span_object(const NutmegObjectSpan *span, size_t index)
+{
+    if (!span || index >= span->count) {
+        return NULL;
+    }
+    return &span->objects[index];
+}
+
+/* Refresh the query membership of an object whose tags or type changed. */
+static void nutmeg_object_requery(NutmegObject *object)
+{
+    NutmegObjectChunk *chunk = object->chunk;
+    NutmegScene *scene = chunk->scene;
+
+    /* pending spawns are matched when they are committed */
+    if (scene->query_group_count == 0 || !nutmeg_atomic_load_u8(&chunk->alive[object->index])) {
+        return;
+    }
+
+    if (scene->defer_depth == 0) {
+        nutmeg_scene_index_queries(scene, object);
+        return;
+    }
+
+    /* the member lists may be under iteration: reindex once the tick is over */
+    NutmegCommandBuffer *commands = &scene->commands;
+    nutmeg_mutex_lock(&scene->command_lock);
+    NutmegObjectCold *cold = &chunk->cold[object->index];
+    if (!(cold->pending & NUTMEG_OBJECT_PENDING_REINDEX)) {
+        cold->pending |= NUTMEG_OBJECT_PENDING_REINDEX;
+        commands->reindex_slots = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_COMMANDS, commands->reindex_slots, sizeof(size_t), &commands->reindex_capacity, commands->reindex_count + 1);
+        commands->reindex_slots[commands->reindex_count++] = chunk->base + object->index;
+    }
+    nutmeg_mutex_unlock(&scene->command_lock);
+}
+
+void nutmeg_object_add_tags(NutmegObject *object, unsigned long long tags)
+{
+    if (!object) {
+        return;
+    }
+
+    NutmegObjectCold *cold = &object->chunk->cold[object->index];
+    if ((cold->tags | tags) != cold->tags) {
+        cold->tags |= tags;
+        nutmeg_object_requery(object);
+    }
+}
+
+void nutmeg_object_remove_tags(NutmegObject *object, unsigned long long tags)
+{
+    if (!object) {
+        return;
+    }
+
+    NutmegObjectCold *cold = &object->chunk->cold[object->index];
+    if ((cold->tags & tags) != 0) {
+        cold->tags &= ~tags;
+        nutmeg_object_requery(object);
+    }
+}
+
+unsigned long long nutmeg_object_tags(const NutmegObject *object)
+{
+    return object ? object->chunk->cold[object->index].tags : 0ULL;
+}
+
+void nutmeg_object_set_userdata_type(NutmegObject *object, unsigned int type_id)
+{
+    if (!object) {
+        return;
+    }
+
+    NutmegObjectCold *cold = &object->chunk->cold[object->index];
+    if (cold->type_id != type_id) {
+        cold->type_id = type_id;
+        nutmeg_object_requery(object);
+    }
+}
+
+unsigned int nutmeg_object_userdata_type(const NutmegObject *object)
+{
+    return object ? object->chunk->cold[object->index].type_id : 0u;
+}
+
+void nutmeg_object_set_userdata(NutmegObject *object, void *userdata)
+{
+    if (!object) {
+        return;
+    }
+    object->chunk->cold[object->index].userdata = userdata;
+}
+
+void *nutmeg_object_userdata(NutmegObject *object)
+{
+    return object ? object->chunk->cold[object->index].userdata : NULL;
+}
+
+NutmegScene *nutmeg_object_scene(NutmegObject *object)
+{
+    return object ? object->chunk->scene : NULL;
+}
+
+/* Zero-fill the file from written up to offset. */
+static bool nutmeg_snapshot_pad(FILE *file, unsigned long long *written, unsigned long long offset)
+{
+    static const unsigned char zeros[NUTMEG_SNAPSHOT_ALIGN];
+    size_t count = (size_t)(offset - *written);
+    *written = offset;
+    return count == 0 || fwrite(zeros, 1, count, file) == count;
+}
+
+/* Pack one column of a chunk's live objects into buffer. Returns the number of entries. */
+static size_t nutmeg_snapshot_pack(const NutmegObjectChunk *chunk, NutmegSnapshotColumn column, const unsigned int *name_indexes, unsigned char *buffer)
+{
+    size_t size = nutmeg_snapshot_column_size(column);
+    size_t count = 0;
+    for (size_t i = 0; i < chunk->high_water; ++i) {
+        if (!nutmeg_atomic_load_u8(&chunk->alive[i])) {
+            continue;
+        }
+
+        unsigned char *out = buffer + count++ * size;
+        unsigned long long wide = 0;
+        unsigned int narrow = 0;
+        switch (column) {
+        case NUTMEG_SNAPSHOT_POSITIONS:
+            memcpy(out, &chunk->positions[i], size);
+            break;
+        case NUTMEG_SNAPSHOT_VELOCITIES:
+            memcpy(out, &chunk->velocities[i], size);
+            break;
+        case NUTMEG_SNAPSHOT_RADII:
+            memcpy(out, &chunk->radii[i], size);
+            break;
+        case NUTMEG_SNAPSHOT_IDS:
+            wide = chunk->ids[i];
+            memcpy(out, &wide, size);
+            break;
+        case NUTMEG_SNAPSHOT_NAMES:
+            narrow = chunk->names[i] == NUTMEG_SYMBOL_NONE ? NUTMEG_SNAPSHOT_NO_NAME : name_indexes[chunk->names[i]];
+            memcpy(out, &narrow, size);
+            break;
+        case NUTMEG_SNAPSHOT_TAGS:
+            memcpy(out, &chunk->cold[i].tags, size);
+            break;
+        default:
+            memcpy(out, &chunk->cold[i].type_id, size);
+            break;
+        }
+    }
+    return count;
+}
+
+/* Write the string table and columns of a snapshot laid out by header; name_indexes covers symbol_count symbols. */
+static bool nutmeg_snapshot_write(NutmegScene *scene, FILE *file, const NutmegSnapshotHeader *header, const unsigned int *name_indexes, size_t symbol_count, const NutmegSymbol *tags)
+{
+    NutmegSymbolTable *symbols = &scene->engine->symbols;
+    unsigned long long written = sizeof(*header);
+    if (fwrite(header, sizeof(*header), 1, file) != 1 || !nutmeg_snapshot_pad(file, &written, header->strings_offset)) {
+        return false;
+    }
+
+    /* names in symbol order, which is the order the indexes were assigned in */
+    for (size_t symbol = 1; symbol < symbol_count; ++symbol) {
+        if (name_indexes[symbol] != NUTMEG_SNAPSHOT_NO_NAME) {
+            const char *name = nutmeg_symbol_table_name(symbols, (NutmegSymbol)symbol);
+            fwrite(name, 1, strlen(name) + 1, file);
+        }
+    }
+    for (unsigned int t = 0; t < header->tag_count; ++t) {
+        const char *tag = nutmeg_symbol_table_name(symbols, tags[t]);
+        fwrite(tag, 1, strlen(tag) + 1, file);
+    }
+    written += header->strings_size;
+
+    unsigned char buffer[NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(unsigned long long)];
+    for (int c = 0; c < NUTMEG_SNAPSHOT_COLUMN_COUNT; ++c) {
+        NutmegSnapshotColumn column = (NutmegSnapshotColumn)c;
+        size_t size = nutmeg_snapshot_column_size(column);
+        if (!nutmeg_snapshot_pad(file, &written, header->columns[c])) {
+            return false;
+        }
+        for (size_t k = 0; k < scene->chunk_count; ++k) {
+            size_t count = nutmeg_snapshot_pack(scene->chunks[k], column, name_indexes, buffer);
+            if (count > 0 && fwrite(buffer, size, count, file) != count) {
+                return false;
+            }
+            written += count * size;
+        }
+    }
+    return !ferror(file);
+}
+
+bool nutmeg_scene_save_snapshot(NutmegScene *scene, const char *path)
+{
+    if (!scene || !path || scene->defer_depth > 0) {
+        return false;
+    }
+
+    NutmegEngine *engine = scene->engine;
+    NutmegSymbolTable *symbols = &engine->symbols;
+    /* other threads (workers, the scene loader) may intern while this runs; later symbols are not carried by the scene */
+    size_t symbol_count = nutmeg_symbol_table_count(symbols);
+    unsigned int *name_indexes = (unsigned int *)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_INDEXES, symbol_count * sizeof(unsigned int));
+    if (!name_indexes) {
+        return false;
+    }
+
+    /* only names some object carries go into the table, indexed in symbol order */
+    for (size_t symbol = 0; symbol < symbol_count; ++symbol) {
+        name_indexes[symbol] = NUTMEG_SNAPSHOT_NO_NAME;
+    }
+    for (size_t i = 0; i < scene->object_count; ++i) {
+        const NutmegObject *object = scene->objects[i];
+        name_indexes[object->chunk->names[object->index]] = 0;
+    }
+    unsigned int name_count = 0;
+    unsigned long long strings_size = 0;
+    for (size_t symbol = 1; symbol < symbol_count; ++symbol) {
+        if (name_indexes[symbol] != NUTMEG_SNAPSHOT_NO_NAME) {
+            name_indexes[symbol] = name_count++;
+            strings_size += strlen(nutmeg_symbol_table_name(symbols, (NutmegSymbol)symbol)) + 1;
+        }
+    }
+
+    NutmegSymbol tags[NUTMEG_TAG_CAPACITY];
+    nutmeg_mutex_lock(&engine->tag_lock);
+    unsigned int tag_count = engine->tag_count;
+    memcpy(tags, engine->tags, tag_count * sizeof(NutmegSymbol));
+    nutmeg_mutex_unlock(&engine->tag_lock);
+    for (unsigned int t = 0; t < tag_count; ++t) {
+        strings_size += strlen(nutmeg_symbol_table_name(symbols, tags[t])) + 1;
+    }
+
+    NutmegSnapshotHeader header;
+    nutmeg_snapshot_layout(&header, scene->object_count, name_count, tag_count, strings_size);
+    header.next_object_id = scene->next_object_id;
+
+    bool saved = false;
+    FILE *file = fopen(path, "wb");
+    if (file) {
+        saved = nutmeg_snapshot_write(scene, file, &header, name_indexes, symbol_count, tags);
+        saved = fclose(file) == 0 && saved;
+    }
+    nutmeg_memory_free(&scene->memory, NUTMEG_MEMORY_INDEXES, name_indexes, symbol_count * sizeof(unsigned int));
+    return saved;
+}
+
+/* Translate snapshot tag bits into this engine's bits. */
+static unsigned long long nutmeg_snapshot_remap_tags(unsigned long long tags, const unsigned long long *tag_bits, unsigned int tag_count)
+{
+    unsigned long long remapped = 0;
+    for (unsigned int t = 0; t < tag_count && tags != 0; ++t) {
+        if (tags & (1ULL << t)) {
+            remapped |= tag_bits[t];
+            tags &= ~(1ULL << t);
+        }
+    }
+    return remapped;
+}
+
+/*
+ * Copy the objects of a validated snapshot into an empty scene, filling
+ * slots from 0 so each snapshot block lands in one chunk. The id map is
+ * filled in a separate pass afterwards: its probes miss the cache, and a
+ * tight loop keeps many of them in flight at once. Returns false on a zero
+ * or duplicate id or an unknown name index.
+ */
+static bool nutmeg_snapshot_adopt(NutmegScene *scene, const unsigned char *data, const NutmegSnapshotHeader *header, const NutmegSymbol *names, const unsigned long long *tag_bits, bool same_tags)
+{
+    NutmegSymbolTable *symbols = &scene->engine->symbols;
+    size_t count = (size_t)header->object_count;
+    const unsigned char *positions = data + header->columns[NUTMEG_SNAPSHOT_POSITIONS];
+    const unsigned char *velocities = data + header->columns[NUTMEG_SNAPSHOT_VELOCITIES];
+    const unsigned char *radii = data + header->columns[NUTMEG_SNAPSHOT_RADII];
+    const unsigned char *ids = data + header->columns[NUTMEG_SNAPSHOT_IDS];
+    const unsigned char *name_column = data + header->columns[NUTMEG_SNAPSHOT_NAMES];
+    const unsigned char *tag_column = data + header->columns[NUTMEG_SNAPSHOT_TAGS];
+    const unsigned char *types = data + header->columns[NUTMEG_SNAPSHOT_TYPE_IDS];
+    unsigned long next_id = (unsigned long)header->next_object_id;
+
+    for (size_t base = 0; base < count; base += NUTMEG_OBJECT_CHUNK_CAPACITY) {
+        NutmegObjectChunk *chunk = scene->chunks[base / NUTMEG_OBJECT_CHUNK_CAPACITY];
+        size_t block = count - base < NUTMEG_OBJECT_CHUNK_CAPACITY ? count - base : NUTMEG_OBJECT_CHUNK_CAPACITY;
+        memcpy(chunk->positions, positions + base * sizeof(NutmegVec2), block * sizeof(NutmegVec2));
+        memcpy(chunk->velocities, velocities + base * sizeof(NutmegVec2), block * sizeof(NutmegVec2));
+        memcpy(chunk->radii, radii + base * sizeof(float), block * sizeof(float));
+
+        for (size_t i = 0; i < block; ++i) {
+            size_t at = base + i;
+            unsigned long long id = 0;
+            unsigned int name = 0;
+            unsigned long long tags = 0;
+            memcpy(&id, ids + at * sizeof(id), sizeof(id));
+            memcpy(&name, name_column + at * sizeof(name), sizeof(name));
+            memcpy(&tags, tag_column + at * sizeof(tags), sizeof(tags));
+
+            if (id == 0 || (unsigned long)id != id) {
+                return false;
+            }
+            if (name != NUTMEG_SNAPSHOT_NO_NAME && name >= header->name_count) {
+                return false;
+            }
+
+            NutmegObjectCold *cold = &chunk->cold[i];
+            chunk->ids[i] = (unsigned long)id;
+            chunk->names[i] = name == NUTMEG_SNAPSHOT_NO_NAME ? NUTMEG_SYMBOL_NONE : names[name];
+            cold->name = nutmeg_symbol_table_name(symbols, chunk->names[i]);
+            cold->userdata = NULL;
+            cold->tags = same_tags ? tags : nutmeg_snapshot_remap_tags(tags, tag_bits, header->tag_count);
+            memcpy(&cold->type_id, types + at * sizeof(unsigned int), sizeof(unsigned int));
+            cold->pending = 0;
+
+            scene->slot_count++;
+            nutmeg_scene_publish_object(scene, &chunk->objects[i]);
+            if (chunk->ids[i] >= next_id) {
+                next_id = chunk->ids[i] + 1;
+            }
+        }
+    }
+
+    for (size_t slot = 0; slot < count; ++slot) {
+        unsigned long id = scene->chunks[slot / NUTMEG_OBJECT_CHUNK_CAPACITY]->ids[slot % NUTMEG_OBJECT_CHUNK_CAPACITY];
+        size_t existing = 0;
+        if (nutmeg_id_map_find(&scene->id_map, id, &existing)) {
+            return false;
+        }
+        nutmeg_id_map_insert_unchecked(&scene->id_map, id, slot);
+    }
+    scene->next_object_id = next_id;
+    return true;
+}
+
+bool nutmeg_scene_load_snapshot_memory(NutmegScene *scene, const void *data, size_t size)
+{
+    if (!scene || scene->defer_depth > 0 || scene->object_count > 0 || !nutmeg_snapshot_validate(data, size)) {
+        return false;
+    }
+
+    NutmegSnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    size_t count = (size_t)header.object_count;
+    size_t string_count = (size_t)header.name_count + header.tag_count;
+    const char **strings = (const char **)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_INDEXES, string_count * sizeof(const char *));
+    NutmegSymbol *names = (NutmegSymbol *)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_INDEXES, header.name_count * sizeof(NutmegSymbol));
+    bool loaded = (strings || string_count == 0) && (names || header.name_count == 0);
+
+    unsigned long long tag_bits[NUTMEG_TAG_CAPACITY];
+    bool same_tags = true;
+    if (loaded) {
+        nutmeg_snapshot_strings(data, strings);
+        for (unsigned int n = 0; n < header.name_count && loaded; ++n) {
+            names[n] = nutmeg_engine_intern(scene->engine, strings[n]);
+            loaded = names[n] != NUTMEG_SYMBOL_NONE || strings[n][0] == '\0';
+        }
+        for (unsigned int t = 0; t < header.tag_count; ++t) {
+            tag_bits[t] = nutmeg_engine_tag(scene->engine, strings[header.name_count + t]);
+            same_tags = same_tags && tag_bits[t] == 1ULL << t;
+        }
+    }
+
+    if (loaded) {
+        /* the scene is empty: forget its free list and refill slots from the start */
+        nutmeg_scene_restructured(scene);
+        scene->free_count = 0;
+        scene->slot_count = 0;
+        for (size_t c = 0; c < scene->chunk_count; ++c) {
+            scene->chunks[c]->high_water = 0;
+        }
+        while (loaded && scene->chunk_count * NUTMEG_OBJECT_CHUNK_CAPACITY < count) {
+            NutmegObjectChunk *chunk = nutmeg_object_chunk_create(scene, scene->chunk_count * NUTMEG_OBJECT_CHUNK_CAPACITY);
+            if (chunk) {
+                scene->chunks = (NutmegObjectChunk **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_OBJECTS, scene->chunks, sizeof(NutmegObjectChunk *), &scene->chunk_capacity, scene->chunk_count + 1);
+                scene->chunks[scene->chunk_count++] = chunk;
+            }
+            loaded = chunk != NULL;
+        }
+        if (loaded) {
+            scene->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->objects, sizeof(NutmegObject *), &scene->object_capacity, count);
+            loaded = nutmeg_id_map_reserve(&scene->id_map, &scene->memory, count) && nutmeg_snapshot_adopt(scene, (const unsigned char *)data, &header, names, tag_bits, same_tags);
+        }
+        /* ids missing from the map are skipped by the removal */
+        while (!loaded && scene->object_count > 0) {
+            nutmeg_scene_remove_object(scene, scene->objects[scene->object_count - 1]);
+        }
+    }
+
+    nutmeg_memory_free(&scene->memory, NUTMEG_MEMORY_INDEXES, names, header.name_count * sizeof(NutmegSymbol));
+    nutmeg_memory_free(&scene->memory, NUTMEG_MEMORY_INDEXES, strings, string_count * sizeof(const char *));
+    return loaded;
+}
+
+bool nutmeg_scene_load_snapshot(NutmegScene *scene, const char *path)
+{
+    if (!scene || !path) {
+        return false;
+    }
+
+    NutmegFileMap map;
+    if (!nutmeg_file_map(&map, path)) {
+        return false;
+    }
+    bool loaded = nutmeg_scene_load_snapshot_memory(scene, map.data, map.size);
+    nutmeg_file_unmap(&map);
+    return loaded;
+}
+
+/*
+ * A checkpoint sees each chunk as one image: the counters and columns from
+ * live_count up to the handles, then the cold data. Handles, the chunk's
+ * base and its scene never change, so they are left out, and so are the
+ * generation peaks, which a restore must not roll back.
+ */
+#define NUTMEG_CHUNK_STATE_OFFSET offsetof(NutmegObjectChunk, live_count)
+#define NUTMEG_CHUNK_STATE_SIZE (offsetof(NutmegObjectChunk, objects) - NUTMEG_CHUNK_STATE_OFFSET)
+#define NUTMEG_CHUNK_IMAGE_SIZE (NUTMEG_CHUNK_STATE_SIZE + NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(NutmegObjectCold))
+
+/* Leading part of a checkpoint's index; the free list and the query group members follow. */
+typedef struct NutmegCheckpointCounts {
+    size_t slot_count;
+    size_t object_count;
+    size_t free_count;
+    size_t group_count;
+    unsigned long next_object_id;
+} NutmegCheckpointCounts;
+
+/* Header of a condition payload in a checkpoint's state; the bytes follow it. */
+typedef struct NutmegCheckpointPayload {
+    void *userdata;
+    size_t size;
+} NutmegCheckpointPayload;
+
+/*
+ * Extend the checkpoint shadow over chunks created since it last grew.
+ * Their images start out as those of a fresh chunk, which is what every
+ * checkpoint taken before they existed would have seen.
+ */
+static bool nutmeg_scene_shadow_cover(NutmegScene *scene)
+{
+    NutmegCheckpointRing *ring = &scene->checkpoints;
+    size_t covered = ring->shadow_size / NUTMEG_CHUNK_IMAGE_SIZE;
+    if (covered == scene->chunk_count) {
+        return true;
+    }
+    if (!nutmeg_checkpoint_shadow_grow(ring, scene->chunk_count * NUTMEG_CHUNK_IMAGE_SIZE)) {
+        return false;
+    }
+
+    size_t generations = offsetof(NutmegObjectChunk, generations) - NUTMEG_CHUNK_STATE_OFFSET;
+    unsigned int first = 1;
+    for (size_t c = covered; c < scene->chunk_count; ++c) {
+        unsigned char *image = ring->shadow + c * NUTMEG_CHUNK_IMAGE_SIZE;
+        memset(image, 0, NUTMEG_CHUNK_IMAGE_SIZE);
+        for (size_t i = 0; i < NUTMEG_OBJECT_CHUNK_CAPACITY; ++i) {
+            memcpy(image + generations + i * sizeof(unsigned int), &first, sizeof(first));
+        }
+    }
+    return true;
+}
+
+/* Describe the structure: counters, free list order and the member order of every query group. */
+static bool nutmeg_checkpoint_write_index(NutmegScene *scene, NutmegCheckpoint *checkpoint)
+{
+    NutmegCheckpointRing *ring = &scene->checkpoints;
+    NutmegCheckpointCounts counts;
+    memset(&counts, 0, sizeof(counts));
+    counts.slot_count = scene->slot_count;
+    counts.object_count = scene->object_count;
+    counts.free_count = scene->free_count;
+    counts.group_count = scene->query_group_count;
+    counts.next_object_id = scene->next_object_id;
+    if (!nutmeg_checkpoint_append(ring, &checkpoint->index, &counts, sizeof(counts)) || !nutmeg_checkpoint_append(ring, &checkpoint->index, scene->free_slots, scene->free_count * sizeof(size_t))) {
+        return false;
+    }
+
+    for (size_t g = 0; g < scene->query_group_count; ++g) {
+        const NutmegObjectList *members = &scene->query_groups[g].members;
+        if (!nutmeg_checkpoint_append(ring, &checkpoint->index, &members->count, sizeof(size_t))) {
+            return false;
+        }
+        unsigned char *slots = (unsigned char *)nutmeg_checkpoint_append(ring, &checkpoint->index, NULL, members->count * sizeof(size_t));
+        if (!slots) {
+            return false;
+        }
+        for (size_t m = 0; m < members->count; ++m) {
+            size_t slot = members->objects[m]->chunk->base + members->objects[m]->index;
+            memcpy(slots + m * sizeof(size_t), &slot, sizeof(slot));
+        }
+    }
+    return true;
+}
+
+/* Store the triggered flag of every event and the payload of every stateful condition. */
+static bool nutmeg_checkpoint_write_state(NutmegScene *scene, NutmegCheckpoint *checkpoint)
+{
+    NutmegCheckpointRing *ring = &scene->checkpoints;
+    if (!nutmeg_checkpoint_append(ring, &checkpoint->state, &scene->event_count, sizeof(size_t))) {
+        return false;
+    }
+    for (size_t e = 0; e < scene->event_count; ++e) {
+        unsigned char triggered = scene->events[e].triggered ? 1 : 0;
+        if (!nutmeg_checkpoint_append(ring, &checkpoint->state, &triggered, 1)) {
+            return false;
+        }
+    }
+
+    for (size_t e = 0; e < scene->event_count; ++e) {
+        const NutmegEvent *event = &scene->events[e];
+        for (size_t c = 0; c < event->condition_count; ++c) {
+            const NutmegCondition *condition = &event->conditions[c];
+            if (condition->state_size == 0 || !condition->userdata) {
+                continue;
+            }
+            NutmegCheckpointPayload payload;
+            payload.userdata = condition->userdata;
+            payload.size = condition->state_size;
+            if (!nutmeg_checkpoint_append(ring, &checkpoint->state, &payload, sizeof(payload)) || !nutmeg_checkpoint_append(ring, &checkpoint->state, payload.userdata, payload.size)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool nutmeg_scene_reserve_checkpoints(NutmegScene *scene, size_t capacity)
+{
+    if (!scene || scene->defer_depth > 0) {
+        return false;
+    }
+    return nutmeg_checkpoint_ring_reserve(&scene->checkpoints, capacity);
+}
+
+unsigned long long nutmeg_scene_checkpoint(NutmegScene *scene)
+{
+    if (!scene || scene->defer_depth > 0) {
+        return 0;
+    }
+
+    NutmegCheckpointRing *ring = &scene->checkpoints;
+    if (ring->capacity == 0 && !nutmeg_checkpoint_ring_reserve(ring, NUTMEG_CHECKPOINT_CAPACITY_DEFAULT)) {
+        return 0;
+    }
+    if (!nutmeg_scene_shadow_cover(scene)) {
+        return 0;
+    }
+
+    NutmegCheckpoint *checkpoint = nutmeg_checkpoint_ring_push(ring);
+    checkpoint->structure_version = scene->structure_version;
+    bool stored = true;
+    for (size_t c = 0; c < scene->chunk_count && stored; ++c) {
+        const NutmegObjectChunk *chunk = scene->chunks[c];
+        size_t offset = c * NUTMEG_CHUNK_IMAGE_SIZE;
+        stored = nutmeg_checkpoint_diff(ring, checkpoint, offset, (const unsigned char *)chunk + NUTMEG_CHUNK_STATE_OFFSET, NUTMEG_CHUNK_STATE_SIZE) &&
+                 nutmeg_checkpoint_diff(ring, checkpoint, offset + NUTMEG_CHUNK_STATE_SIZE, chunk->cold, NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(NutmegObjectCold));
+    }
+
+    /* unchanged structure is described once, by the first checkpoint that saw it */
+    bool shares_index = ring->count > 1 && nutmeg_checkpoint_ring_at(ring, ring->count - 2)->structure_version == scene->structure_version;
+    if (stored && !shares_index) {
+        stored = nutmeg_checkpoint_write_index(scene, checkpoint);
+        checkpoint->has_index = true;
+    }
+    stored = stored && nutmeg_checkpoint_write_state(scene, checkpoint);
+
+    if (!stored) {
+        nutmeg_checkpoint_undo(ring, checkpoint);
+        nutmeg_checkpoint_ring_truncate(ring, ring->count - 1);
+        return 0;
+    }
+    return checkpoint->id;
+}
+
+/* Rebuild every index from the restored chunks and the structure a checkpoint described. */
+static void nutmeg_scene_rebuild_indexes(NutmegScene *scene, const NutmegCheckpointBuffer *index)
+{
+    const unsigned char *at = index->data;
+    NutmegCheckpointCounts counts;
+    memcpy(&counts, at, sizeof(counts));
+    at += sizeof(counts);
+
+    scene->slot_count = counts.slot_count;
+    scene->next_object_id = counts.next_object_id;
+    scene->free_slots = (size_t *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->free_slots, sizeof(size_t), &scene->free_capacity, counts.free_count);
+    if (counts.free_count > 0) {
+        memcpy(scene->free_slots, at, counts.free_count * sizeof(size_t));
+    }
+    scene->free_count = counts.free_count;
+    at += counts.free_count * sizeof(size_t);
+
+    scene->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, scene->objects, sizeof(NutmegObject *), &scene->object_capacity, counts.object_count);
+    scene->object_count = counts.object_count;
+    if (scene->id_map.capacity > 0) {
+        memset(scene->id_map.ids, 0, scene->id_map.capacity * sizeof(unsigned long));
+    }
+    scene->id_map.count = 0;
+    if (!nutmeg_id_map_reserve(&scene->id_map, &scene->memory, counts.object_count)) {
+        /* allocation failure is fatal */
+        abort();
+    }
+    for (size_t n = 0; n < scene->name_list_count; ++n) {
+        scene->name_lists[n].count = 0;
+    }
+
+    /* dense and name list positions are part of the cold data */
+    for (size_t c = 0; c < scene->chunk_count; ++c) {
+        NutmegObjectChunk *chunk = scene->chunks[c];
+        for (size_t i = 0; i < chunk->high_water; ++i) {
+            if (!nutmeg_atomic_load_u8(&chunk->alive[i])) {
+                continue;
+            }
+            NutmegObject *object = &chunk->objects[i];
+            const NutmegObjectCold *cold = &chunk->cold[i];
+            scene->objects[cold->dense_index] = object;
+            nutmeg_id_map_insert_unchecked(&scene->id_map, chunk->ids[i], chunk->base + i);
+            if (chunk->names[i] != NUTMEG_SYMBOL_NONE) {
+                NutmegObjectList *list = &scene->name_lists[chunk->names[i]];
+                list->objects = (NutmegObject **)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_INDEXES, list->objects, sizeof(NutmegObject *), &list->capacity, cold->name_index + 1);
+                list->objects[cold->name_index] = object;
+                if (cold->name_index >= list->count) {
+                    list->count = cold->name_index + 1;
+                }
+            }
+        }
+    }
+
+    for (size_t g = 0; g < scene->query_group_count; ++g) {
+        NutmegQueryGroup *group = &scene->query_groups[g];
+        for (size_t p = 0; p < group->position_capacity; ++p) {
+            group->positions[p] = NUTMEG_QUERY_NOT_MEMBER;
+        }
+        group->members.count = 0;
+
+        if (g >= counts.group_count) {
+            /* tracked since the checkpoint: collect the members afresh */
+            for (size_t i = 0; i < scene->object_count; ++i) {
+                NutmegObject *object = scene->objects[i];
+                if (nutmeg_query_matches(&group->query, object)) {
+                    nutmeg_query_group_insert(scene, group, object, object->chunk->base + object->index);
+                }
+            }
+            continue;
+        }
+
+        size_t member_count = 0;
+        memcpy(&member_count, at, sizeof(member_count));
+        at += sizeof(member_count);
+        for (size_t m = 0; m < member_count; ++m) {
+            size_t slot = 0;
+            memcpy(&slot, at, sizeof(slot));
+            at += sizeof(slot);
+            nutmeg_query_group_insert(scene, group, nutmeg_scene_object_at(scene, slot), slot);
+        }
+    }
+}
+
+/* Put back triggered flags and condition payloads. Events added after the checkpoint keep theirs. */
+static void nutmeg_scene_restore_state(NutmegScene *scene, const NutmegCheckpointBuffer *state)
+{
+    const unsigned char *at = state->data;
+    const unsigned char *end = state->data + state->size;
+    size_t event_count = 0;
+    memcpy(&event_count, at, sizeof(event_count));
+    at += sizeof(event_count);
+
+    for (size_t e = 0; e < event_count; ++e) {
+        bool triggered = at[e] != 0;
+        if (e < scene->event_count && scene->events[e].triggered != triggered) {
+            /* once-events drop out of the compiled program when they fire */
+            scene->events[e].triggered = triggered;
+            scene->program.dirty = true;
+        }
+    }
+    at += event_count;
+
+    while (at < end) {
+        NutmegCheckpointPayload payload;
+        memcpy(&payload, at, sizeof(payload));
+        at += sizeof(payload);
+        memcpy(payload.userdata, at, payload.size);
+        at += payload.size;
+    }
+}
+
+bool nutmeg_scene_restore(NutmegScene *scene, unsigned long long checkpoint_id)
+{
+    if (!scene || scene->defer_depth > 0) {
+        return false;
+    }
+
+    NutmegCheckpointRing *ring = &scene->checkpoints;
+    size_t position = 0;
+    if (!nutmeg_checkpoint_ring_find(ring, checkpoint_id, &position) || !nutmeg_scene_shadow_cover(scene)) {
+        return false;
+    }
+
+    /* walk the shadow back to the checkpoint, then copy it over the chunks */
+    for (size_t p = ring->count - 1; p > position; --p) {
+        nutmeg_checkpoint_undo(ring, nutmeg_checkpoint_ring_at(ring, p));
+    }
+    nutmeg_checkpoint_ring_truncate(ring, position + 1);
+    for (size_t c = 0; c < scene->chunk_count; ++c) {
+        NutmegObjectChunk *chunk = scene->chunks[c];
+        const unsigned char *image = ring->shadow + c * NUTMEG_CHUNK_IMAGE_SIZE;
+        memcpy((unsigned char *)chunk + NUTMEG_CHUNK_STATE_OFFSET, image, NUTMEG_CHUNK_STATE_SIZE);
+        memcpy(chunk->cold, image + NUTMEG_CHUNK_STATE_SIZE, NUTMEG_OBJECT_CHUNK_CAPACITY * sizeof(NutmegObjectCold));
+
+        /*
+         * Generations came back with the image, but handles to objects that
+         * lived in a slot after the checkpoint are still out there. Move every
+         * empty slot past the highest generation it has handed out.
+         */
+        for (size_t i = 0; i < NUTMEG_OBJECT_CHUNK_CAPACITY; ++i) {
+            if (!nutmeg_atomic_load_u8(&chunk->alive[i]) && chunk->generations[i] <= chunk->generation_peaks[i]) {
+                chunk->generations[i] = nutmeg_generation_after(chunk->generation_peaks[i]);
+            }
+        }
+    }
+
+    NutmegCheckpoint *checkpoint = nutmeg_checkpoint_ring_at(ring, position);
+    if (scene->structure_version != checkpoint->structure_version) {
+        size_t owner = position;
+        while (!nutmeg_checkpoint_ring_at(ring, owner)->has_index) {
+            --owner;
+        }
+        nutmeg_scene_rebuild_indexes(scene, &nutmeg_checkpoint_ring_at(ring, owner)->index);
+        scene->structure_version = checkpoint->structure_version;
+    }
+    nutmeg_atomic_store_u64(&scene->spatial_valid, 0);
+    nutmeg_scene_restore_state(scene, &checkpoint->state);
+    return true;
+}
+
+void nutmeg_scene_add_event(NutmegScene *scene, NutmegEvent event)
+{
+    if (!scene) {
+        return;
+    }
+
+    if (event.scope == NUTMEG_EVENT_SCOPE_OBJECTS && !nutmeg_query_is_empty(&event.query) && !nutmeg_query_is_name_only(&event.query)) {
+        nutmeg_scene_query_group(scene, &event.query);
+    }
+
+    size_t slot_count = event.condition_count + event.action_count;
+    NutmegSlotStats *slots = NULL;
+    if (slot_count > 0) {
+        slots = (NutmegSlotStats *)nutmeg_memory_alloc(&scene->memory, NUTMEG_MEMORY_EVENTS, slot_count * sizeof(NutmegSlotStats));
+        if (!slots) {
+            /* allocation failure is fatal */
+            abort();
+        }
+    }
+
+    scene->event_stats = (NutmegEventStats *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, scene->event_stats, sizeof(NutmegEventStats), &scene->event_stats_capacity, scene->event_count + 1);
+    memset(&scene->event_stats[scene->event_count], 0, sizeof(NutmegEventStats));
+    scene->event_stats[scene->event_count].slots = slots;
+
+    /*
+     * The condition and action arrays were built before the event had a
+     * scene, from the default allocator. Move them into scene memory so every
+     * block the scene owns comes from the engine's allocator.
+     */
+    NutmegCondition *conditions = event.conditions;
+    NutmegAction *actions = event.actions;
+    size_t condition_capacity = event.condition_capacity;
+    size_t action_capacity = event.action_capacity;
+    event.conditions = NULL;
+    event.actions = NULL;
+    event.condition_capacity = 0;
+    event.action_capacity = 0;
+    if (event.condition_count > 0) {
+        event.conditions = (NutmegCondition *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, NULL, sizeof(NutmegCondition), &event.condition_capacity, event.condition_count);
+        memcpy(event.conditions, conditions, event.condition_count * sizeof(NutmegCondition));
+    }
+    if (event.action_count > 0) {
+        event.actions = (NutmegAction *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, NULL, sizeof(NutmegAction), &event.action_capacity, event.action_count);
+        memcpy(event.actions, actions, event.action_count * sizeof(NutmegAction));
+    }
+    nutmeg_free_array(NULL, NUTMEG_MEMORY_EVENTS, conditions, sizeof(NutmegCondition), condition_capacity);
+    nutmeg_free_array(NULL, NUTMEG_MEMORY_EVENTS, actions, sizeof(NutmegAction), action_capacity);
+    if (nutmeg_event_is_reorderable(&event)) {
+        scene->event_stats[scene->event_count].plan = nutmeg_condition_plan_create(&scene->memory, &event);
+    }
+
+    scene->events = (NutmegEvent *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, scene->events, sizeof(NutmegEvent), &scene->event_capacity, scene->event_count + 1);
+    scene->events[scene->event_count++] = event;
+    scene->program.dirty = true;
+}
+
+void nutmeg_event_reset(NutmegEvent *event)
+{
+    if (!event) {
+        return;
+    }
+
+    event->triggered = false;
+    for (size_t i = 0; i < event->condition_count; ++i) {
+        /* no per-condition state to reset currently */
+        (void)i;
+    }
+}
+
+NutmegEvent nutmeg_event_make(const char *name, NutmegEventScope scope, bool once)
+{
+    NutmegEvent event;
+    event.name = name;
+    event.scope = scope;
+    event.once = once;
+    event.triggered = false;
+    event.flags = 0;
+    event.query.name = NUTMEG_SYMBOL_NONE;
+    event.query.tags = 0;
+    event.query.type_id = 0;
+    event.conditions = NULL;
+    event.condition_count = 0;
+    event.condition_capacity = 0;
+    event.actions = NULL;
+    event.action_count = 0;
+    event.action_capacity = 0;
+    return event;
+}
+
+/* State checkpoints save for conditions of the builtin stateful kinds. */
+static size_t nutmeg_condition_state_size(NutmegConditionFn fn)
+{
+    return fn == nutmeg_condition_timer ? sizeof(NutmegTimer) : 0;
+}
+
+void nutmeg_event_add_condition(NutmegEvent *event, NutmegConditionFn fn, void *userdata)
+{
+    if (!event || !fn) {
+        return;
+    }
+
+    event->conditions = (NutmegCondition *)nutmeg_realloc_array(NULL, NUTMEG_MEMORY_EVENTS, event->conditions, sizeof(NutmegCondition), &event->condition_capacity, event->condition_count + 1);
+    event->conditions[event->condition_count].fn = fn;
+    event->conditions[event->condition_count].batch = NULL;
+    event->conditions[event->condition_count].userdata = userdata;
+    event->conditions[event->condition_count].flags = 0;
+    event->conditions[event->condition_count].state_size = nutmeg_condition_state_size(fn);
+    event->condition_count += 1;
+}
+
+void nutmeg_event_add_action(NutmegEvent *event, NutmegActionFn fn, void *userdata)
+{
+    if (!event || !fn) {
+        return;
+    }
+
+    event->actions = (NutmegAction *)nutmeg_realloc_array(NULL, NUTMEG_MEMORY_EVENTS, event->actions, sizeof(NutmegAction), &event->action_capacity, event->action_count + 1);
+    event->actions[event->action_count].fn = fn;
+    event->actions[event->action_count].batch = NULL;
+    event->actions[event->action_count].userdata = userdata;
+    event->action_count += 1;
+}
+
+void nutmeg_event_add_condition_batch(NutmegEvent *event, NutmegConditionBatchFn batch, NutmegConditionFn fn, void *userdata)
+{
+    if (!event || !batch) {
+        return;
+    }
+
+    event->conditions = (NutmegCondition *)nutmeg_realloc_array(NULL, NUTMEG_MEMORY_EVENTS, event->conditions, sizeof(NutmegCondition), &event->condition_capacity, event->condition_count + 1);
+    event->conditions[event->condition_count].fn = fn;
+    event->conditions[event->condition_count].batch = batch;
+    event->conditions[event->condition_count].userdata = userdata;
+    event->conditions[event->condition_count].flags = 0;
+    event->conditions[event->condition_count].state_size = nutmeg_condition_state_size(fn);
+    event->condition_count += 1;
+}
+
+void nutmeg_event_add_action_batch(NutmegEvent *event, NutmegActionBatchFn batch, NutmegActionFn fn, void *userdata)
+{
+    if (!event || !batch) {
+        return;
+    }
+
+    event->actions = (NutmegAction *)nutmeg_realloc_array(NULL, NUTMEG_MEMORY_EVENTS, event->actions, sizeof(NutmegAction), &event->action_capacity, event->action_count + 1);
+    event->actions[event->action_count].fn = fn;
+    event->actions[event->action_count].batch = batch;
+    event->actions[event->action_count].userdata = userdata;
+    event->action_count += 1;
+}
+
+void nutmeg_event_set_condition_flags(NutmegEvent *event, size_t condition_index, unsigned int flags)
+{
+    if (!event || condition_index >= event->condition_count) {
+        return;
+    }
+
+    event->conditions[condition_index].flags = flags;
+}
+
+void nutmeg_event_set_condition_state_size(NutmegEvent *event, size_t condition_index, size_t state_size)
+{
+    if (!event || condition_index >= event->condition_count) {
+        return;
+    }
+
+    event->conditions[condition_index].state_size = state_size;
+}
+
+/* Span covering a single object, used to call batch-only slots per object. */
+static NutmegObjectSpan nutmeg_object_span(NutmegObject *object)
+{
+    NutmegObjectSpan span;
+    span.objects = object;
+    span.ids = &object->chunk->ids[object->index];
+    span.names = &object->chunk->names[object->index];
+    span.positions = &object->chunk->positions[object->index];
+    span.velocities = &object->chunk->velocities[object->index];
+    span.count = 1;
+    return span;
+}
+
+static bool nutmeg_condition_invoke(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegCondition *condition)
+{
+    if (condition->fn) {
+        return condition->fn(engine, scene, object, condition->userdata);
+    }
+    if (!object) {
+        return true;
+    }
+
+    NutmegObjectSpan span = nutmeg_object_span(object);
+    unsigned char selected = 1;
+    condition->batch(engine, scene, &span, &selected, condition->userdata);
+    return selected != 0;
+}
+
+static void nutmeg_action_invoke(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegAction *action)
+{
+    if (action->fn) {
+        action->fn(engine, scene, object, action->userdata);
+    } else if (object) {
+        NutmegObjectSpan span = nutmeg_object_span(object);
+        const unsigned char selected = 1;
+        action->batch(engine, scene, &span, &selected, action->userdata);
+    }
+}
+
+static bool nutmeg_conditions_pass(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegOp *op)
+{
+    for (size_t i = 0; i < op->condition_count; ++i) {
+        if (!nutmeg_condition_invoke(engine, scene, object, &op->conditions[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void nutmeg_execute_actions(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegOp *op)
+{
+    for (size_t i = 0; i < op->action_count; ++i) {
+        nutmeg_action_invoke(engine, scene, object, &op->actions[i]);
+    }
+}
+
+static void nutmeg_slot_stats_add(NutmegSlotStats *slot, unsigned long long tested, unsigned long long passed, unsigned long long elapsed_ns)
+{
+    nutmeg_atomic_fetch_add_u64(&slot->calls, 1);
+    nutmeg_atomic_fetch_add_u64(&slot->tested, tested);
+    nutmeg_atomic_fetch_add_u64(&slot->passed, passed);
+    nutmeg_atomic_fetch_add_u64(&slot->time_ns, elapsed_ns);
+}
+
+static bool nutmeg_conditions_pass_profiled(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegOp *op, NutmegEventStats *stats)
+{
+    for (size_t i = 0; i < op->condition_count; ++i) {
+        unsigned long long start = nutmeg_clock_ns();
+        bool passed = nutmeg_condition_invoke(engine, scene, object, &op->conditions[i]);
+        nutmeg_slot_stats_add(&stats->slots[op->slot_offset + i], 1, passed ? 1 : 0, nutmeg_clock_ns() - start);
+        if (!passed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void nutmeg_execute_actions_profiled(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegOp *op, NutmegEventStats *stats)
+{
+    NutmegSlotStats *slots = stats->slots + op->slot_offset + op->condition_count;
+    for (size_t i = 0; i < op->action_count; ++i) {
+        unsigned long long start = nutmeg_clock_ns();
+        nutmeg_action_invoke(engine, scene, object, &op->actions[i]);
+        nutmeg_slot_stats_add(&slots[i], 1, 1, nutmeg_clock_ns() - start);
+    }
+}
+
+/*
+ * Evaluate an event for one target (an object, or NULL for the scene) and run
+ * its actions when every condition passes. stats is NULL unless profiling.
+ */
+static bool nutmeg_run_target(NutmegScene *scene, NutmegObject *object, const NutmegOp *op, NutmegEventStats *stats)
+{
+    NutmegEngine *engine = scene->engine;
+    if (!stats) {
+        if (!nutmeg_conditions_pass(engine, scene, object, op)) {
+            return false;
+        }
+        nutmeg_execute_actions(engine, scene, object, op);
+        return true;
+    }
+
+    nutmeg_atomic_fetch_add_u64(&stats->tested, 1);
+    if (!nutmeg_conditions_pass_profiled(engine, scene, object, op, stats)) {
+        return false;
+    }
+    nutmeg_atomic_fetch_add_u64(&stats->passed, 1);
+    nutmeg_execute_actions_profiled(engine, scene, object, op, stats);
+    return true;
+}
+
+/* True when every slot of the event can run over whole spans. */
+static bool nutmeg_op_is_batched(const NutmegOp *op)
+{
+    for (size_t i = 0; i < op->condition_count; ++i) {
+        if (!op->conditions[i].batch) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < op->action_count; ++i) {
+        if (!op->actions[i].batch) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t nutmeg_mask_count(const unsigned char *mask, size_t count)
+{
+    size_t selected = 0;
+    for (size_t i = 0; i < count; ++i) {
+        selected += mask[i] ? 1 : 0;
+    }
+    return selected;
+}
+
+/*
+ * Batched variant of nutmeg_tick_chunk: conditions narrow a selection mask
+ * over the whole chunk, then the actions consume it.
+ */
+static bool nutmeg_tick_chunk_batched(NutmegScene *scene, const NutmegOp *op, NutmegEventStats *stats, NutmegObjectChunk *chunk)
+{
+    unsigned char mask[NUTMEG_OBJECT_CHUNK_CAPACITY];
+    size_t count = chunk->high_water;
+    for (size_t i = 0; i < count; ++i) {
+        mask[i] = nutmeg_atomic_load_u8(&chunk->alive[i]) ? 1 : 0;
+    }
+
+    NutmegObjectSpan span;
+    span.objects = chunk->objects;
+    span.ids = chunk->ids;
+    span.names = chunk->names;
+    span.positions = chunk->positions;
+    span.velocities = chunk->velocities;
+    span.count = count;
+
+    size_t selected = 0;
+    if (stats) {
+        selected = nutmeg_mask_count(mask, count);
+        nutmeg_atomic_fetch_add_u64(&stats->tested, selected);
+    }
+
+    for (size_t c = 0; c < op->condition_count; ++c) {
+        NutmegCondition condition = op->conditions[c];
+        if (!stats) {
+            condition.batch(scene->engine, scene, &span, mask, condition.userdata);
+            continue;
+        }
+
+        unsigned long long start = nutmeg_clock_ns();
+        condition.batch(scene->engine, scene, &span, mask, condition.userdata);
+        unsigned long long elapsed = nutmeg_clock_ns() - start;
+        size_t remaining = nutmeg_mask_count(mask, count);
+        nutmeg_slot_stats_add(&stats->slots[op->slot_offset + c], selected, remaining, elapsed);
+        selected = remaining;
+    }
+
+    if (!stats) {
+        selected = nutmeg_mask_count(mask, count);
+    }
+    if (selected == 0) {
+        return false;
+    }
+
+    if (stats) {
+        nutmeg_atomic_fetch_add_u64(&stats->passed, selected);
+    }
+    for (size_t a = 0; a < op->action_count; ++a) {
+        NutmegAction action = op->actions[a];
+        if (!stats) {
+            action.batch(scene->engine, scene, &span, mask, action.userdata);
+            continue;
+        }
+
+        unsigned long long start = nutmeg_clock_ns();
+        action.batch(scene->engine, scene, &span, mask, action.userdata);
+        nutmeg_slot_stats_add(&stats->slots[op->slot_offset + op->condition_count + a], selected, selected, nutmeg_clock_ns() - start);
+    }
+    return true;
+}
+
+/* Run an OBJECTS-scope event over one chunk. Returns true when any object passed. */
+static bool nutmeg_tick_chunk(NutmegScene *scene, const NutmegOp *op, NutmegEventStats *stats, bool batched, NutmegObjectChunk *chunk)
+{
+    if (batched) {
+        return nutmeg_tick_chunk_batched(scene, op, stats, chunk);
+    }
+
+    bool triggered = false;
+    size_t high_water = chunk->high_water;
+    for (size_t i = 0; i < high_water; ++i) {
+        if (nutmeg_atomic_load_u8(&chunk->alive[i]) && nutmeg_run_target(scene, &chunk->objects[i], op, stats)) {
+            triggered = true;
+        }
+    }
+    return triggered;
+}
+
+/* Run an OBJECTS-scope event over members [begin, end) of a query result. */
+static bool nutmeg_tick_members(NutmegScene *scene, const NutmegOp *op, NutmegEventStats *stats, NutmegObject **members, size_t begin, size_t end)
+{
+    bool triggered = false;
+    for (size_t i = begin; i < end; ++i) {
+        NutmegObject *object = members[i];
+        /* destroyed earlier this tick; the lists only change once it is over */
+        if (!nutmeg_atomic_load_u8(&object->chunk->alive[object->index])) {
+            continue;
+        }
+
+        if (nutmeg_run_target(scene, object, op, stats)) {
+            triggered = true;
+        }
+    }
+    return triggered;
+}
+
+/* nutmeg_tick_chunk inside a batch span on lane when a trace is recording. */
+static bool nutmeg_tick_chunk_traced(NutmegScene *scene, const NutmegOp *op, NutmegEventStats *stats, bool batched, NutmegObjectChunk *chunk, unsigned int lane)
+{
+    NutmegTrace *trace = nutmeg_engine_recording_trace(scene->engine);
+    if (!trace) {
+        return nutmeg_tick_chunk(scene, op, stats, batched, chunk);
+    }
+
+    unsigned long long start = nutmeg_clock_ns();
+    bool triggered = nutmeg_tick_chunk(scene, op, stats, batched, chunk);
+    nutmeg_trace_span(trace, lane, NUTMEG_TRACE_BATCH, op->name, start, (unsigned int)chunk->live_count);
+    return triggered;
+}
+
+/* nutmeg_tick_members inside a batch span on lane when a trace is recording. */
+static bool nutmeg_tick_members_traced(NutmegScene *scene, const NutmegOp *op, NutmegEventStats *stats, NutmegObject **members, size_t begin, size_t end, unsigned int lane)
+{
+    NutmegTrace *trace = nutmeg_engine_recording_trace(scene->engine);
+    if (!trace) {
+        return nutmeg_tick_members(scene, op, stats, members, begin, end);
+    }
+
+    unsigned long long start = nutmeg_clock_ns();
+    bool triggered = nutmeg_tick_members(scene, op, stats, members, begin, end);
+    nutmeg_trace_span(trace, lane, NUTMEG_TRACE_BATCH, op->name, start, (unsigned int)(end - begin));
+    return triggered;
+}
+
+/*
+ * Apply a fused run of op_count events to one chunk, or to members
+ * [begin, end) when chunk is NULL, inside a batch span on lane when a trace
+ * is recording. A batched event covers the whole chunk at once; neighbouring
+ * per-object events take turns on each target before it moves on. Returns
+ * a mask with bit k set when the actions of ops[k] ran.
+ */
+static unsigned long long nutmeg_tick_fused_traced(NutmegScene *scene, const NutmegOp *ops, size_t op_count, NutmegObjectChunk *chunk, NutmegObject **members, size_t begin, size_t end, unsigned int lane)
+{
+    NutmegTrace *trace = nutmeg_engine_recording_trace(scene->engine);
+    unsigned long long start = trace ? nutmeg_clock_ns() : 0;
+    unsigned long long triggered = 0;
+
+    if (!chunk) {
+        for (size_t i = begin; i < end; ++i) {
+            NutmegObject *object = members[i];
+            /* alive is re-read per event: an earlier one may have destroyed the object */
+            for (size_t k = 0; k < op_count && nutmeg_atomic_load_u8(&object->chunk->alive[object->index]); ++k) {
+                if (nutmeg_run_target(scene, object, &ops[k], NULL)) {
+                    triggered |= 1ull << k;
+                }
+            }
+        }
+    } else {
+        size_t k = 0;
+        while (k < op_count) {
+            if (ops[k].batched) {
+                if (nutmeg_tick_chunk_batched(scene, &ops[k], NULL, chunk)) {
+                    triggered |= 1ull << k;
+                }
+                k++;
+                continue;
+            }
+
+            size_t last = k + 1;
+            while (last < op_count && !ops[last].batched) {
+                last++;
+            }
+            size_t high_water = chunk->high_water;
+            for (size_t i = 0; i < high_water; ++i) {
+                for (size_t j = k; j < last && nutmeg_atomic_load_u8(&chunk->alive[i]); ++j) {
+                    if (nutmeg_run_target(scene, &chunk->objects[i], &ops[j], NULL)) {
+                        triggered |= 1ull << j;
+                    }
+                }
+            }
+            k = last;
+        }
+    }
+
+    if (trace) {
+        nutmeg_trace_span(trace, lane, NUTMEG_TRACE_BATCH, ops[0].name, start, (unsigned int)(chunk ? chunk->live_count : end - begin));
+    }
+    return triggered;
+}
+
+typedef struct NutmegParallelPass {
+    NutmegScene *scene;
+    const NutmegOp *ops;      /**< The event, or the first of a fused run. */
+    size_t op_count;
+    NutmegEventStats *stats;
+    bool batched;
+    NutmegObjectChunk **chunks;
+    NutmegObject **members;   /**< Query result split into chunk sized tasks, or NULL. */
+    size_t member_count;
+    NutmegAtomicU64 triggered; /**< Bit k is set once ops[k] ran its actions. */
+} NutmegParallelPass;
+
+static void nutmeg_parallel_pass_mark(NutmegParallelPass *pass, unsigned long long triggered)
+{
+    unsigned long long current = nutmeg_atomic_load_u64(&pass->triggered);
+    while ((current & triggered) != triggered && !nutmeg_atomic_cas_u64(&pass->triggered, current, current | triggered)) {
+        current = nutmeg_atomic_load_u64(&pass->triggered);
+    }
+}
+
+static void nutmeg_parallel_pass_task(void *context, size_t task_index, unsigned int worker_index)
+{
+    NutmegParallelPass *pass = (NutmegParallelPass *)context;
+    NutmegObjectChunk *chunk = NULL;
+    size_t begin = 0;
+    size_t end = 0;
+    if (pass->members) {
+        begin = task_index * NUTMEG_OBJECT_CHUNK_CAPACITY;
+        end = begin + NUTMEG_OBJECT_CHUNK_CAPACITY;
+        if (end > pass->member_count) {
+            end = pass->member_count;
+        }
+    } else {
+        chunk = pass->chunks[task_index];
+    }
+
+    unsigned long long triggered = 0;
+    if (pass->op_count > 1) {
+        triggered = nutmeg_tick_fused_traced(pass->scene, pass->ops, pass->op_count, chunk, pass->members, begin, end, worker_index);
+    } else if (chunk) {
+        triggered = nutmeg_tick_chunk_traced(pass->scene, pass->ops, pass->stats, pass->batched, chunk, worker_index) ? 1 : 0;
+    } else {
+        triggered = nutmeg_tick_members_traced(pass->scene, pass->ops, pass->stats, pass->members, begin, end, worker_index) ? 1 : 0;
+    }
+    if (triggered) {
+        nutmeg_parallel_pass_mark(pass, triggered);
+    }
+}
+
+/*
+ * Spread an OBJECTS-scope event, or a fused run of op_count events, over the
+ * query result, one task per chunk's worth of members. Returns the mask of
+ * events that triggered.
+ */
+static unsigned long long nutmeg_tick_members_parallel(NutmegScene *scene, const NutmegOp *ops, size_t op_count, NutmegEventStats *stats, NutmegObject **members, size_t member_count)
+{
+    NutmegParallelPass pass;
+    pass.scene = scene;
+    pass.ops = ops;
+    pass.op_count = op_count;
+    pass.stats = stats;
+    pass.batched = false;
+    pass.chunks = NULL;
+    pass.members = members;
+    pass.member_count = member_count;
+    pass.triggered = 0;
+    size_t task_count = (member_count + NUTMEG_OBJECT_CHUNK_CAPACITY - 1) / NUTMEG_OBJECT_CHUNK_CAPACITY;
+    nutmeg_thread_pool_run(scene->engine->pool, task_count, nutmeg_parallel_pass_task, &pass);
+    return nutmeg_atomic_load_u64(&pass.triggered);
+}
+
+/* Spread an OBJECTS-scope event, or a fused run, over the worker pool, one task per chunk. */
+static unsigned long long nutmeg_tick_objects_parallel(NutmegScene *scene, const NutmegOp *ops, size_t op_count, NutmegEventStats *stats, bool batched)
+{
+    NutmegEngine *engine = scene->engine;
+
+    /* one task per chunk holding objects; spawns issued by the tasks leave scene->chunks alone until the flush */
+    engine->parallel_chunks = (NutmegObjectChunk **)nutmeg_realloc_array(&engine->memory, NUTMEG_MEMORY_ENGINE, engine->parallel_chunks, sizeof(NutmegObjectChunk *), &engine->parallel_chunk_capacity, scene->chunk_count);
+    size_t task_count = 0;
+    for (size_t c = 0; c < scene->chunk_count; ++c) {
+        if (scene->chunks[c]->live_count > 0) {
+            engine->parallel_chunks[task_count++] = scene->chunks[c];
+        }
+    }
+
+    NutmegParallelPass pass;
+    pass.scene = scene;
+    pass.ops = ops;
+    pass.op_count = op_count;
+    pass.stats = stats;
+    pass.batched = batched;
+    pass.chunks = engine->parallel_chunks;
+    pass.members = NULL;
+    pass.member_count = 0;
+    pass.triggered = 0;
+    nutmeg_thread_pool_run(engine->pool, task_count, nutmeg_parallel_pass_task, &pass);
+    return nutmeg_atomic_load_u64(&pass.triggered);
+}
+
+/* Pool for the scene's parallel events; NULL when the scene is itself ticked by a pool task. */
+static NutmegThreadPool *nutmeg_scene_pool(const NutmegScene *scene)
+{
+    return scene->tick_nested ? NULL : scene->engine->pool;
+}
+
+/* Dispatch one event over its targets. Returns true when its actions ran. */
+static bool nutmeg_tick_event(NutmegScene *scene, const NutmegOp *op, NutmegEventStats *stats)
+{
+    if (op->scope != NUTMEG_EVENT_SCOPE_OBJECTS) {
+        return nutmeg_run_target(scene, NULL, op, stats);
+    }
+
+    bool parallel = (op->flags & NUTMEG_EVENT_FLAG_PARALLEL) && nutmeg_scene_pool(scene);
+    NutmegObject **members = NULL;
+    size_t member_count = 0;
+    if (nutmeg_scene_query_members(scene, &op->query, &members, &member_count)) {
+        /* only the matching objects are visited, one at a time */
+        if (parallel && member_count > NUTMEG_OBJECT_CHUNK_CAPACITY) {
+            return nutmeg_tick_members_parallel(scene, op, 1, stats, members, member_count) != 0;
+        }
+        return nutmeg_tick_members_traced(scene, op, stats, members, 0, member_count, scene->tick_lane);
+    }
+
+    if (parallel && scene->chunk_count > 1) {
+        /* returns only after every chunk is done, keeping event order intact */
+        return nutmeg_tick_objects_parallel(scene, op, 1, stats, op->batched) != 0;
+    }
+
+    bool triggered = false;
+    for (size_t c = 0; c < scene->chunk_count; ++c) {
+        NutmegObjectChunk *chunk = scene->chunks[c];
+        if (chunk->live_count > 0 && nutmeg_tick_chunk_traced(scene, op, stats, op->batched, chunk, scene->tick_lane)) {
+            triggered = true;
+        }
+    }
+    return triggered;
+}
+
+/*
+ * Dispatch a fused run of op_count events over the targets they share,
+ * visiting each target once. Only a run of parallel events uses the pool.
+ * Returns a mask with bit k set when the actions of ops[k] ran.
+ */
+static unsigned long long nutmeg_tick_fused(NutmegScene *scene, const NutmegOp *ops, size_t op_count)
+{
+    bool parallel = nutmeg_scene_pool(scene) != NULL;
+    for (size_t k = 0; k < op_count; ++k) {
+        if (!(ops[k].flags & NUTMEG_EVENT_FLAG_PARALLEL)) {
+            parallel = false;
+        }
+    }
+
+    NutmegObject **members = NULL;
+    size_t member_count = 0;
+    if (nutmeg_scene_query_members(scene, &ops[0].query, &members, &member_count)) {
+        if (parallel && member_count > NUTMEG_OBJECT_CHUNK_CAPACITY) {
+            return nutmeg_tick_members_parallel(scene, ops, op_count, NULL, members, member_count);
+        }
+        return nutmeg_tick_fused_traced(scene, ops, op_count, NULL, members, 0, member_count, scene->tick_lane);
+    }
+
+    if (parallel && scene->chunk_count > 1) {
+        return nutmeg_tick_objects_parallel(scene, ops, op_count, NULL, false);
+    }
+
+    unsigned long long triggered = 0;
+    for (size_t c = 0; c < scene->chunk_count; ++c) {
+        NutmegObjectChunk *chunk = scene->chunks[c];
+        if (chunk->live_count > 0) {
+            triggered |= nutmeg_tick_fused_traced(scene, ops, op_count, chunk, NULL, 0, 0, scene->tick_lane);
+        }
+    }
+    return triggered;
+}
+
+/* Leading conditions of an event that can be evaluated once per tick instead of per target. */
+static size_t nutmeg_event_hoistable(const NutmegEvent *event)
+{
+    size_t count = 0;
+    while (count < event->condition_count && (event->conditions[count].flags & NUTMEG_CONDITION_FLAG_INVARIANT) && event->conditions[count].fn) {
+        count++;
+    }
+    return count;
+}
 
-    scene->events = (NutmegEvent *)nutmeg_realloc_array(scene->events, sizeof(NutmegEvent), &scene->event_capacity, scene->event_count + 1);
-    scene->events[scene->event_count++] = event;
+/* True for an event instruction that may share a pass with its neighbours. */
+static bool nutmeg_op_is_fusable(const NutmegOp *op)
+{
+    return op->code == NUTMEG_OP_EVENT && op->scope == NUTMEG_EVENT_SCOPE_OBJECTS && (op->flags & (NUTMEG_EVENT_FLAG_LOCAL | NUTMEG_EVENT_FLAG_PARALLEL));
 }
 
-void nutmeg_event_reset(NutmegEvent *event)
+static bool nutmeg_queries_equal(const NutmegObjectQuery *a, const NutmegObjectQuery *b)
 {
-    if (!event) {
-        return;
+    return a->name == b->name && a->tags == b->tags && a->type_id == b->type_id;
+}
+
+static bool nutmeg_conditions_equal(const NutmegCondition *a, const NutmegCondition *b, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (a[i].fn != b[i].fn || a[i].batch != b[i].batch || a[i].userdata != b[i].userdata) {
+            return false;
+        }
     }
+    return true;
+}
 
-    event->triggered = false;
-    for (size_t i = 0; i < event->condition_count; ++i) {
-        /* no per-condition state to reset currently */
-        (void)i;
+/* Append an instruction covering conditions [first, first + count) and the given actions of event. */
+static size_t nutmeg_program_emit(NutmegScene *scene, NutmegOpCode code, size_t event_index, size_t first, size_t count, bool with_actions)
+{
+    NutmegProgram *program = &scene->program;
+    const NutmegEvent *event = &scene->events[event_index];
+    size_t action_count = with_actions ? event->action_count : 0;
+
+    program->ops = (NutmegOp *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, program->ops, sizeof(NutmegOp), &program->op_capacity, program->op_count + 1);
+    program->conditions = (NutmegCondition *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, program->conditions, sizeof(NutmegCondition), &program->condition_capacity, program->condition_count + count);
+    program->actions = (NutmegAction *)nutmeg_realloc_array(&scene->memory, NUTMEG_MEMORY_EVENTS, program->actions, sizeof(NutmegAction), &program->action_capacity, program->action_count + action_count);
+
+    NutmegOp *op = &program->ops[program->op_count];
+    memset(op, 0, sizeof(*op));
+    op->code = code;
+    op->name = event->name;
+    op->scope = event->scope;
+    op->flags = event->flags;
+    op->query = event->query;
+    op->event_index = event_index;
+    op->first_condition = program->condition_count;
+    op->condition_count = count;
+    op->first_action = program->action_count;
+    op->action_count = action_count;
+    op->slot_offset = first;
+    op->fused = 1;
+    if (count > 0) {
+        memcpy(&program->conditions[program->condition_count], &event->conditions[first], count * sizeof(NutmegCondition));
     }
+    if (action_count > 0) {
+        memcpy(&program->actions[program->action_count], event->actions, action_count * sizeof(NutmegAction));
+    }
+    program->condition_count += count;
+    program->action_count += action_count;
+    return program->op_count++;
 }
 
-NutmegEvent nutmeg_event_make(const char *name, NutmegEventScope scope, bool once)
+/*
+ * Lower the scene's events into its program. Capacity is kept between
+ * compilations, so recompiling a list that did not grow does not allocate.
+ */
+static void nutmeg_scene_compile(NutmegScene *scene)
 {
-    NutmegEvent event;
-    event.name = name;
-    event.scope = scope;
-    event.once = once;
-    event.triggered = false;
-    event.conditions = NULL;
-    event.condition_count = 0;
-    event.condition_capacity = 0;
-    event.actions = NULL;
-    event.action_count = 0;
-    event.action_capacity = 0;
-    return event;
+    NutmegProgram *program = &scene->program;
+    program->op_count = 0;
+    program->condition_count = 0;
+    program->action_count = 0;
+
+    bool guarded = false;
+    size_t guard = 0;
+    size_t leader = 0;
+    bool leader_guarded = false;
+    size_t leader_guard = 0;
+    bool fusing = false;
+    for (size_t e = 0; e < scene->event_count; ++e) {
+        const NutmegEvent *event = &scene->events[e];
+        if (event->once && event->triggered) {
+            continue;
+        }
+
+        size_t hoisted = nutmeg_event_hoistable(event);
+        if (hoisted == 0) {
+            guarded = false;
+        } else if (!guarded || program->ops[guard].condition_count != hoisted || !nutmeg_conditions_equal(&program->conditions[program->ops[guard].first_condition], event->conditions, hoisted)) {
+            guard = nutmeg_program_emit(scene, NUTMEG_OP_GUARD, e, 0, hoisted, false);
+            guarded = true;
+        }
+
+        size_t index = nutmeg_program_emit(scene, NUTMEG_OP_EVENT, e, hoisted, event->condition_count - hoisted, true);
+        if (hoisted > 0) {
+            program->ops[guard].skip++;
+        }
+
+        /* a run stays under one guard, so a failing guard skips all of it or none */
+        NutmegOp *ops = program->ops;
+        bool same_guard = guarded == leader_guarded && (!guarded || guard == leader_guard);
+        if (fusing && same_guard && index == leader + ops[leader].fused && ops[leader].fused < NUTMEG_EVENT_FUSE_MAX && nutmeg_op_is_fusable(&ops[index]) && nutmeg_queries_equal(&ops[leader].query, &ops[index].query)) {
+            ops[leader].fused++;
+        } else {
+            leader = index;
+            leader_guarded = guarded;
+            leader_guard = guard;
+            fusing = nutmeg_op_is_fusable(&ops[index]);
+        }
+    }
+
+    /* the arrays are final now: resolve the offsets */
+    for (size_t i = 0; i < program->op_count; ++i) {
+        NutmegOp *op = &program->ops[i];
+        op->conditions = program->conditions + op->first_condition;
+        op->actions = program->actions + op->first_action;
+        op->batched = nutmeg_op_is_batched(op);
+    }
+    program->dirty = false;
 }
 
-void nutmeg_event_add_condition(NutmegEvent *event, NutmegConditionFn fn, void *userdata)
+/* Counters an event's evaluation is recorded into this tick, or NULL. */
+static NutmegEventStats *nutmeg_event_run_stats(NutmegScene *scene, size_t event_index, bool profiling, bool sampling)
 {
-    if (!event || !fn) {
-        return;
+    if (profiling) {
+        return &scene->event_stats[event_index];
     }
+    NutmegConditionPlan *plan = scene->event_stats[event_index].plan;
+    return sampling && plan ? &plan->sample : NULL;
+}
 
-    event->conditions = (NutmegCondition *)nutmeg_realloc_array(event->conditions, sizeof(NutmegCondition), &event->condition_capacity, event->condition_count + 1);
-    event->conditions[event->condition_count].fn = fn;
-    event->conditions[event->condition_count].userdata = userdata;
-    event->condition_count += 1;
+/*
+ * Evaluate a guard's hoisted conditions for the scene. Each guarded event's
+ * profile records the calls; the time is charged to the first one only.
+ */
+static bool nutmeg_run_guard(NutmegScene *scene, const NutmegOp *guard, bool profiling, bool sampling)
+{
+    const NutmegOp *guarded = guard + 1;
+    bool measured = profiling || sampling;
+    for (size_t i = 0; i < guard->condition_count; ++i) {
+        unsigned long long start = measured ? nutmeg_clock_ns() : 0;
+        bool passed = nutmeg_condition_invoke(scene->engine, scene, NULL, &guard->conditions[i]);
+        if (measured) {
+            unsigned long long elapsed = nutmeg_clock_ns() - start;
+            for (size_t g = 0; g < guard->skip; ++g) {
+                NutmegEventStats *stats = nutmeg_event_run_stats(scene, guarded[g].event_index, profiling, sampling);
+                if (stats) {
+                    nutmeg_slot_stats_add(&stats->slots[i], 1, passed ? 1 : 0, g == 0 ? elapsed : 0);
+                }
+            }
+        }
+        if (!passed) {
+            return false;
+        }
+    }
+    return true;
 }
 
-void nutmeg_event_add_action(NutmegEvent *event, NutmegActionFn fn, void *userdata)
+/* Remember the condition counters of stats before a sampled evaluation. */
+static void nutmeg_condition_sample_begin(NutmegConditionPlan *plan, NutmegEventStats *stats, size_t condition_count)
 {
-    if (!event || !fn) {
-        return;
+    for (size_t k = 0; k < condition_count; ++k) {
+        NutmegConditionEstimate *estimate = &plan->estimates[k];
+        estimate->tested = nutmeg_atomic_load_u64(&stats->slots[k].tested);
+        estimate->passed = nutmeg_atomic_load_u64(&stats->slots[k].passed);
+        estimate->time_ns = nutmeg_atomic_load_u64(&stats->slots[k].time_ns);
     }
+}
 
-    event->actions = (NutmegAction *)nutmeg_realloc_array(event->actions, sizeof(NutmegAction), &event->action_capacity, event->action_count + 1);
-    event->actions[event->action_count].fn = fn;
-    event->actions[event->action_count].userdata = userdata;
-    event->action_count += 1;
+/* Expected cost of running a condition per target it lets through; lower runs first. */
+static double nutmeg_condition_rank(const NutmegConditionEstimate *estimate)
+{
+    double rejected = 1.0 - estimate->pass_rate;
+    if (rejected < 0.001) {
+        rejected = 0.001;
+    }
+    return estimate->cost_ns / rejected;
 }
 
-static bool nutmeg_conditions_pass(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegEvent *event)
+static void nutmeg_condition_swap(NutmegScene *scene, size_t event_index, size_t a, size_t b)
 {
-    for (size_t i = 0; i < event->condition_count; ++i) {
-        NutmegCondition condition = event->conditions[i];
-        if (!condition.fn(engine, scene, object, condition.userdata)) {
+    NutmegEvent *event = &scene->events[event_index];
+    NutmegEventStats *stats = &scene->event_stats[event_index];
+    NutmegConditionPlan *plan = stats->plan;
+
+    NutmegCondition condition = event->conditions[a];
+    event->conditions[a] = event->conditions[b];
+    event->conditions[b] = condition;
+    NutmegConditionEstimate estimate = plan->estimates[a];
+    plan->estimates[a] = plan->estimates[b];
+    plan->estimates[b] = estimate;
+
+    /* slot counters follow their condition so profiles stay keyed by insertion index */
+    NutmegSlotStats slot = stats->slots[a];
+    stats->slots[a] = stats->slots[b];
+    stats->slots[b] = slot;
+    slot = plan->sample.slots[a];
+    plan->sample.slots[a] = plan->sample.slots[b];
+    plan->sample.slots[b] = slot;
+}
+
+/*
+ * Fold the counters gathered since nutmeg_condition_sample_begin into the
+ * estimates, then sort every run of consecutive pure conditions by rank.
+ * Stateful conditions are never crossed, so each one still sees exactly the
+ * targets that passed the conditions inserted before it. A condition only
+ * moves ahead when it ranks clearly better, which keeps noisy samples from
+ * flipping the order back and forth.
+ */
+static void nutmeg_condition_sample_end(NutmegScene *scene, size_t event_index, NutmegEventStats *stats)
+{
+    NutmegEvent *event = &scene->events[event_index];
+    NutmegConditionPlan *plan = scene->event_stats[event_index].plan;
+    for (size_t k = 0; k < event->condition_count; ++k) {
+        NutmegConditionEstimate *estimate = &plan->estimates[k];
+        unsigned long long tested = nutmeg_atomic_load_u64(&stats->slots[k].tested) - estimate->tested;
+        if (tested == 0) {
+            continue;
+        }
+
+        double cost = (double)(nutmeg_atomic_load_u64(&stats->slots[k].time_ns) - estimate->time_ns) / (double)tested;
+        double pass_rate = (double)(nutmeg_atomic_load_u64(&stats->slots[k].passed) - estimate->passed) / (double)tested;
+        if (estimate->sampled) {
+            cost = 0.75 * estimate->cost_ns + 0.25 * cost;
+            pass_rate = 0.75 * estimate->pass_rate + 0.25 * pass_rate;
+        }
+        estimate->cost_ns = cost;
+        estimate->pass_rate = pass_rate;
+        estimate->sampled = true;
+    }
+
+    size_t begin = 0;
+    while (begin < event->condition_count) {
+        if (!(event->conditions[begin].flags & NUTMEG_CONDITION_FLAG_PURE)) {
+            begin++;
+            continue;
+        }
+        size_t end = begin + 1;
+        while (end < event->condition_count && (event->conditions[end].flags & NUTMEG_CONDITION_FLAG_PURE)) {
+            end++;
+        }
+
+        for (size_t i = begin + 1; i < end; ++i) {
+            for (size_t j = i; j > begin; --j) {
+                const NutmegConditionEstimate *next = &plan->estimates[j];
+                const NutmegConditionEstimate *prev = &plan->estimates[j - 1];
+                if (!next->sampled || !prev->sampled || nutmeg_condition_rank(next) >= 0.9 * nutmeg_condition_rank(prev)) {
+                    break;
+                }
+                nutmeg_condition_swap(scene, event_index, j, j - 1);
+                scene->program.dirty = true;
+            }
+        }
+        begin = end;
+    }
+}
+
+/* True when the fused run starting at op can run as one pass this tick: none of its counters are being recorded. */
+static bool nutmeg_scene_fuses(NutmegScene *scene, const NutmegOp *op, bool profiling, bool sampling)
+{
+    if (!scene->engine->event_fusion || profiling) {
+        return false;
+    }
+    for (size_t k = 0; sampling && k < op->fused; ++k) {
+        if (scene->event_stats[op[k].event_index].plan) {
             return false;
         }
     }
     return true;
 }
 
-static void nutmeg_execute_actions(NutmegEngine *engine, NutmegScene *scene, NutmegObject *object, const NutmegEvent *event)
+/* Record that the actions of an event ran this tick. */
+static void nutmeg_scene_event_fired(NutmegScene *scene, const NutmegOp *op)
 {
-    for (size_t i = 0; i < event->action_count; ++i) {
-        NutmegAction action = event->actions[i];
-        action.fn(engine, scene, object, action.userdata);
+    NutmegEvent *event = &scene->events[op->event_index];
+    if (event->once) {
+        /* finished: the next compilation leaves it out */
+        event->triggered = true;
+        scene->program.dirty = true;
     }
 }
 
-static void nutmeg_tick_scene(NutmegScene *scene, float delta)
+static void nutmeg_tick_scene(NutmegScene *scene)
 {
-    (void)delta;
+    scene->defer_depth++;
+    /* positions moved since the last tick: the first spatial query rebuilds */
+    nutmeg_atomic_store_u64(&scene->spatial_valid, 0);
 
-    for (size_t e = 0; e < scene->event_count; ++e) {
-        NutmegEvent *event = &scene->events[e];
-        if (event->once && event->triggered) {
+    bool profiling = scene->engine->profiling;
+    bool sampling = scene->engine->adaptive_conditions && scene->sample_clock++ % NUTMEG_CONDITION_SAMPLE_INTERVAL == 0;
+    NutmegTrace *trace = nutmeg_engine_recording_trace(scene->engine);
+    unsigned long long scene_start = trace ? nutmeg_clock_ns() : 0;
+    if (scene->program.dirty) {
+        nutmeg_scene_compile(scene);
+    }
+
+    /* a sample runs the instrumented path, into the profile when it is being recorded */
+    size_t sampled_count = sampling ? scene->event_count : 0;
+    for (size_t e = 0; e < sampled_count; ++e) {
+        NutmegConditionPlan *plan = scene->event_stats[e].plan;
+        if (plan) {
+            nutmeg_condition_sample_begin(plan, nutmeg_event_run_stats(scene, e, profiling, sampling), scene->events[e].condition_count);
+        }
+    }
+
+    const NutmegProgram *program = &scene->program;
+    for (size_t i = 0; i < program->op_count; ++i) {
+        const NutmegOp *op = &program->ops[i];
+        if (op->code == NUTMEG_OP_GUARD) {
+            if (!nutmeg_run_guard(scene, op, profiling, sampling)) {
+                for (size_t g = 1; profiling && g <= op->skip; ++g) {
+                    nutmeg_atomic_fetch_add_u64(&scene->event_stats[op[g].event_index].runs, 1);
+                }
+                i += op->skip;
+            }
+            continue;
+        }
+
+        if (op->fused > 1 && nutmeg_scene_fuses(scene, op, profiling, sampling)) {
+            unsigned long long fused_start = trace ? nutmeg_clock_ns() : 0;
+            unsigned long long triggered = nutmeg_tick_fused(scene, op, op->fused);
+            if (trace) {
+                nutmeg_trace_span(trace, scene->tick_lane, NUTMEG_TRACE_EVENT, op->name, fused_start, 0);
+            }
+            for (size_t k = 0; k < op->fused; ++k) {
+                if (triggered & (1ull << k)) {
+                    nutmeg_scene_event_fired(scene, &op[k]);
+                }
+            }
+            i += op->fused - 1;
             continue;
         }
 
+        unsigned long long event_start = trace ? nutmeg_clock_ns() : 0;
+        NutmegEventStats *stats = nutmeg_event_run_stats(scene, op->event_index, profiling, sampling);
         bool triggered_this_tick = false;
+        if (stats) {
+            unsigned long long start = nutmeg_clock_ns();
+            triggered_this_tick = nutmeg_tick_event(scene, op, stats);
+            nutmeg_atomic_fetch_add_u64(&stats->time_ns, nutmeg_clock_ns() - start);
+            nutmeg_atomic_fetch_add_u64(&stats->runs, 1);
+            nutmeg_atomic_fetch_add_u64(&stats->triggers, triggered_this_tick ? 1 : 0);
+        } else {
+            triggered_this_tick = nutmeg_tick_event(scene, op, NULL);
+        }
 
-        switch (event->scope) {
-            case NUTMEG_EVENT_SCOPE_GLOBAL:
-            case NUTMEG_EVENT_SCOPE_SCENE:
-                if (nutmeg_conditions_pass(scene->engine, scene, NULL, event)) {
-                    nutmeg_execute_actions(scene->engine, scene, NULL, event);
-                    triggered_this_tick = true;
-                }
-                break;
-            case NUTMEG_EVENT_SCOPE_OBJECTS:
-                for (size_t i = 0; i < scene->object_count; ++i) {
-                    NutmegObject *object = scene->objects[i];
-                    if (!object || !object->alive) {
-                        continue;
-                    }
+        if (trace) {
+            nutmeg_trace_span(trace, scene->tick_lane, NUTMEG_TRACE_EVENT, op->name, event_start, 0);
+        }
+        if (triggered_this_tick) {
+            nutmeg_scene_event_fired(scene, op);
+        }
+    }
 
-                    if (nutmeg_conditions_pass(scene->engine, scene, object, event)) {
-                        nutmeg_execute_actions(scene->engine, scene, object, event);
-                        triggered_this_tick = true;
-                    }
-                }
-                break;
+    for (size_t e = 0; e < sampled_count; ++e) {
+        if (scene->event_stats[e].plan) {
+            nutmeg_condition_sample_end(scene, e, nutmeg_event_run_stats(scene, e, profiling, sampling));
+        }
+    }
+
+    /* sync point: structural changes recorded by the events land here */
+    scene->defer_depth--;
+    if (scene->defer_depth == 0) {
+        unsigned long long flush_start = trace ? nutmeg_clock_ns() : 0;
+        nutmeg_scene_flush_commands(scene);
+        nutmeg_atomic_store_u64(&scene->spatial_valid, 0);
+        if (trace) {
+            nutmeg_trace_span(trace, scene->tick_lane, NUTMEG_TRACE_COMMANDS, "flush_commands", flush_start, 0);
+        }
+    }
+
+    if (trace) {
+        nutmeg_trace_span(trace, scene->tick_lane, NUTMEG_TRACE_SCENE, scene->name, scene_start, 0);
+        nutmeg_trace_counter(trace, scene->tick_lane, scene->name, scene->object_count);
+    }
+}
+
+/* Tick one due scene on a worker; its parallel events stay on that worker. */
+static void nutmeg_scene_task(void *context, size_t task_index, unsigned int worker_index)
+{
+    NutmegScene *scene = ((NutmegScene **)context)[task_index];
+    scene->tick_lane = worker_index;
+    scene->tick_nested = true;
+    nutmeg_tick_scene(scene);
+    scene->tick_nested = false;
+    scene->tick_lane = 0;
+}
+
+/* Count a step towards the scene's next tick. Returns true when the scene ticks in it. */
+static bool nutmeg_scene_step_due(NutmegScene *scene, float delta_seconds, bool active)
+{
+    scene->pending_delta += delta_seconds;
+    scene->steps_waited++;
+    if (!active && scene->steps_waited < scene->rate_divider) {
+        return false;
+    }
+
+    scene->last_delta = scene->pending_delta;
+    scene->pending_delta = 0.0f;
+    scene->steps_waited = 0;
+    return true;
+}
+
+/*
+ * Advance the clock and tick the scenes that are due: the active scene on
+ * every step, each other scheduled scene once per rate_divider steps with
+ * the time of all the steps it waited. Only scenes with a rate divider are
+ * in the schedule, so scenes left idle in the background cost nothing here.
+ */
+static void nutmeg_engine_step(NutmegEngine *engine, float delta_seconds)
+{
+    engine->last_delta = delta_seconds;
+    engine->time += delta_seconds;
+
+    /* an active scene without a rate divider is not in the schedule; it goes first among its priority */
+    NutmegScene *active = engine->active_scene;
+    bool place_active = active && active->rate_divider == 0;
+    size_t due_count = 0;
+    for (NutmegScene *scene = engine->schedule; scene; scene = scene->schedule_next) {
+        if (place_active && scene->priority <= active->priority) {
+            nutmeg_scene_step_due(active, delta_seconds, true);
+            engine->due_scenes[due_count++] = active;
+            place_active = false;
         }
+        if (nutmeg_scene_step_due(scene, delta_seconds, scene == active)) {
+            engine->due_scenes[due_count++] = scene;
+        }
+    }
+    if (place_active) {
+        nutmeg_scene_step_due(active, delta_seconds, true);
+        engine->due_scenes[due_count++] = active;
+    }
 
-        if (event->once && triggered_this_tick) {
-            event->triggered = true;
+    engine->stepping = true;
+    if (due_count > 1 && engine->concurrent_scenes && engine->pool) {
+        nutmeg_thread_pool_run(engine->pool, due_count, nutmeg_scene_task, engine->due_scenes);
+    } else {
+        for (size_t i = 0; i < due_count; ++i) {
+            nutmeg_tick_scene(engine->due_scenes[i]);
         }
     }
+    engine->stepping = false;
 }
 
 void nutmeg_engine_tick(NutmegEngine *engine, float delta_seconds)
@@ -550,27 +3959,85 @@ void nutmeg_engine_tick(NutmegEngine *engine, float delta_seconds)
     }
 
     clock_t tick_start = clock();
+    unsigned long long wall_start = nutmeg_clock_ns();
+    /* tick boundary: scenes finished by the loader appear before any scene ticks */
+    nutmeg_engine_publish_loads(engine, false);
+    nutmeg_atomic_store_u64(&engine->memory.guard, (unsigned long long)engine->allocation_guard);
 
-    engine->last_delta = delta_seconds;
-    engine->time += delta_seconds;
+    if (engine->fixed_step > 0.0f) {
+        double step = (double)engine->fixed_step;
+        unsigned int steps = 0;
+        engine->accumulator += (double)delta_seconds;
+        while (engine->accumulator >= step && steps < engine->max_steps) {
+            nutmeg_engine_step(engine, engine->fixed_step);
+            engine->accumulator -= step;
+            steps++;
+        }
+        if (engine->accumulator >= step) {
+            /* too far behind: drop the backlog instead of spiralling */
+            engine->accumulator = fmod(engine->accumulator, step);
+        }
+        engine->interpolation_alpha = (float)(engine->accumulator / step);
+    } else {
+        nutmeg_engine_step(engine, delta_seconds);
+    }
 
-    NutmegScene *scene = engine->active_scene;
-    if (scene) {
-        nutmeg_tick_scene(scene, delta_seconds);
+    NutmegTrace *trace = nutmeg_engine_recording_trace(engine);
+    if (trace) {
+        nutmeg_trace_span(trace, 0, NUTMEG_TRACE_TICK, "nutmeg_engine_tick", wall_start, 0);
+        if (trace->ticks_left > 0 && --trace->ticks_left == 0) {
+            /* window complete: hand the buffers to the writer, nutmeg_engine_trace_stop closes the file */
+            nutmeg_trace_finish(trace);
+        }
     }
+    nutmeg_frame_arena_reset(&engine->frame_arena);
+    nutmeg_atomic_store_u64(&engine->memory.guard, NUTMEG_ALLOCATION_GUARD_OFF);
 
+    unsigned long long wall_ns = nutmeg_clock_ns() - wall_start;
     clock_t tick_end = clock();
     double cpu_time = 0.0;
     if (tick_end != (clock_t)-1 && tick_start != (clock_t)-1 && tick_end >= tick_start) {
         cpu_time = (double)(tick_end - tick_start) / (double)CLOCKS_PER_SEC;
     }
 
-    nutmeg_engine_update_metrics(engine, cpu_time, delta_seconds);
-    if (!scene) {
+    nutmeg_engine_update_metrics(engine, cpu_time, wall_ns, delta_seconds);
+}
+
+void *nutmeg_engine_frame_alloc(NutmegEngine *engine, size_t size, size_t align)
+{
+    if (!engine || size == 0) {
+        return NULL;
+    }
+    if (align == 0) {
+        align = 16;
+    }
+    if (align & (align - 1)) {
+        return NULL;
+    }
+
+    return nutmeg_frame_arena_alloc(&engine->frame_arena, size, align);
+}
+
+void nutmeg_engine_set_fixed_timestep(NutmegEngine *engine, float step_seconds, unsigned int max_steps)
+{
+    if (!engine) {
         return;
     }
 
-    nutmeg_tick_scene(scene, delta_seconds);
+    engine->fixed_step = step_seconds > 0.0f ? step_seconds : 0.0f;
+    engine->max_steps = max_steps > 0 ? max_steps : 1;
+    engine->accumulator = 0.0;
+    engine->interpolation_alpha = 0.0f;
+}
+
+float nutmeg_engine_fixed_timestep(const NutmegEngine *engine)
+{
+    return engine ? engine->fixed_step : 0.0f;
+}
+
+float nutmeg_engine_interpolation_alpha(const NutmegEngine *engine)
+{
+    return engine ? engine->interpolation_alpha : 0.0f;
 }
 
 NutmegObject **nutmeg_scene_objects(NutmegScene *scene, size_t *out_count)
@@ -587,3 +4054,183 @@ NutmegObject **nutmeg_scene_objects(NutmegScene *scene, size_t *out_count)
     }
     return scene->objects;
 }
+
+NutmegObject **nutmeg_scene_objects_named(NutmegScene *scene, NutmegSymbol name, size_t *out_count)
+{
+    if (out_count) {
+        *out_count = 0;
+    }
+    if (!scene || name == NUTMEG_SYMBOL_NONE || name >= scene->name_list_count) {
+        return NULL;
+    }
+
+    NutmegObjectList *list = &scene->name_lists[name];
+    if (out_count) {
+        *out_count = list->count;
+    }
+    return list->objects;
+}
+
+NutmegObject **nutmeg_scene_query_objects(NutmegScene *scene, const NutmegObjectQuery *query, size_t *out_count)
+{
+    if (out_count) {
+        *out_count = 0;
+    }
+    if (!scene || !query) {
+        return NULL;
+    }
+
+    NutmegObject **members = NULL;
+    size_t member_count = 0;
+    if (!nutmeg_scene_query_members(scene, query, &members, &member_count)) {
+        return nutmeg_scene_objects(scene, out_count);
+    }
+
+    if (out_count) {
+        *out_count = member_count;
+    }
+    return members;
+}
+
+void nutmeg_scene_set_spatial_cell_size(NutmegScene *scene, float cell_size)
+{
+    if (!scene || !(cell_size > 0.0f)) {
+        return;
+    }
+
+    nutmeg_mutex_lock(&scene->spatial_lock);
+    nutmeg_spatial_hash_set_cell_size(&scene->spatial, cell_size);
+    nutmeg_atomic_store_u64(&scene->spatial_valid, 0);
+    nutmeg_mutex_unlock(&scene->spatial_lock);
+}
+
+/* Rebuild the spatial index from the live objects unless it is still current. */
+static void nutmeg_scene_update_spatial(NutmegScene *scene)
+{
+    if (nutmeg_atomic_load_u64(&scene->spatial_valid)) {
+        return;
+    }
+
+    nutmeg_mutex_lock(&scene->spatial_lock);
+    if (!nutmeg_atomic_load_u64(&scene->spatial_valid)) {
+        NutmegSpatialHash *hash = &scene->spatial;
+        bool ok = true;
+        nutmeg_spatial_hash_begin(hash);
+        for (size_t c = 0; c < scene->chunk_count && ok; ++c) {
+            NutmegObjectChunk *chunk = scene->chunks[c];
+            for (size_t i = 0; i < chunk->high_water && ok; ++i) {
+                if (nutmeg_atomic_load_u8(&chunk->alive[i])) {
+                    ok = nutmeg_spatial_hash_push(hash, chunk->base + i, chunk->positions[i], chunk->radii[i]);
+                }
+            }
+        }
+        if (!ok || !nutmeg_spatial_hash_build(hash)) {
+            /* allocation failure is fatal */
+            abort();
+        }
+        nutmeg_atomic_store_u64(&scene->spatial_valid, 1);
+    }
+    nutmeg_mutex_unlock(&scene->spatial_lock);
+}
+
+typedef struct NutmegSpatialQuery {
+    NutmegScene *scene;
+    NutmegVec2 center;
+    float radius;
+    bool overlap; /**< Add each entry's radius to the search radius. */
+    const NutmegObjectQuery *filter;
+    const NutmegObject *exclude;
+    NutmegObjectVisitFn fn;
+    void *userdata;
+    size_t visited;
+} NutmegSpatialQuery;
+
+/* Object of an index entry, or NULL if it died since the rebuild or is filtered out. */
+static NutmegObject *nutmeg_spatial_query_object(const NutmegSpatialQuery *query, const NutmegSpatialEntry *entry)
+{
+    NutmegObject *object = nutmeg_scene_object_at(query->scene, entry->slot);
+    if (!nutmeg_atomic_load_u8(&object->chunk->alive[object->index]) || object == query->exclude) {
+        return NULL;
+    }
+    if (query->filter && !nutmeg_query_matches(query->filter, object)) {
+        return NULL;
+    }
+    return object;
+}
+
+static bool nutmeg_spatial_query_visit(const NutmegSpatialEntry *entry, void *context)
+{
+    NutmegSpatialQuery *query = (NutmegSpatialQuery *)context;
+    float dx = entry->position.x - query->center.x;
+    float dy = entry->position.y - query->center.y;
+    float reach = query->radius + (query->overlap ? entry->radius : 0.0f);
+    if (dx * dx + dy * dy > reach * reach) {
+        return true;
+    }
+
+    NutmegObject *object = nutmeg_spatial_query_object(query, entry);
+    if (!object) {
+        return true;
+    }
+    query->visited++;
+    return !query->fn || query->fn(object, query->userdata);
+}
+
+static bool nutmeg_spatial_query_accept(const NutmegSpatialEntry *entry, void *context)
+{
+    return nutmeg_spatial_query_object((const NutmegSpatialQuery *)context, entry) != NULL;
+}
+
+static size_t nutmeg_scene_query_circle(NutmegScene *scene, NutmegVec2 center, float radius, bool overlap, const NutmegObjectQuery *filter, NutmegObjectVisitFn fn, void *userdata)
+{
+    if (!scene || !(radius >= 0.0f)) {
+        return 0;
+    }
+
+    nutmeg_scene_update_spatial(scene);
+
+    NutmegSpatialQuery query;
+    query.scene = scene;
+    query.center = center;
+    query.radius = radius;
+    query.overlap = overlap;
+    query.filter = filter;
+    query.exclude = NULL;
+    query.fn = fn;
+    query.userdata = userdata;
+    query.visited = 0;
+
+    float reach = radius + (overlap ? scene->spatial.max_radius : 0.0f);
+    NutmegVec2 min = {center.x - reach, center.y - reach};
+    NutmegVec2 max = {center.x + reach, center.y + reach};
+    nutmeg_spatial_hash_visit(&scene->spatial, min, max, nutmeg_spatial_query_visit, &query);
+    return query.visited;
+}
+
+size_t nutmeg_scene_query_radius(NutmegScene *scene, NutmegVec2 center, float radius, const NutmegObjectQuery *filter, NutmegObjectVisitFn fn, void *userdata)
+{
+    return nutmeg_scene_query_circle(scene, center, radius, false, filter, fn, userdata);
+}
+
+size_t nutmeg_scene_query_overlap(NutmegScene *scene, NutmegVec2 center, float radius, const NutmegObjectQuery *filter, NutmegObjectVisitFn fn, void *userdata)
+{
+    return nutmeg_scene_query_circle(scene, center, radius, true, filter, fn, userdata);
+}
+
+NutmegObject *nutmeg_scene_nearest_object(NutmegScene *scene, NutmegVec2 point, float max_distance, const NutmegObjectQuery *filter, const NutmegObject *exclude)
+{
+    if (!scene) {
+        return NULL;
+    }
+
+    nutmeg_scene_update_spatial(scene);
+
+    NutmegSpatialQuery query;
+    memset(&query, 0, sizeof(query));
+    query.scene = scene;
+    query.filter = filter;
+    query.exclude = exclude;
+
+    const NutmegSpatialEntry *entry = nutmeg_spatial_hash_nearest(&scene->spatial, point, max_distance, nutmeg_spatial_query_accept, &query);
+    return entry ? nutmeg_scene_object_at(scene, entry->slot) : NULL;
+}
@@ -0,0 +1,124 @@
+#include "frame_arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/* Page data starts after the header, rounded up so small alignments never need padding. */
+#define NUTMEG_FRAME_HEADER_SIZE ((sizeof(NutmegFramePage) + 15) & ~(size_t)15)
+
+static unsigned char *nutmeg_frame_page_data(NutmegFramePage *page)
+{
+    return (unsigned char *)page + NUTMEG_FRAME_HEADER_SIZE;
+}
+
+bool nutmeg_frame_arena_init(NutmegFrameArena *arena, NutmegMemoryAccount *account)
+{
+    memset((void *)arena, 0, sizeof(*arena));
+    arena->account = account;
+    return nutmeg_mutex_init(&arena->lock);
+}
+
+void nutmeg_frame_arena_free(NutmegFrameArena *arena)
+{
+    NutmegFramePage *page = arena->pages;
+    while (page) {
+        NutmegFramePage *next = page->next;
+        nutmeg_memory_free(arena->account, NUTMEG_MEMORY_FRAME, page, NUTMEG_FRAME_HEADER_SIZE + page->size);
+        page = next;
+    }
+    nutmeg_mutex_destroy(&arena->lock);
+    memset((void *)arena, 0, sizeof(*arena));
+}
+
+/* Bump page by size bytes at align, or return NULL when it does not fit. */
+static void *nutmeg_frame_page_bump(NutmegFramePage *page, size_t size, size_t align)
+{
+    uintptr_t base = (uintptr_t)nutmeg_frame_page_data(page);
+    for (;;) {
+        unsigned long long used = nutmeg_atomic_load_u64(&page->used);
+        uintptr_t start = (base + (uintptr_t)used + (align - 1)) & ~(uintptr_t)(align - 1);
+        size_t end = (size_t)(start - base) + size;
+        if (end > page->size) {
+            return NULL;
+        }
+        if (nutmeg_atomic_cas_u64(&page->used, used, (unsigned long long)end)) {
+            return (void *)start;
+        }
+    }
+}
+
+/*
+ * Move past a full page: reuse the next page kept from earlier ticks or
+ * append a new one big enough for the request. Returns false when a page
+ * cannot be allocated.
+ */
+static bool nutmeg_frame_arena_advance(NutmegFrameArena *arena, NutmegFramePage *full, size_t size, size_t align)
+{
+    nutmeg_mutex_lock(&arena->lock);
+    if ((NutmegFramePage *)(uintptr_t)nutmeg_atomic_load_u64(&arena->current) != full) {
+        /* another thread already moved on */
+        nutmeg_mutex_unlock(&arena->lock);
+        return true;
+    }
+
+    NutmegFramePage *next = full ? full->next : arena->pages;
+    if (!next) {
+        size_t page_size = NUTMEG_FRAME_PAGE_SIZE - NUTMEG_FRAME_HEADER_SIZE;
+        if (size + align > page_size) {
+            page_size = size + align;
+        }
+        next = (NutmegFramePage *)nutmeg_memory_alloc(arena->account, NUTMEG_MEMORY_FRAME, NUTMEG_FRAME_HEADER_SIZE + page_size);
+        if (!next) {
+            nutmeg_mutex_unlock(&arena->lock);
+            return false;
+        }
+        next->size = page_size;
+        if (full) {
+            full->next = next;
+        } else {
+            arena->pages = next;
+        }
+        arena->capacity += page_size;
+    }
+    nutmeg_atomic_store_u64(&arena->current, (unsigned long long)(uintptr_t)next);
+    nutmeg_mutex_unlock(&arena->lock);
+    return true;
+}
+
+void *nutmeg_frame_arena_alloc(NutmegFrameArena *arena, size_t size, size_t align)
+{
+    for (;;) {
+        NutmegFramePage *page = (NutmegFramePage *)(uintptr_t)nutmeg_atomic_load_u64(&arena->current);
+        if (page) {
+            void *ptr = nutmeg_frame_page_bump(page, size, align);
+            if (ptr) {
+                return ptr;
+            }
+        }
+        if (!nutmeg_frame_arena_advance(arena, page, size, align)) {
+            return NULL;
+        }
+    }
+}
+
+void nutmeg_frame_arena_reset(NutmegFrameArena *arena)
+{
+    NutmegFramePage *current = (NutmegFramePage *)(uintptr_t)nutmeg_atomic_load_u64(&arena->current);
+    if (!current) {
+        return;
+    }
+
+    /* pages before current were filled as far as they would go; count what was handed out */
+    size_t used = 0;
+    for (NutmegFramePage *page = arena->pages; page; page = page->next) {
+        used += (size_t)nutmeg_atomic_load_u64(&page->used);
+        nutmeg_atomic_store_u64(&page->used, 0);
+        if (page == current) {
+            break;
+        }
+    }
+    if (used > arena->high_water) {
+        arena->high_water = used;
+    }
+    nutmeg_atomic_store_u64(&arena->current, (unsigned long long)(uintptr_t)arena->pages);
+}
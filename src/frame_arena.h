@@ -0,0 +1,40 @@
+#ifndef NUTMEG_FRAME_ARENA_H
+#define NUTMEG_FRAME_ARENA_H
+
+#include "memory.h"
+#include "platform.h"
+
+/*
+ * Bump-pointer arena for scratch memory that only lives until the end of
+ * the current tick. Pages are kept across resets, so once the arena has
+ * grown to a tick's working set it stops reaching the allocator. Callers on
+ * several worker threads bump the current page with a CAS; only moving to
+ * the next page takes the lock.
+ */
+#define NUTMEG_FRAME_PAGE_SIZE (64 * 1024)
+
+typedef struct NutmegFramePage {
+    struct NutmegFramePage *next;
+    size_t size;          /**< Usable bytes after the header. */
+    NutmegAtomicU64 used; /**< Bytes handed out this tick, including alignment padding. */
+} NutmegFramePage;
+
+typedef struct NutmegFrameArena {
+    NutmegMemoryAccount *account;
+    NutmegFramePage *pages;  /**< Every page, in the order they are filled. */
+    NutmegAtomicU64 current; /**< Page being bumped, as an address; 0 before the first allocation. */
+    NutmegMutex lock;        /**< Serialises moving to the next page. */
+    size_t capacity;         /**< Usable bytes over all pages. */
+    size_t high_water;       /**< Most bytes one tick has used. */
+} NutmegFrameArena;
+
+bool nutmeg_frame_arena_init(NutmegFrameArena *arena, NutmegMemoryAccount *account);
+void nutmeg_frame_arena_free(NutmegFrameArena *arena);
+
+/** Allocate size bytes aligned to align (a power of two). Returns NULL when a new page cannot be allocated. */
+void *nutmeg_frame_arena_alloc(NutmegFrameArena *arena, size_t size, size_t align);
+
+/** Release everything allocated since the last reset and update the high-water mark. No allocation may be in flight. */
+void nutmeg_frame_arena_reset(NutmegFrameArena *arena);
+
+#endif /* NUTMEG_FRAME_ARENA_H */
@@ -0,0 +1,194 @@
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void *nutmeg_default_alloc(void *context, size_t size)
+{
+    (void)context;
+    return malloc(size);
+}
+
+static void *nutmeg_default_realloc(void *context, void *ptr, size_t old_size, size_t new_size)
+{
+    (void)context;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void nutmeg_default_free(void *context, void *ptr, size_t size)
+{
+    (void)context;
+    (void)size;
+    free(ptr);
+}
+
+const NutmegAllocator nutmeg_default_allocator = {nutmeg_default_alloc, nutmeg_default_realloc, nutmeg_default_free, NULL};
+
+bool nutmeg_allocator_is_valid(const NutmegAllocator *allocator)
+{
+    return allocator && allocator->alloc && allocator->free;
+}
+
+void *nutmeg_allocator_alloc(const NutmegAllocator *allocator, size_t size)
+{
+    return size > 0 ? allocator->alloc(allocator->context, size) : NULL;
+}
+
+void nutmeg_allocator_free(const NutmegAllocator *allocator, void *ptr, size_t size)
+{
+    if (ptr) {
+        allocator->free(allocator->context, ptr, size);
+    }
+}
+
+static void *nutmeg_allocator_realloc(const NutmegAllocator *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+    if (!ptr) {
+        return nutmeg_allocator_alloc(allocator, new_size);
+    }
+    if (new_size == 0) {
+        nutmeg_allocator_free(allocator, ptr, old_size);
+        return NULL;
+    }
+    if (allocator->realloc) {
+        return allocator->realloc(allocator->context, ptr, old_size, new_size);
+    }
+
+    void *moved = allocator->alloc(allocator->context, new_size);
+    if (moved) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+        allocator->free(allocator->context, ptr, old_size);
+    }
+    return moved;
+}
+
+void nutmeg_memory_account_init(NutmegMemoryAccount *account, NutmegMemoryAccount *parent, const NutmegAllocator *allocator)
+{
+    memset((void *)account, 0, sizeof(*account));
+    account->parent = parent;
+    if (!allocator) {
+        allocator = parent ? parent->allocator : &nutmeg_default_allocator;
+    }
+    account->allocator = allocator;
+}
+
+static void nutmeg_memory_raise_peak(NutmegAtomicU64 *peak, unsigned long long value)
+{
+    unsigned long long current = nutmeg_atomic_load_u64(peak);
+    while (value > current && !nutmeg_atomic_cas_u64(peak, current, value)) {
+        current = nutmeg_atomic_load_u64(peak);
+    }
+}
+
+void nutmeg_memory_charge(NutmegMemoryAccount *account, NutmegMemoryCategory category, size_t bytes)
+{
+    if (bytes == 0) {
+        return;
+    }
+
+    for (; account; account = account->parent) {
+        unsigned long long live = nutmeg_atomic_fetch_add_u64(&account->live[category], bytes) + bytes;
+        nutmeg_memory_raise_peak(&account->peak[category], live);
+        unsigned long long total = nutmeg_atomic_fetch_add_u64(&account->total_live, bytes) + bytes;
+        nutmeg_memory_raise_peak(&account->total_peak, total);
+    }
+}
+
+void nutmeg_memory_account_attach(NutmegMemoryAccount *account, NutmegMemoryAccount *parent)
+{
+    account->parent = parent;
+    unsigned long long allocations = nutmeg_atomic_load_u64(&account->allocations);
+    for (NutmegMemoryAccount *ancestor = parent; ancestor; ancestor = ancestor->parent) {
+        nutmeg_atomic_fetch_add_u64(&ancestor->allocations, allocations);
+    }
+    for (int category = 0; category < NUTMEG_MEMORY_CATEGORY_COUNT; ++category) {
+        nutmeg_memory_charge(parent, (NutmegMemoryCategory)category, (size_t)nutmeg_atomic_load_u64(&account->live[category]));
+    }
+}
+
+void nutmeg_memory_release(NutmegMemoryAccount *account, NutmegMemoryCategory category, size_t bytes)
+{
+    if (bytes == 0) {
+        return;
+    }
+
+    unsigned long long amount = 0ULL - (unsigned long long)bytes;
+    for (; account; account = account->parent) {
+        nutmeg_atomic_fetch_add_u64(&account->live[category], amount);
+        nutmeg_atomic_fetch_add_u64(&account->total_live, amount);
+    }
+}
+
+void nutmeg_memory_count_allocation(NutmegMemoryAccount *account)
+{
+    NutmegMemoryAccount *root = NULL;
+    for (; account; account = account->parent) {
+        nutmeg_atomic_fetch_add_u64(&account->allocations, 1);
+        root = account;
+    }
+    if (!root) {
+        return;
+    }
+
+    unsigned long long guard = nutmeg_atomic_load_u64(&root->guard);
+    if (guard == NUTMEG_ALLOCATION_GUARD_ABORT) {
+        /* the steady-state tick was promised to be allocation free */
+        abort();
+    }
+    if (guard == NUTMEG_ALLOCATION_GUARD_COUNT) {
+        nutmeg_atomic_fetch_add_u64(&root->guarded_allocations, 1);
+    }
+}
+
+static const NutmegAllocator *nutmeg_memory_allocator(const NutmegMemoryAccount *account)
+{
+    return account ? account->allocator : &nutmeg_default_allocator;
+}
+
+void *nutmeg_memory_alloc(NutmegMemoryAccount *account, NutmegMemoryCategory category, size_t size)
+{
+    nutmeg_memory_count_allocation(account);
+    void *ptr = nutmeg_allocator_alloc(nutmeg_memory_allocator(account), size);
+    if (ptr) {
+        memset(ptr, 0, size);
+        nutmeg_memory_charge(account, category, size);
+    }
+    return ptr;
+}
+
+void *nutmeg_memory_realloc(NutmegMemoryAccount *account, NutmegMemoryCategory category, void *ptr, size_t old_size, size_t new_size)
+{
+    nutmeg_memory_count_allocation(account);
+    void *resized = nutmeg_allocator_realloc(nutmeg_memory_allocator(account), ptr, old_size, new_size);
+    if (!resized) {
+        return NULL;
+    }
+
+    if (new_size > old_size) {
+        nutmeg_memory_charge(account, category, new_size - old_size);
+    } else {
+        nutmeg_memory_release(account, category, old_size - new_size);
+    }
+    return resized;
+}
+
+void nutmeg_memory_free(NutmegMemoryAccount *account, NutmegMemoryCategory category, void *ptr, size_t size)
+{
+    if (!ptr) {
+        return;
+    }
+    nutmeg_allocator_free(nutmeg_memory_allocator(account), ptr, size);
+    nutmeg_memory_release(account, category, size);
+}
+
+void nutmeg_memory_read(NutmegMemoryAccount *account, NutmegMemoryStats *out_stats)
+{
+    for (int c = 0; c < NUTMEG_MEMORY_CATEGORY_COUNT; ++c) {
+        out_stats->live_bytes[c] = (size_t)nutmeg_atomic_load_u64(&account->live[c]);
+        out_stats->peak_bytes[c] = (size_t)nutmeg_atomic_load_u64(&account->peak[c]);
+    }
+    out_stats->total_live_bytes = (size_t)nutmeg_atomic_load_u64(&account->total_live);
+    out_stats->total_peak_bytes = (size_t)nutmeg_atomic_load_u64(&account->total_peak);
+    out_stats->allocations = nutmeg_atomic_load_u64(&account->allocations);
+}
@@ -0,0 +1,66 @@
+#ifndef NUTMEG_MEMORY_H
+#define NUTMEG_MEMORY_H
+
+#include "nutmeg_engine.h"
+#include "platform.h"
+
+/**
+ * Allocation accounting. Every engine allocation is charged to an account
+ * (a scene, or the engine for engine-wide data) under a category. Accounts
+ * form a chain: charges propagate to the parent so the engine account always
+ * holds the totals of all its scenes. Counters are atomic because scenes may
+ * allocate from worker threads. The memory itself comes from the account's
+ * allocator, inherited from the parent.
+ */
+typedef struct NutmegMemoryAccount {
+    struct NutmegMemoryAccount *parent;
+    const NutmegAllocator *allocator;
+    NutmegAtomicU64 live[NUTMEG_MEMORY_CATEGORY_COUNT];
+    NutmegAtomicU64 peak[NUTMEG_MEMORY_CATEGORY_COUNT];
+    NutmegAtomicU64 total_live;
+    NutmegAtomicU64 total_peak;
+    NutmegAtomicU64 allocations;
+    NutmegAtomicU64 guard;             /**< Root only: NutmegAllocationGuard in force right now. */
+    NutmegAtomicU64 guarded_allocations;
+} NutmegMemoryAccount;
+
+/** malloc/realloc/free, used when an engine is created without an allocator. */
+extern const NutmegAllocator nutmeg_default_allocator;
+
+/** Returns true when the hooks can be used. */
+bool nutmeg_allocator_is_valid(const NutmegAllocator *allocator);
+
+/** Raw allocator calls for memory that cannot be charged yet, such as the block holding an account. */
+void *nutmeg_allocator_alloc(const NutmegAllocator *allocator, size_t size);
+void nutmeg_allocator_free(const NutmegAllocator *allocator, void *ptr, size_t size);
+
+/** Initialise an account. A NULL allocator inherits the parent's, or the default one for a root. */
+void nutmeg_memory_account_init(NutmegMemoryAccount *account, NutmegMemoryAccount *parent, const NutmegAllocator *allocator);
+
+/**
+ * Give a root account a parent, charging the parent chain with the bytes and
+ * allocation calls the account has made so far. Lets memory built up off the
+ * ticking thread escape the parent's guard until it is handed over.
+ */
+void nutmeg_memory_account_attach(NutmegMemoryAccount *account, NutmegMemoryAccount *parent);
+
+/** Count an allocation call against the account chain and apply the root's guard. */
+void nutmeg_memory_count_allocation(NutmegMemoryAccount *account);
+
+/** Record bytes allocated or freed outside the helpers below. */
+void nutmeg_memory_charge(NutmegMemoryAccount *account, NutmegMemoryCategory category, size_t bytes);
+void nutmeg_memory_release(NutmegMemoryAccount *account, NutmegMemoryCategory category, size_t bytes);
+
+/*
+ * Accounted allocation helpers. Memory from nutmeg_memory_alloc is zeroed.
+ * A NULL account uses the default allocator without charging anything. They
+ * return NULL on failure and leave the original block untouched.
+ */
+void *nutmeg_memory_alloc(NutmegMemoryAccount *account, NutmegMemoryCategory category, size_t size);
+void *nutmeg_memory_realloc(NutmegMemoryAccount *account, NutmegMemoryCategory category, void *ptr, size_t old_size, size_t new_size);
+void nutmeg_memory_free(NutmegMemoryAccount *account, NutmegMemoryCategory category, void *ptr, size_t size);
+
+/** Snapshot the counters of an account. */
+void nutmeg_memory_read(NutmegMemoryAccount *account, NutmegMemoryStats *out_stats);
+
+#endif /* NUTMEG_MEMORY_H */
@@ -0,0 +1,305 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "platform.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#include <stdint.h>
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct NutmegThreadStart {
+    NutmegThreadFn fn;
+    void *arg;
+} NutmegThreadStart;
+
+#if defined(_WIN32)
+
+static unsigned __stdcall nutmeg_thread_trampoline(void *arg)
+{
+    NutmegThreadStart start = *(NutmegThreadStart *)arg;
+    free(arg);
+    start.fn(start.arg);
+    return 0;
+}
+
+bool nutmeg_thread_start(NutmegThread *thread, NutmegThreadFn fn, void *arg)
+{
+    NutmegThreadStart *start = (NutmegThreadStart *)malloc(sizeof(*start));
+    if (!start) {
+        return false;
+    }
+
+    start->fn = fn;
+    start->arg = arg;
+    uintptr_t handle = _beginthreadex(NULL, 0, nutmeg_thread_trampoline, start, 0, NULL);
+    if (handle == 0) {
+        free(start);
+        return false;
+    }
+
+    *thread = (HANDLE)handle;
+    return true;
+}
+
+void nutmeg_thread_join(NutmegThread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void nutmeg_thread_yield(void)
+{
+    SwitchToThread();
+}
+
+unsigned int nutmeg_hardware_concurrency(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1u;
+}
+
+unsigned long long nutmeg_clock_ns(void)
+{
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    /* split to avoid overflowing counter * 1e9 */
+    unsigned long long ticks = (unsigned long long)counter.QuadPart;
+    unsigned long long hz = (unsigned long long)frequency.QuadPart;
+    return (ticks / hz) * 1000000000ULL + (ticks % hz) * 1000000000ULL / hz;
+}
+
+bool nutmeg_mutex_init(NutmegMutex *mutex)
+{
+    InitializeCriticalSection(mutex);
+    return true;
+}
+
+void nutmeg_mutex_destroy(NutmegMutex *mutex)
+{
+    DeleteCriticalSection(mutex);
+}
+
+void nutmeg_mutex_lock(NutmegMutex *mutex)
+{
+    EnterCriticalSection(mutex);
+}
+
+void nutmeg_mutex_unlock(NutmegMutex *mutex)
+{
+    LeaveCriticalSection(mutex);
+}
+
+bool nutmeg_cond_init(NutmegCond *cond)
+{
+    InitializeConditionVariable(cond);
+    return true;
+}
+
+void nutmeg_cond_destroy(NutmegCond *cond)
+{
+    (void)cond;
+}
+
+void nutmeg_cond_wait(NutmegCond *cond, NutmegMutex *mutex)
+{
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+void nutmeg_cond_signal(NutmegCond *cond)
+{
+    WakeConditionVariable(cond);
+}
+
+void nutmeg_cond_broadcast(NutmegCond *cond)
+{
+    WakeAllConditionVariable(cond);
+}
+
+bool nutmeg_file_map(NutmegFileMap *map, const char *path)
+{
+    map->data = NULL;
+    map->size = 0;
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(map->file, &size) || size.QuadPart <= 0 || (unsigned long long)size.QuadPart > (size_t)-1) {
+        CloseHandle(map->file);
+        return false;
+    }
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!map->mapping) {
+        CloseHandle(map->file);
+        return false;
+    }
+    map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!map->data) {
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return false;
+    }
+    map->size = (size_t)size.QuadPart;
+    return true;
+}
+
+void nutmeg_file_unmap(NutmegFileMap *map)
+{
+    if (!map->data) {
+        return;
+    }
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+    map->data = NULL;
+    map->size = 0;
+}
+
+#else
+
+static void *nutmeg_thread_trampoline(void *arg)
+{
+    NutmegThreadStart start = *(NutmegThreadStart *)arg;
+    free(arg);
+    start.fn(start.arg);
+    return NULL;
+}
+
+bool nutmeg_thread_start(NutmegThread *thread, NutmegThreadFn fn, void *arg)
+{
+    NutmegThreadStart *start = (NutmegThreadStart *)malloc(sizeof(*start));
+    if (!start) {
+        return false;
+    }
+
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, nutmeg_thread_trampoline, start) != 0) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void nutmeg_thread_join(NutmegThread thread)
+{
+    pthread_join(thread, NULL);
+}
+
+void nutmeg_thread_yield(void)
+{
+    sched_yield();
+}
+
+unsigned int nutmeg_hardware_concurrency(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1u;
+}
+
+unsigned long long nutmeg_clock_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+bool nutmeg_mutex_init(NutmegMutex *mutex)
+{
+    return pthread_mutex_init(mutex, NULL) == 0;
+}
+
+void nutmeg_mutex_destroy(NutmegMutex *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+
+void nutmeg_mutex_lock(NutmegMutex *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+void nutmeg_mutex_unlock(NutmegMutex *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+bool nutmeg_cond_init(NutmegCond *cond)
+{
+    return pthread_cond_init(cond, NULL) == 0;
+}
+
+void nutmeg_cond_destroy(NutmegCond *cond)
+{
+    pthread_cond_destroy(cond);
+}
+
+void nutmeg_cond_wait(NutmegCond *cond, NutmegMutex *mutex)
+{
+    pthread_cond_wait(cond, mutex);
+}
+
+void nutmeg_cond_signal(NutmegCond *cond)
+{
+    pthread_cond_signal(cond);
+}
+
+void nutmeg_cond_broadcast(NutmegCond *cond)
+{
+    pthread_cond_broadcast(cond);
+}
+
+bool nutmeg_file_map(NutmegFileMap *map, const char *path)
+{
+    map->data = NULL;
+    map->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* the mapping keeps the file referenced */
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    map->data = data;
+    map->size = (size_t)info.st_size;
+    return true;
+}
+
+void nutmeg_file_unmap(NutmegFileMap *map)
+{
+    if (!map->data) {
+        return;
+    }
+    munmap((void *)map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
+
+#endif
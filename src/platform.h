@@ -0,0 +1,140 @@
+#ifndef NUTMEG_PLATFORM_H
+#define NUTMEG_PLATFORM_H
+
+/*
+ * Internal portability layer: threads, locks and the handful of atomic
+ * operations the runtime needs. The engine targets C99, which has no
+ * standard threading or atomics, so these wrap pthreads/Win32 and the
+ * compiler intrinsics directly.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <intrin.h>
+typedef HANDLE NutmegThread;
+typedef CRITICAL_SECTION NutmegMutex;
+typedef CONDITION_VARIABLE NutmegCond;
+#else
+#include <pthread.h>
+typedef pthread_t NutmegThread;
+typedef pthread_mutex_t NutmegMutex;
+typedef pthread_cond_t NutmegCond;
+#endif
+
+typedef void (*NutmegThreadFn)(void *arg);
+
+/** Start a thread running fn(arg). Returns false when the thread could not be created. */
+bool nutmeg_thread_start(NutmegThread *thread, NutmegThreadFn fn, void *arg);
+void nutmeg_thread_join(NutmegThread thread);
+void nutmeg_thread_yield(void);
+
+/** Number of hardware threads available to the process (at least 1). */
+unsigned int nutmeg_hardware_concurrency(void);
+
+/** Monotonic wall clock in nanoseconds, for measuring intervals only. */
+unsigned long long nutmeg_clock_ns(void);
+
+bool nutmeg_mutex_init(NutmegMutex *mutex);
+void nutmeg_mutex_destroy(NutmegMutex *mutex);
+void nutmeg_mutex_lock(NutmegMutex *mutex);
+void nutmeg_mutex_unlock(NutmegMutex *mutex);
+
+bool nutmeg_cond_init(NutmegCond *cond);
+void nutmeg_cond_destroy(NutmegCond *cond);
+void nutmeg_cond_wait(NutmegCond *cond, NutmegMutex *mutex);
+void nutmeg_cond_signal(NutmegCond *cond);
+void nutmeg_cond_broadcast(NutmegCond *cond);
+
+/** Read-only view of a whole file mapped into memory. */
+typedef struct NutmegFileMap {
+    const void *data;
+    size_t size;
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} NutmegFileMap;
+
+/** Map path read-only. Returns false when it cannot be opened or is empty. */
+bool nutmeg_file_map(NutmegFileMap *map, const char *path);
+void nutmeg_file_unmap(NutmegFileMap *map);
+
+/** 64-bit word accessed with the nutmeg_atomic_* helpers. */
+typedef volatile unsigned long long NutmegAtomicU64;
+
+/** Byte flag accessed with nutmeg_atomic_load_u8/store_u8. */
+typedef volatile unsigned char NutmegAtomicU8;
+
+#if defined(_MSC_VER)
+
+static __inline unsigned long long nutmeg_atomic_load_u64(NutmegAtomicU64 *value)
+{
+    return (unsigned long long)_InterlockedOr64((volatile long long *)value, 0);
+}
+
+static __inline void nutmeg_atomic_store_u64(NutmegAtomicU64 *value, unsigned long long desired)
+{
+    _InterlockedExchange64((volatile long long *)value, (long long)desired);
+}
+
+static __inline unsigned long long nutmeg_atomic_fetch_add_u64(NutmegAtomicU64 *value, unsigned long long amount)
+{
+    return (unsigned long long)_InterlockedExchangeAdd64((volatile long long *)value, (long long)amount);
+}
+
+static __inline bool nutmeg_atomic_cas_u64(NutmegAtomicU64 *value, unsigned long long expected, unsigned long long desired)
+{
+    return (unsigned long long)_InterlockedCompareExchange64((volatile long long *)value, (long long)desired, (long long)expected) == expected;
+}
+
+static __inline unsigned char nutmeg_atomic_load_u8(const NutmegAtomicU8 *value)
+{
+    return (unsigned char)_InterlockedOr8((volatile char *)value, 0);
+}
+
+static __inline void nutmeg_atomic_store_u8(NutmegAtomicU8 *value, unsigned char desired)
+{
+    _InterlockedExchange8((volatile char *)value, (char)desired);
+}
+
+#else
+
+static inline unsigned long long nutmeg_atomic_load_u64(NutmegAtomicU64 *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static inline void nutmeg_atomic_store_u64(NutmegAtomicU64 *value, unsigned long long desired)
+{
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+static inline unsigned long long nutmeg_atomic_fetch_add_u64(NutmegAtomicU64 *value, unsigned long long amount)
+{
+    return __atomic_fetch_add(value, amount, __ATOMIC_ACQ_REL);
+}
+
+static inline bool nutmeg_atomic_cas_u64(NutmegAtomicU64 *value, unsigned long long expected, unsigned long long desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline unsigned char nutmeg_atomic_load_u8(const NutmegAtomicU8 *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static inline void nutmeg_atomic_store_u8(NutmegAtomicU8 *value, unsigned char desired)
+{
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+#endif
+
+#endif /* NUTMEG_PLATFORM_H */
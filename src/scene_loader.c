@@ -0,0 +1,158 @@
+#include "scene_loader.h"
+
+#include <string.h>
+
+static void nutmeg_scene_loader_append(NutmegSceneLoad **head, NutmegSceneLoad **tail, NutmegSceneLoad *load)
+{
+    load->next = NULL;
+    if (*tail) {
+        (*tail)->next = load;
+    } else {
+        *head = load;
+    }
+    *tail = load;
+}
+
+static void nutmeg_scene_loader_main(void *arg)
+{
+    NutmegSceneLoader *loader = (NutmegSceneLoader *)arg;
+    nutmeg_mutex_lock(&loader->lock);
+    for (;;) {
+        while (!loader->queue_head && !loader->stopping) {
+            nutmeg_cond_wait(&loader->wake, &loader->lock);
+        }
+        if (loader->stopping) {
+            break;
+        }
+
+        NutmegSceneLoad *load = loader->queue_head;
+        loader->queue_head = load->next;
+        if (!loader->queue_head) {
+            loader->queue_tail = NULL;
+        }
+        loader->building = load;
+        nutmeg_mutex_unlock(&loader->lock);
+
+        /* the scene is not registered yet, so nothing else can reach it */
+        load->built = load->build(loader->engine, load->scene, load->userdata);
+
+        nutmeg_mutex_lock(&loader->lock);
+        loader->building = NULL;
+        nutmeg_scene_loader_append(&loader->ready_head, &loader->ready_tail, load);
+        nutmeg_atomic_fetch_add_u64(&loader->ready_count, 1);
+        nutmeg_cond_broadcast(&loader->built);
+    }
+    nutmeg_mutex_unlock(&loader->lock);
+}
+
+NutmegSceneLoader *nutmeg_scene_loader_create(NutmegMemoryAccount *account, NutmegEngine *engine)
+{
+    NutmegSceneLoader *loader = (NutmegSceneLoader *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, sizeof(*loader));
+    if (!loader) {
+        return NULL;
+    }
+    loader->account = account;
+    loader->engine = engine;
+
+    if (!nutmeg_mutex_init(&loader->lock)) {
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, loader, sizeof(*loader));
+        return NULL;
+    }
+    if (!nutmeg_cond_init(&loader->wake)) {
+        nutmeg_mutex_destroy(&loader->lock);
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, loader, sizeof(*loader));
+        return NULL;
+    }
+    if (!nutmeg_cond_init(&loader->built)) {
+        nutmeg_cond_destroy(&loader->wake);
+        nutmeg_mutex_destroy(&loader->lock);
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, loader, sizeof(*loader));
+        return NULL;
+    }
+    if (!nutmeg_thread_start(&loader->thread, nutmeg_scene_loader_main, loader)) {
+        nutmeg_cond_destroy(&loader->built);
+        nutmeg_cond_destroy(&loader->wake);
+        nutmeg_mutex_destroy(&loader->lock);
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, loader, sizeof(*loader));
+        return NULL;
+    }
+    return loader;
+}
+
+NutmegSceneLoad *nutmeg_scene_loader_destroy(NutmegSceneLoader *loader)
+{
+    nutmeg_mutex_lock(&loader->lock);
+    loader->stopping = true;
+    nutmeg_cond_signal(&loader->wake);
+    nutmeg_mutex_unlock(&loader->lock);
+    nutmeg_thread_join(loader->thread);
+
+    NutmegSceneLoad *left = loader->ready_head;
+    if (loader->ready_tail) {
+        loader->ready_tail->next = loader->queue_head;
+    } else {
+        left = loader->queue_head;
+    }
+
+    NutmegMemoryAccount *account = loader->account;
+    nutmeg_cond_destroy(&loader->built);
+    nutmeg_cond_destroy(&loader->wake);
+    nutmeg_mutex_destroy(&loader->lock);
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, loader, sizeof(*loader));
+    return left;
+}
+
+void nutmeg_scene_loader_submit(NutmegSceneLoader *loader, NutmegSceneLoad *load)
+{
+    nutmeg_mutex_lock(&loader->lock);
+    nutmeg_scene_loader_append(&loader->queue_head, &loader->queue_tail, load);
+    loader->pending++;
+    nutmeg_cond_signal(&loader->wake);
+    nutmeg_mutex_unlock(&loader->lock);
+}
+
+NutmegSceneLoad *nutmeg_scene_loader_take(NutmegSceneLoader *loader, bool wait)
+{
+    if (!wait && nutmeg_atomic_load_u64(&loader->ready_count) == 0) {
+        return NULL;
+    }
+
+    nutmeg_mutex_lock(&loader->lock);
+    while (wait && (loader->queue_head || loader->building)) {
+        nutmeg_cond_wait(&loader->built, &loader->lock);
+    }
+    NutmegSceneLoad *ready = loader->ready_head;
+    loader->ready_head = NULL;
+    loader->ready_tail = NULL;
+    loader->pending -= (size_t)nutmeg_atomic_load_u64(&loader->ready_count);
+    nutmeg_atomic_store_u64(&loader->ready_count, 0);
+    nutmeg_mutex_unlock(&loader->lock);
+    return ready;
+}
+
+static bool nutmeg_scene_loader_list_has_name(const NutmegSceneLoad *load, const char *name)
+{
+    for (; load; load = load->next) {
+        if (strcmp(nutmeg_scene_name(load->scene), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool nutmeg_scene_loader_has_name(NutmegSceneLoader *loader, const char *name)
+{
+    nutmeg_mutex_lock(&loader->lock);
+    bool found = nutmeg_scene_loader_list_has_name(loader->queue_head, name) || nutmeg_scene_loader_list_has_name(loader->ready_head, name) ||
+                 (loader->building && strcmp(nutmeg_scene_name(loader->building->scene), name) == 0);
+    nutmeg_mutex_unlock(&loader->lock);
+    return found;
+}
+
+size_t nutmeg_scene_loader_pending(NutmegSceneLoader *loader)
+{
+    nutmeg_mutex_lock(&loader->lock);
+    size_t pending = loader->pending;
+    nutmeg_mutex_unlock(&loader->lock);
+    return pending;
+}
@@ -0,0 +1,69 @@
+#ifndef NUTMEG_SCENE_LOADER_H
+#define NUTMEG_SCENE_LOADER_H
+
+#include "memory.h"
+#include "nutmeg_engine.h"
+#include "platform.h"
+
+/*
+ * Background thread that builds scenes for nutmeg_engine_load_scene_async.
+ * Loads are queued by the ticking thread, built one at a time in
+ * submission order, and parked on a ready list until the engine takes them
+ * at a tick boundary. Checking for ready loads costs one atomic read, so
+ * ticks without finished loads never touch the lock.
+ */
+
+/** One requested scene and the callbacks that build and deliver it. */
+typedef struct NutmegSceneLoad {
+    struct NutmegSceneLoad *next;
+    NutmegScene *scene;
+    NutmegSceneBuildFn build;
+    NutmegSceneLoadedFn loaded;
+    void *userdata;
+    bool built; /**< What build returned. */
+} NutmegSceneLoad;
+
+typedef struct NutmegSceneLoader {
+    NutmegMemoryAccount *account; /**< Charged under NUTMEG_MEMORY_ENGINE. */
+    NutmegEngine *engine;
+    NutmegAtomicU64 ready_count;
+
+    NutmegMutex lock; /**< Guards everything below. */
+    NutmegCond wake;  /**< Signalled when a load is queued or the loader stops. */
+    NutmegCond built; /**< Signalled when a build finishes. */
+    NutmegSceneLoad *queue_head;
+    NutmegSceneLoad *queue_tail;
+    NutmegSceneLoad *building;
+    NutmegSceneLoad *ready_head;
+    NutmegSceneLoad *ready_tail;
+    size_t pending;   /**< Loads queued, building or ready. */
+    bool stopping;
+    NutmegThread thread;
+} NutmegSceneLoader;
+
+/** Start the loader thread. Returns NULL on failure. */
+NutmegSceneLoader *nutmeg_scene_loader_create(NutmegMemoryAccount *account, NutmegEngine *engine);
+
+/**
+ * Let the current build finish, stop the thread and free the loader.
+ * Returns the loads that were never taken, queued ones included, for the
+ * caller to release.
+ */
+NutmegSceneLoad *nutmeg_scene_loader_destroy(NutmegSceneLoader *loader);
+
+/** Queue a load behind the others. */
+void nutmeg_scene_loader_submit(NutmegSceneLoader *loader, NutmegSceneLoad *load);
+
+/**
+ * Take every built load, oldest first, or NULL when none is ready. With
+ * wait set, first block until every queued load has been built.
+ */
+NutmegSceneLoad *nutmeg_scene_loader_take(NutmegSceneLoader *loader, bool wait);
+
+/** True when a load not taken yet builds a scene called name. */
+bool nutmeg_scene_loader_has_name(NutmegSceneLoader *loader, const char *name);
+
+/** Loads submitted and not taken yet. */
+size_t nutmeg_scene_loader_pending(NutmegSceneLoader *loader);
+
+#endif /* NUTMEG_SCENE_LOADER_H */
@@ -0,0 +1,171 @@
+#include "scene_registry.h"
+
+#include "symbol_table.h"
+
+#include <string.h>
+
+void nutmeg_scene_registry_init(NutmegSceneRegistry *registry, NutmegMemoryAccount *account)
+{
+    memset(registry, 0, sizeof(*registry));
+    registry->account = account;
+}
+
+void nutmeg_scene_registry_free(NutmegSceneRegistry *registry)
+{
+    NutmegMemoryAccount *account = registry->account;
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, registry->slots, registry->slot_capacity * sizeof(NutmegSceneSlot));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, registry->free_slots, registry->free_capacity * sizeof(unsigned int));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, registry->buckets, registry->bucket_capacity * sizeof(unsigned int));
+    memset(registry, 0, sizeof(*registry));
+    registry->account = account;
+}
+
+static bool nutmeg_scene_registry_grow(NutmegMemoryAccount *account, void **array, size_t element_size, size_t *capacity, size_t count)
+{
+    if (count <= *capacity) {
+        return true;
+    }
+
+    size_t new_capacity = *capacity ? *capacity * 2 : 16;
+    while (new_capacity < count) {
+        new_capacity *= 2;
+    }
+    void *resized = nutmeg_memory_realloc(account, NUTMEG_MEMORY_ENGINE, *array, *capacity * element_size, new_capacity * element_size);
+    if (!resized) {
+        return false;
+    }
+    *array = resized;
+    *capacity = new_capacity;
+    return true;
+}
+
+/* Bucket holding the slot registered under name, or the empty bucket where it belongs. */
+static size_t nutmeg_scene_registry_probe(const NutmegSceneRegistry *registry, const char *name, unsigned int hash)
+{
+    size_t mask = registry->bucket_capacity - 1;
+    size_t bucket = hash & mask;
+    for (;;) {
+        unsigned int entry = registry->buckets[bucket];
+        if (entry == 0) {
+            return bucket;
+        }
+        const NutmegSceneSlot *slot = &registry->slots[entry - 1];
+        if (slot->hash == hash && strcmp(slot->name, name) == 0) {
+            return bucket;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+}
+
+static bool nutmeg_scene_registry_grow_buckets(NutmegSceneRegistry *registry)
+{
+    size_t new_capacity = registry->bucket_capacity ? registry->bucket_capacity * 2 : 64;
+    unsigned int *buckets = (unsigned int *)nutmeg_memory_alloc(registry->account, NUTMEG_MEMORY_ENGINE, new_capacity * sizeof(unsigned int));
+    if (!buckets) {
+        return false;
+    }
+
+    for (size_t i = 0; i < registry->bucket_capacity; ++i) {
+        unsigned int entry = registry->buckets[i];
+        if (entry == 0) {
+            continue;
+        }
+        size_t bucket = registry->slots[entry - 1].hash & (new_capacity - 1);
+        while (buckets[bucket] != 0) {
+            bucket = (bucket + 1) & (new_capacity - 1);
+        }
+        buckets[bucket] = entry;
+    }
+
+    nutmeg_memory_free(registry->account, NUTMEG_MEMORY_ENGINE, registry->buckets, registry->bucket_capacity * sizeof(unsigned int));
+    registry->buckets = buckets;
+    registry->bucket_capacity = new_capacity;
+    return true;
+}
+
+bool nutmeg_scene_registry_insert(NutmegSceneRegistry *registry, NutmegScene *scene, const char *name, NutmegSceneHandle *out_handle)
+{
+    bool indexed = name[0] != '\0';
+    /* reserve everything first so a failure leaves the registry untouched; keep the load factor at or below 1/2 */
+    if (indexed && (registry->indexed_count + 1) * 2 > registry->bucket_capacity && !nutmeg_scene_registry_grow_buckets(registry)) {
+        return false;
+    }
+    if (!nutmeg_scene_registry_grow(registry->account, (void **)&registry->free_slots, sizeof(unsigned int), &registry->free_capacity, registry->slot_count + 1)) {
+        return false;
+    }
+
+    unsigned int index;
+    if (registry->free_count > 0) {
+        index = registry->free_slots[--registry->free_count];
+    } else {
+        if (!nutmeg_scene_registry_grow(registry->account, (void **)&registry->slots, sizeof(NutmegSceneSlot), &registry->slot_capacity, registry->slot_count + 1)) {
+            return false;
+        }
+        index = (unsigned int)registry->slot_count++;
+        registry->slots[index].generation = 1;
+    }
+
+    NutmegSceneSlot *slot = &registry->slots[index];
+    slot->scene = scene;
+    slot->name = name;
+    slot->hash = nutmeg_string_hash(name);
+    if (indexed) {
+        registry->buckets[nutmeg_scene_registry_probe(registry, name, slot->hash)] = index + 1;
+        registry->indexed_count++;
+    }
+
+    out_handle->index = index;
+    out_handle->generation = slot->generation;
+    return true;
+}
+
+void nutmeg_scene_registry_remove(NutmegSceneRegistry *registry, unsigned int index)
+{
+    NutmegSceneSlot *slot = &registry->slots[index];
+    if (slot->name[0] != '\0') {
+        size_t mask = registry->bucket_capacity - 1;
+        size_t bucket = nutmeg_scene_registry_probe(registry, slot->name, slot->hash);
+
+        /* shift following entries back so lookups never need tombstones */
+        size_t hole = bucket;
+        size_t next = (hole + 1) & mask;
+        while (registry->buckets[next] != 0) {
+            size_t home = registry->slots[registry->buckets[next] - 1].hash & mask;
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                registry->buckets[hole] = registry->buckets[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        registry->buckets[hole] = 0;
+        registry->indexed_count--;
+    }
+
+    slot->scene = NULL;
+    slot->name = NULL;
+    if (++slot->generation == 0) {
+        slot->generation = 1;
+    }
+    /* insert reserved room for every slot */
+    registry->free_slots[registry->free_count++] = index;
+}
+
+NutmegScene *nutmeg_scene_registry_find(const NutmegSceneRegistry *registry, const char *name)
+{
+    if (registry->bucket_capacity == 0 || name[0] == '\0') {
+        return NULL;
+    }
+
+    unsigned int entry = registry->buckets[nutmeg_scene_registry_probe(registry, name, nutmeg_string_hash(name))];
+    return entry ? registry->slots[entry - 1].scene : NULL;
+}
+
+NutmegScene *nutmeg_scene_registry_resolve(const NutmegSceneRegistry *registry, NutmegSceneHandle handle)
+{
+    if (handle.index >= registry->slot_count) {
+        return NULL;
+    }
+
+    const NutmegSceneSlot *slot = &registry->slots[handle.index];
+    return slot->generation == handle.generation ? slot->scene : NULL;
+}
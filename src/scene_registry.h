@@ -0,0 +1,52 @@
+#ifndef NUTMEG_SCENE_REGISTRY_H
+#define NUTMEG_SCENE_REGISTRY_H
+
+#include "memory.h"
+#include "nutmeg_engine.h"
+
+/**
+ * Slot table of the scenes registered with an engine, with an open
+ * addressing index from scene name to slot. Removed slots are reused, and
+ * their generation is bumped so handles to the removed scene stop
+ * resolving. Only non-empty names are indexed; they must be unique.
+ */
+typedef struct NutmegSceneSlot {
+    NutmegScene *scene;      /**< NULL while the slot is free. */
+    const char *name;        /**< Owned by the scene. */
+    unsigned int hash;
+    unsigned int generation; /**< Generation of the current or next occupant, never 0. */
+} NutmegSceneSlot;
+
+typedef struct NutmegSceneRegistry {
+    NutmegMemoryAccount *account; /**< Charged under NUTMEG_MEMORY_ENGINE. */
+    NutmegSceneSlot *slots;
+    size_t slot_count;            /**< Slots [0, slot_count) have been handed out at least once. */
+    size_t slot_capacity;
+    unsigned int *free_slots;
+    size_t free_count;
+    size_t free_capacity;
+    unsigned int *buckets;        /**< Slot index + 1 of each indexed name, 0 marks empty. */
+    size_t bucket_capacity;       /**< Zero or a power of two. */
+    size_t indexed_count;         /**< Names in the buckets. */
+} NutmegSceneRegistry;
+
+void nutmeg_scene_registry_init(NutmegSceneRegistry *registry, NutmegMemoryAccount *account);
+void nutmeg_scene_registry_free(NutmegSceneRegistry *registry);
+
+/**
+ * Register a scene under name (which must outlive the registration and not
+ * be registered yet). Returns false on allocation failure; otherwise the
+ * scene's handle is written to out_handle.
+ */
+bool nutmeg_scene_registry_insert(NutmegSceneRegistry *registry, NutmegScene *scene, const char *name, NutmegSceneHandle *out_handle);
+
+/** Unregister the scene in a slot and invalidate its handles. */
+void nutmeg_scene_registry_remove(NutmegSceneRegistry *registry, unsigned int index);
+
+/** Scene registered under a non-empty name, or NULL. */
+NutmegScene *nutmeg_scene_registry_find(const NutmegSceneRegistry *registry, const char *name);
+
+/** Scene a handle refers to, or NULL once it was removed. */
+NutmegScene *nutmeg_scene_registry_resolve(const NutmegSceneRegistry *registry, NutmegSceneHandle handle);
+
+#endif /* NUTMEG_SCENE_REGISTRY_H */
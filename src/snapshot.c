@@ -0,0 +1,99 @@
+#include "snapshot.h"
+
+#include "nutmeg_engine.h"
+
+#include <string.h>
+
+static unsigned long long nutmeg_snapshot_align(unsigned long long offset)
+{
+    return (offset + NUTMEG_SNAPSHOT_ALIGN - 1) & ~(unsigned long long)(NUTMEG_SNAPSHOT_ALIGN - 1);
+}
+
+size_t nutmeg_snapshot_column_size(NutmegSnapshotColumn column)
+{
+    switch (column) {
+    case NUTMEG_SNAPSHOT_POSITIONS:
+    case NUTMEG_SNAPSHOT_VELOCITIES:
+        return sizeof(NutmegVec2);
+    case NUTMEG_SNAPSHOT_RADII:
+        return sizeof(float);
+    case NUTMEG_SNAPSHOT_IDS:
+    case NUTMEG_SNAPSHOT_TAGS:
+        return sizeof(unsigned long long);
+    case NUTMEG_SNAPSHOT_NAMES:
+    case NUTMEG_SNAPSHOT_TYPE_IDS:
+        return sizeof(unsigned int);
+    default:
+        return 0;
+    }
+}
+
+void nutmeg_snapshot_layout(NutmegSnapshotHeader *header, unsigned long long object_count, unsigned int name_count, unsigned int tag_count, unsigned long long strings_size)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, NUTMEG_SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = NUTMEG_SNAPSHOT_VERSION;
+    header->byte_order = NUTMEG_SNAPSHOT_BYTE_ORDER;
+    header->object_count = object_count;
+    header->name_count = name_count;
+    header->tag_count = tag_count;
+    header->strings_offset = nutmeg_snapshot_align(sizeof(*header));
+    header->strings_size = strings_size;
+
+    unsigned long long offset = header->strings_offset + strings_size;
+    for (int c = 0; c < NUTMEG_SNAPSHOT_COLUMN_COUNT; ++c) {
+        offset = nutmeg_snapshot_align(offset);
+        header->columns[c] = offset;
+        offset += object_count * nutmeg_snapshot_column_size((NutmegSnapshotColumn)c);
+    }
+    header->file_size = offset;
+}
+
+bool nutmeg_snapshot_validate(const void *data, size_t size)
+{
+    NutmegSnapshotHeader header;
+    if (!data || size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, NUTMEG_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != NUTMEG_SNAPSHOT_VERSION || header.byte_order != NUTMEG_SNAPSHOT_BYTE_ORDER) {
+        return false;
+    }
+    if (header.file_size > size || header.strings_offset > header.file_size || header.strings_size > header.file_size - header.strings_offset) {
+        return false;
+    }
+    /* a count this large cannot fit any file, and keeps the products below from overflowing */
+    if (header.object_count > header.file_size) {
+        return false;
+    }
+    for (int c = 0; c < NUTMEG_SNAPSHOT_COLUMN_COUNT; ++c) {
+        unsigned long long bytes = header.object_count * nutmeg_snapshot_column_size((NutmegSnapshotColumn)c);
+        if (header.columns[c] % NUTMEG_SNAPSHOT_ALIGN != 0 || header.columns[c] > header.file_size || bytes > header.file_size - header.columns[c]) {
+            return false;
+        }
+    }
+
+    const char *strings = (const char *)data + header.strings_offset;
+    unsigned long long found = 0;
+    for (unsigned long long i = 0; i < header.strings_size; ++i) {
+        if (strings[i] == '\0') {
+            found++;
+        }
+    }
+    if (header.strings_size > 0 && strings[header.strings_size - 1] != '\0') {
+        return false;
+    }
+    return found == (unsigned long long)header.name_count + header.tag_count && header.tag_count <= NUTMEG_TAG_CAPACITY;
+}
+
+void nutmeg_snapshot_strings(const void *data, const char **strings)
+{
+    NutmegSnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    const char *string = (const char *)data + header.strings_offset;
+    unsigned int count = header.name_count + header.tag_count;
+    for (unsigned int i = 0; i < count; ++i) {
+        strings[i] = string;
+        string += strlen(string) + 1;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef NUTMEG_SNAPSHOT_H
+#define NUTMEG_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Binary scene snapshot layout. A header is followed by a string table and
+ * one column per object field, each column holding object_count entries in
+ * slot order and starting on a NUTMEG_SNAPSHOT_ALIGN boundary. Positions,
+ * velocities and radii are stored exactly as the chunk columns hold them,
+ * so loading copies them in 256-object blocks straight out of a mapped
+ * file. Snapshots are read in the byte order they were written in.
+ */
+#define NUTMEG_SNAPSHOT_MAGIC "NUTMEGSN"
+#define NUTMEG_SNAPSHOT_VERSION 1u
+#define NUTMEG_SNAPSHOT_BYTE_ORDER 0x01020304u
+#define NUTMEG_SNAPSHOT_ALIGN 16
+#define NUTMEG_SNAPSHOT_NO_NAME 0xffffffffu /**< Name column entry of an unnamed object. */
+
+typedef enum NutmegSnapshotColumn {
+    NUTMEG_SNAPSHOT_POSITIONS,  /**< NutmegVec2 */
+    NUTMEG_SNAPSHOT_VELOCITIES, /**< NutmegVec2 */
+    NUTMEG_SNAPSHOT_RADII,      /**< float */
+    NUTMEG_SNAPSHOT_IDS,        /**< unsigned long long */
+    NUTMEG_SNAPSHOT_NAMES,      /**< unsigned int index into the names, or NUTMEG_SNAPSHOT_NO_NAME */
+    NUTMEG_SNAPSHOT_TAGS,       /**< unsigned long long, bit i is the snapshot's tag i */
+    NUTMEG_SNAPSHOT_TYPE_IDS,   /**< unsigned int */
+    NUTMEG_SNAPSHOT_COLUMN_COUNT
+} NutmegSnapshotColumn;
+
+typedef struct NutmegSnapshotHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int byte_order;
+    unsigned long long object_count;
+    unsigned long long next_object_id;
+    unsigned int name_count;            /**< Leading strings of the table, the object names. */
+    unsigned int tag_count;             /**< Following strings, naming tag bits 0 and up. */
+    unsigned long long strings_offset;  /**< NUL terminated strings, back to back. */
+    unsigned long long strings_size;
+    unsigned long long columns[NUTMEG_SNAPSHOT_COLUMN_COUNT]; /**< Byte offset of each column. */
+    unsigned long long file_size;
+} NutmegSnapshotHeader;
+
+/** Bytes one entry of a column takes. */
+size_t nutmeg_snapshot_column_size(NutmegSnapshotColumn column);
+
+/** Fill in magic, version, counts and every offset for the given contents. */
+void nutmeg_snapshot_layout(NutmegSnapshotHeader *header, unsigned long long object_count, unsigned int name_count, unsigned int tag_count, unsigned long long strings_size);
+
+/**
+ * Check that data holds a complete snapshot this build can read: magic,
+ * version and byte order match, every column and the string table lie
+ * inside size, and the table holds exactly the strings the header counts.
+ */
+bool nutmeg_snapshot_validate(const void *data, size_t size);
+
+/** Strings of a validated snapshot, index 0 first. strings must have room for name_count + tag_count entries. */
+void nutmeg_snapshot_strings(const void *data, const char **strings);
+
+#endif /* NUTMEG_SNAPSHOT_H */
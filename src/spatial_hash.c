@@ -0,0 +1,254 @@
+#include "spatial_hash.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Cell coordinates are clamped so far away or non-finite positions stay representable. */
+#define NUTMEG_SPATIAL_CELL_LIMIT 536870912.0f
+
+static int nutmeg_spatial_cell(const NutmegSpatialHash *hash, float value)
+{
+    float cell = floorf(value * hash->inverse_cell_size);
+    if (!(cell > -NUTMEG_SPATIAL_CELL_LIMIT)) {
+        cell = -NUTMEG_SPATIAL_CELL_LIMIT;
+    }
+    if (cell > NUTMEG_SPATIAL_CELL_LIMIT) {
+        cell = NUTMEG_SPATIAL_CELL_LIMIT;
+    }
+    return (int)cell;
+}
+
+static size_t nutmeg_spatial_bucket(const NutmegSpatialHash *hash, int cell_x, int cell_y)
+{
+    unsigned int h = ((unsigned int)cell_x * 73856093u) ^ ((unsigned int)cell_y * 19349663u);
+    h ^= h >> 16;
+    return (size_t)h & (hash->bucket_count - 1);
+}
+
+void nutmeg_spatial_hash_init(NutmegSpatialHash *hash, NutmegMemoryAccount *account, float cell_size)
+{
+    memset(hash, 0, sizeof(*hash));
+    hash->account = account;
+    nutmeg_spatial_hash_set_cell_size(hash, cell_size);
+}
+
+void nutmeg_spatial_hash_free(NutmegSpatialHash *hash)
+{
+    size_t entry_bytes = hash->entry_capacity * sizeof(NutmegSpatialEntry);
+    nutmeg_memory_free(hash->account, NUTMEG_MEMORY_SPATIAL, hash->entries, entry_bytes);
+    nutmeg_memory_free(hash->account, NUTMEG_MEMORY_SPATIAL, hash->pending, entry_bytes);
+    if (hash->bucket_starts) {
+        nutmeg_memory_free(hash->account, NUTMEG_MEMORY_SPATIAL, hash->bucket_starts, (hash->bucket_count + 1) * sizeof(size_t));
+    }
+    memset(hash, 0, sizeof(*hash));
+}
+
+void nutmeg_spatial_hash_set_cell_size(NutmegSpatialHash *hash, float cell_size)
+{
+    if (!(cell_size > 0.0f)) {
+        return;
+    }
+    hash->cell_size = cell_size;
+    hash->inverse_cell_size = 1.0f / cell_size;
+}
+
+void nutmeg_spatial_hash_begin(NutmegSpatialHash *hash)
+{
+    hash->pending_count = 0;
+}
+
+bool nutmeg_spatial_hash_push(NutmegSpatialHash *hash, size_t slot, NutmegVec2 position, float radius)
+{
+    if (hash->pending_count == hash->entry_capacity) {
+        size_t new_capacity = hash->entry_capacity ? hash->entry_capacity * 2 : 256;
+        size_t old_bytes = hash->entry_capacity * sizeof(NutmegSpatialEntry);
+        size_t new_bytes = new_capacity * sizeof(NutmegSpatialEntry);
+        /* both arrays share entry_capacity, so grow them together or not at all */
+        NutmegSpatialEntry *pending = (NutmegSpatialEntry *)nutmeg_memory_alloc(hash->account, NUTMEG_MEMORY_SPATIAL, new_bytes);
+        NutmegSpatialEntry *entries = pending ? (NutmegSpatialEntry *)nutmeg_memory_alloc(hash->account, NUTMEG_MEMORY_SPATIAL, new_bytes) : NULL;
+        if (!entries) {
+            nutmeg_memory_free(hash->account, NUTMEG_MEMORY_SPATIAL, pending, new_bytes);
+            return false;
+        }
+        if (old_bytes > 0) {
+            memcpy(pending, hash->pending, old_bytes);
+            memcpy(entries, hash->entries, old_bytes);
+        }
+        nutmeg_memory_free(hash->account, NUTMEG_MEMORY_SPATIAL, hash->pending, old_bytes);
+        nutmeg_memory_free(hash->account, NUTMEG_MEMORY_SPATIAL, hash->entries, old_bytes);
+        hash->pending = pending;
+        hash->entries = entries;
+        hash->entry_capacity = new_capacity;
+    }
+
+    NutmegSpatialEntry *entry = &hash->pending[hash->pending_count++];
+    entry->position = position;
+    entry->radius = radius;
+    entry->cell_x = nutmeg_spatial_cell(hash, position.x);
+    entry->cell_y = nutmeg_spatial_cell(hash, position.y);
+    entry->slot = slot;
+    return true;
+}
+
+bool nutmeg_spatial_hash_build(NutmegSpatialHash *hash)
+{
+    size_t count = hash->pending_count;
+    size_t bucket_count = 64;
+    while (bucket_count < count) {
+        bucket_count *= 2;
+    }
+
+    if (bucket_count != hash->bucket_count) {
+        size_t old_bytes = hash->bucket_starts ? (hash->bucket_count + 1) * sizeof(size_t) : 0;
+        size_t *starts = (size_t *)nutmeg_memory_realloc(hash->account, NUTMEG_MEMORY_SPATIAL, hash->bucket_starts, old_bytes, (bucket_count + 1) * sizeof(size_t));
+        if (!starts) {
+            return false;
+        }
+        hash->bucket_starts = starts;
+        hash->bucket_count = bucket_count;
+    }
+
+    /* counting sort: histogram, exclusive prefix sum, scatter */
+    size_t *starts = hash->bucket_starts;
+    memset(starts, 0, (bucket_count + 1) * sizeof(size_t));
+    float max_radius = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        const NutmegSpatialEntry *entry = &hash->pending[i];
+        starts[nutmeg_spatial_bucket(hash, entry->cell_x, entry->cell_y) + 1]++;
+        if (entry->radius > max_radius) {
+            max_radius = entry->radius;
+        }
+    }
+    for (size_t b = 1; b <= bucket_count; ++b) {
+        starts[b] += starts[b - 1];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const NutmegSpatialEntry *entry = &hash->pending[i];
+        hash->entries[starts[nutmeg_spatial_bucket(hash, entry->cell_x, entry->cell_y)]++] = *entry;
+    }
+    /* the scatter advanced every start to the next bucket's start */
+    memmove(starts + 1, starts, bucket_count * sizeof(size_t));
+    starts[0] = 0;
+
+    hash->entry_count = count;
+    hash->max_radius = max_radius;
+    return true;
+}
+
+bool nutmeg_spatial_hash_visit(const NutmegSpatialHash *hash, NutmegVec2 min, NutmegVec2 max, NutmegSpatialVisitFn fn, void *context)
+{
+    if (hash->entry_count == 0) {
+        return true;
+    }
+
+    int x0 = nutmeg_spatial_cell(hash, min.x);
+    int y0 = nutmeg_spatial_cell(hash, min.y);
+    int x1 = nutmeg_spatial_cell(hash, max.x);
+    int y1 = nutmeg_spatial_cell(hash, max.y);
+    if (x1 < x0 || y1 < y0) {
+        return true;
+    }
+
+    double cells = ((double)x1 - (double)x0 + 1.0) * ((double)y1 - (double)y0 + 1.0);
+    if (cells > (double)hash->bucket_count) {
+        /* the box spans more cells than there are buckets: one linear pass is cheaper */
+        for (size_t i = 0; i < hash->entry_count; ++i) {
+            const NutmegSpatialEntry *entry = &hash->entries[i];
+            if (entry->cell_x >= x0 && entry->cell_x <= x1 && entry->cell_y >= y0 && entry->cell_y <= y1 && !fn(entry, context)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            size_t bucket = nutmeg_spatial_bucket(hash, x, y);
+            for (size_t i = hash->bucket_starts[bucket]; i < hash->bucket_starts[bucket + 1]; ++i) {
+                const NutmegSpatialEntry *entry = &hash->entries[i];
+                if (entry->cell_x == x && entry->cell_y == y && !fn(entry, context)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+typedef struct NutmegNearestSearch {
+    NutmegVec2 point;
+    float best_distance_sq;
+    const NutmegSpatialEntry *best;
+    NutmegSpatialVisitFn accept;
+    void *context;
+} NutmegNearestSearch;
+
+static void nutmeg_nearest_consider(NutmegNearestSearch *search, const NutmegSpatialEntry *entry)
+{
+    float dx = entry->position.x - search->point.x;
+    float dy = entry->position.y - search->point.y;
+    float distance_sq = dx * dx + dy * dy;
+    bool closer = search->best ? distance_sq < search->best_distance_sq : distance_sq <= search->best_distance_sq;
+    if (closer && (!search->accept || search->accept(entry, search->context))) {
+        search->best_distance_sq = distance_sq;
+        search->best = entry;
+    }
+}
+
+static void nutmeg_nearest_cell(const NutmegSpatialHash *hash, NutmegNearestSearch *search, int x, int y)
+{
+    size_t bucket = nutmeg_spatial_bucket(hash, x, y);
+    for (size_t i = hash->bucket_starts[bucket]; i < hash->bucket_starts[bucket + 1]; ++i) {
+        const NutmegSpatialEntry *entry = &hash->entries[i];
+        if (entry->cell_x == x && entry->cell_y == y) {
+            nutmeg_nearest_consider(search, entry);
+        }
+    }
+}
+
+const NutmegSpatialEntry *nutmeg_spatial_hash_nearest(const NutmegSpatialHash *hash, NutmegVec2 point, float max_distance, NutmegSpatialVisitFn accept, void *context)
+{
+    if (hash->entry_count == 0 || !(max_distance >= 0.0f)) {
+        return NULL;
+    }
+
+    NutmegNearestSearch search;
+    search.point = point;
+    search.best_distance_sq = max_distance * max_distance;
+    search.best = NULL;
+    search.accept = accept;
+    search.context = context;
+
+    float ring_limit = ceilf(max_distance * hash->inverse_cell_size);
+    double span = 2.0 * (double)ring_limit + 1.0;
+    if (span * span > (double)hash->bucket_count) {
+        for (size_t i = 0; i < hash->entry_count; ++i) {
+            nutmeg_nearest_consider(&search, &hash->entries[i]);
+        }
+        return search.best;
+    }
+
+    int center_x = nutmeg_spatial_cell(hash, point.x);
+    int center_y = nutmeg_spatial_cell(hash, point.y);
+    int rings = (int)ring_limit;
+    for (int ring = 0; ring <= rings; ++ring) {
+        for (int dy = -ring; dy <= ring; ++dy) {
+            if (dy == -ring || dy == ring) {
+                for (int dx = -ring; dx <= ring; ++dx) {
+                    nutmeg_nearest_cell(hash, &search, center_x + dx, center_y + dy);
+                }
+            } else {
+                nutmeg_nearest_cell(hash, &search, center_x - ring, center_y + dy);
+                nutmeg_nearest_cell(hash, &search, center_x + ring, center_y + dy);
+            }
+        }
+
+        /* every cell beyond this ring is at least ring cells away from the point */
+        float reach = (float)ring * hash->cell_size;
+        if (search.best && search.best_distance_sq <= reach * reach) {
+            break;
+        }
+    }
+    return search.best;
+}
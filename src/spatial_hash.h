@@ -0,0 +1,67 @@
+#ifndef NUTMEG_SPATIAL_HASH_H
+#define NUTMEG_SPATIAL_HASH_H
+
+#include "memory.h"
+#include "nutmeg_engine.h"
+
+/**
+ * Uniform grid broadphase over a hashed set of cells. Entries are pushed in
+ * any order and then sorted by bucket with a counting sort, so a rebuild is
+ * O(n) and every bucket is a contiguous run of entries. Cells colliding in
+ * one bucket are told apart by the cell coordinates stored in each entry.
+ */
+typedef struct NutmegSpatialEntry {
+    NutmegVec2 position;
+    float radius;
+    int cell_x;
+    int cell_y;
+    size_t slot; /**< Caller defined payload, the scene slot of the object. */
+} NutmegSpatialEntry;
+
+typedef struct NutmegSpatialHash {
+    NutmegMemoryAccount *account; /**< Charged under NUTMEG_MEMORY_SPATIAL. */
+    float cell_size;
+    float inverse_cell_size;
+    float max_radius;             /**< Largest entry radius of the last build. */
+    NutmegSpatialEntry *entries;  /**< Sorted by bucket after a build. */
+    NutmegSpatialEntry *pending;  /**< Entries pushed since the last build. */
+    size_t entry_count;
+    size_t pending_count;
+    size_t entry_capacity;        /**< Capacity of both entries and pending. */
+    size_t *bucket_starts;        /**< bucket_count + 1 offsets into entries. */
+    size_t bucket_count;          /**< Zero or a power of two. */
+} NutmegSpatialHash;
+
+/** Returns false when an entry visitor asks to stop. */
+typedef bool (*NutmegSpatialVisitFn)(const NutmegSpatialEntry *entry, void *context);
+
+void nutmeg_spatial_hash_init(NutmegSpatialHash *hash, NutmegMemoryAccount *account, float cell_size);
+void nutmeg_spatial_hash_free(NutmegSpatialHash *hash);
+
+/** Change the cell size. Takes effect at the next build. */
+void nutmeg_spatial_hash_set_cell_size(NutmegSpatialHash *hash, float cell_size);
+
+/** Drop the pending entries and start collecting a new set. */
+void nutmeg_spatial_hash_begin(NutmegSpatialHash *hash);
+
+/** Add an entry to the pending set. Returns false on allocation failure. */
+bool nutmeg_spatial_hash_push(NutmegSpatialHash *hash, size_t slot, NutmegVec2 position, float radius);
+
+/** Replace the indexed entries by the pending set. Returns false on allocation failure. */
+bool nutmeg_spatial_hash_build(NutmegSpatialHash *hash);
+
+/**
+ * Visit every entry stored in a cell overlapping the box [min, max]. Entries
+ * are visited at most once but may lie outside the box; callers apply the
+ * exact test. Returns false if the visitor stopped early.
+ */
+bool nutmeg_spatial_hash_visit(const NutmegSpatialHash *hash, NutmegVec2 min, NutmegVec2 max, NutmegSpatialVisitFn fn, void *context);
+
+/**
+ * Find the entry closest to point within max_distance among those accepted
+ * by the filter (NULL accepts all). Cells are searched in rings around the
+ * point and the search ends as soon as no closer entry can exist.
+ */
+const NutmegSpatialEntry *nutmeg_spatial_hash_nearest(const NutmegSpatialHash *hash, NutmegVec2 point, float max_distance, NutmegSpatialVisitFn accept, void *context);
+
+#endif /* NUTMEG_SPATIAL_HASH_H */
@@ -0,0 +1,174 @@
+#include "symbol_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+unsigned int nutmeg_string_hash(const char *string)
+{
+    /* 32-bit FNV-1a */
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)string; *c; ++c) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool nutmeg_symbol_table_init(NutmegSymbolTable *table, NutmegMemoryAccount *account)
+{
+    memset(table, 0, sizeof(*table));
+    table->account = account;
+    table->count = 1;
+    return nutmeg_mutex_init(&table->lock);
+}
+
+void nutmeg_symbol_table_free(NutmegSymbolTable *table)
+{
+    NutmegMemoryAccount *account = table->account;
+    for (size_t i = 1; i < table->count; ++i) {
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, table->strings[i], strlen(table->strings[i]) + 1);
+    }
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, table->strings, table->capacity * sizeof(char *));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, table->hashes, table->capacity * sizeof(unsigned int));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, table->buckets, table->bucket_capacity * sizeof(NutmegSymbol));
+    nutmeg_mutex_destroy(&table->lock);
+    memset(table, 0, sizeof(*table));
+}
+
+/* Find the bucket holding string, or the empty bucket where it belongs. Caller holds the lock. */
+static size_t nutmeg_symbol_table_probe(const NutmegSymbolTable *table, const char *string, unsigned int hash)
+{
+    size_t mask = table->bucket_capacity - 1;
+    size_t bucket = hash & mask;
+    for (;;) {
+        NutmegSymbol symbol = table->buckets[bucket];
+        if (symbol == NUTMEG_SYMBOL_NONE) {
+            return bucket;
+        }
+        if (table->hashes[symbol] == hash && strcmp(table->strings[symbol], string) == 0) {
+            return bucket;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+}
+
+static bool nutmeg_symbol_table_grow_buckets(NutmegSymbolTable *table)
+{
+    size_t new_capacity = table->bucket_capacity ? table->bucket_capacity * 2 : 64;
+    NutmegSymbol *buckets = (NutmegSymbol *)nutmeg_memory_alloc(table->account, NUTMEG_MEMORY_ENGINE, new_capacity * sizeof(NutmegSymbol));
+    if (!buckets) {
+        return false;
+    }
+
+    for (size_t symbol = 1; symbol < table->count; ++symbol) {
+        size_t bucket = table->hashes[symbol] & (new_capacity - 1);
+        while (buckets[bucket] != NUTMEG_SYMBOL_NONE) {
+            bucket = (bucket + 1) & (new_capacity - 1);
+        }
+        buckets[bucket] = (NutmegSymbol)symbol;
+    }
+
+    nutmeg_memory_free(table->account, NUTMEG_MEMORY_ENGINE, table->buckets, table->bucket_capacity * sizeof(NutmegSymbol));
+    table->buckets = buckets;
+    table->bucket_capacity = new_capacity;
+    return true;
+}
+
+NutmegSymbol nutmeg_symbol_table_intern(NutmegSymbolTable *table, const char *string)
+{
+    if (!string || string[0] == '\0') {
+        return NUTMEG_SYMBOL_NONE;
+    }
+
+    unsigned int hash = nutmeg_string_hash(string);
+    NutmegSymbol result = NUTMEG_SYMBOL_NONE;
+
+    nutmeg_mutex_lock(&table->lock);
+
+    /* keep the load factor at or below 1/2 */
+    if (table->count * 2 > table->bucket_capacity && !nutmeg_symbol_table_grow_buckets(table)) {
+        nutmeg_mutex_unlock(&table->lock);
+        return NUTMEG_SYMBOL_NONE;
+    }
+
+    size_t bucket = nutmeg_symbol_table_probe(table, string, hash);
+    if (table->buckets[bucket] != NUTMEG_SYMBOL_NONE) {
+        result = table->buckets[bucket];
+        nutmeg_mutex_unlock(&table->lock);
+        return result;
+    }
+
+    if (table->count >= table->capacity) {
+        size_t new_capacity = table->capacity ? table->capacity * 2 : 64;
+        /* both arrays share capacity, so grow them together or not at all */
+        char **strings = (char **)nutmeg_memory_alloc(table->account, NUTMEG_MEMORY_ENGINE, new_capacity * sizeof(char *));
+        unsigned int *hashes = strings ? (unsigned int *)nutmeg_memory_alloc(table->account, NUTMEG_MEMORY_ENGINE, new_capacity * sizeof(unsigned int)) : NULL;
+        if (!hashes) {
+            nutmeg_memory_free(table->account, NUTMEG_MEMORY_ENGINE, strings, new_capacity * sizeof(char *));
+            nutmeg_mutex_unlock(&table->lock);
+            return NUTMEG_SYMBOL_NONE;
+        }
+        if (table->capacity > 0) {
+            memcpy(strings, table->strings, table->capacity * sizeof(char *));
+            memcpy(hashes, table->hashes, table->capacity * sizeof(unsigned int));
+        }
+        nutmeg_memory_free(table->account, NUTMEG_MEMORY_ENGINE, table->strings, table->capacity * sizeof(char *));
+        nutmeg_memory_free(table->account, NUTMEG_MEMORY_ENGINE, table->hashes, table->capacity * sizeof(unsigned int));
+        table->strings = strings;
+        table->hashes = hashes;
+        table->capacity = new_capacity;
+    }
+
+    size_t length = strlen(string);
+    char *copy = (char *)nutmeg_memory_alloc(table->account, NUTMEG_MEMORY_ENGINE, length + 1);
+    if (copy) {
+        memcpy(copy, string, length + 1);
+        result = (NutmegSymbol)table->count++;
+        table->strings[result] = copy;
+        table->hashes[result] = hash;
+        table->buckets[bucket] = result;
+    }
+
+    nutmeg_mutex_unlock(&table->lock);
+    return result;
+}
+
+NutmegSymbol nutmeg_symbol_table_find(NutmegSymbolTable *table, const char *string)
+{
+    if (!string || string[0] == '\0') {
+        return NUTMEG_SYMBOL_NONE;
+    }
+
+    unsigned int hash = nutmeg_string_hash(string);
+    NutmegSymbol result = NUTMEG_SYMBOL_NONE;
+
+    nutmeg_mutex_lock(&table->lock);
+    if (table->bucket_capacity > 0) {
+        result = table->buckets[nutmeg_symbol_table_probe(table, string, hash)];
+    }
+    nutmeg_mutex_unlock(&table->lock);
+    return result;
+}
+
+size_t nutmeg_symbol_table_count(NutmegSymbolTable *table)
+{
+    nutmeg_mutex_lock(&table->lock);
+    size_t count = table->count;
+    nutmeg_mutex_unlock(&table->lock);
+    return count;
+}
+
+const char *nutmeg_symbol_table_name(NutmegSymbolTable *table, NutmegSymbol symbol)
+{
+    if (symbol == NUTMEG_SYMBOL_NONE) {
+        return "";
+    }
+
+    const char *name = NULL;
+    nutmeg_mutex_lock(&table->lock);
+    if (symbol < table->count) {
+        name = table->strings[symbol];
+    }
+    nutmeg_mutex_unlock(&table->lock);
+    return name;
+}
@@ -0,0 +1,43 @@
+#ifndef NUTMEG_SYMBOL_TABLE_H
+#define NUTMEG_SYMBOL_TABLE_H
+
+#include "memory.h"
+#include "nutmeg_engine.h"
+#include "platform.h"
+
+/**
+ * Thread-safe string interning table. Symbols are small dense integers
+ * starting at 1; NUTMEG_SYMBOL_NONE stands for the empty string. Interned
+ * strings are allocated individually and never move, so the pointers
+ * returned by nutmeg_symbol_table_name stay valid for the table's lifetime.
+ */
+typedef struct NutmegSymbolTable {
+    NutmegMutex lock;
+    NutmegMemoryAccount *account; /**< Charged under NUTMEG_MEMORY_ENGINE. */
+    char **strings;          /**< strings[symbol], index 0 unused. */
+    unsigned int *hashes;    /**< hashes[symbol] */
+    size_t count;            /**< Number of symbols including the reserved zero. */
+    size_t capacity;
+    NutmegSymbol *buckets;   /**< Open addressing table of symbols, 0 marks empty. */
+    size_t bucket_capacity;  /**< Zero or a power of two. */
+} NutmegSymbolTable;
+
+bool nutmeg_symbol_table_init(NutmegSymbolTable *table, NutmegMemoryAccount *account);
+void nutmeg_symbol_table_free(NutmegSymbolTable *table);
+
+/** Intern a string, returning its symbol. Returns NUTMEG_SYMBOL_NONE for NULL/"" or on allocation failure. */
+NutmegSymbol nutmeg_symbol_table_intern(NutmegSymbolTable *table, const char *string);
+
+/** Lookup a string without interning it. Returns NUTMEG_SYMBOL_NONE when absent. */
+NutmegSymbol nutmeg_symbol_table_find(NutmegSymbolTable *table, const char *string);
+
+/** Number of symbols handed out so far, including the reserved zero; every symbol below it is valid. */
+size_t nutmeg_symbol_table_count(NutmegSymbolTable *table);
+
+/** Retrieve the string of a symbol ("" for NUTMEG_SYMBOL_NONE, NULL when unknown). */
+const char *nutmeg_symbol_table_name(NutmegSymbolTable *table, NutmegSymbol symbol);
+
+/** 32-bit FNV-1a hash of a string, shared with the other name indexes. */
+unsigned int nutmeg_string_hash(const char *string);
+
+#endif /* NUTMEG_SYMBOL_TABLE_H */
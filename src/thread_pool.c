@@ -0,0 +1,256 @@
+#include "thread_pool.h"
+
+#include "platform.h"
+
+/*
+ * Each participant owns a task range packed into one 64-bit word (begin in
+ * the low half, end in the high half) so both the owner popping from the
+ * front and thieves splitting off the back can update it with a single CAS.
+ * Slots are padded to a cache line to avoid false sharing between owners.
+ */
+typedef struct NutmegWorkerSlot {
+    NutmegAtomicU64 range;
+    char padding[64 - sizeof(unsigned long long)];
+} NutmegWorkerSlot;
+
+typedef struct NutmegWorkerStart {
+    NutmegThreadPool *pool;
+    unsigned int index;
+} NutmegWorkerStart;
+
+struct NutmegThreadPool {
+    NutmegMemoryAccount *account;
+    unsigned int capacity;         /**< Participants the arrays were sized for. */
+    unsigned int participant_count;
+    NutmegThread *threads;
+    NutmegWorkerStart *starts;
+    NutmegWorkerSlot *slots;
+    NutmegMutex lock;
+    NutmegCond wake;
+    NutmegCond done;
+    unsigned long long generation; /**< Incremented for every job; guarded by lock. */
+    unsigned int busy;             /**< Background workers still inside the current job. */
+    bool shutdown;
+    NutmegTaskFn fn;
+    void *context;
+    NutmegAtomicU64 remaining;     /**< Tasks of the current job not yet completed. */
+};
+
+static unsigned long long nutmeg_range_pack(size_t begin, size_t end)
+{
+    return (unsigned long long)begin | ((unsigned long long)end << 32);
+}
+
+static size_t nutmeg_range_begin(unsigned long long range)
+{
+    return (size_t)(range & 0xFFFFFFFFULL);
+}
+
+static size_t nutmeg_range_end(unsigned long long range)
+{
+    return (size_t)(range >> 32);
+}
+
+static bool nutmeg_thread_pool_pop(NutmegWorkerSlot *slot, size_t *out_task)
+{
+    for (;;) {
+        unsigned long long range = nutmeg_atomic_load_u64(&slot->range);
+        size_t begin = nutmeg_range_begin(range);
+        size_t end = nutmeg_range_end(range);
+        if (begin >= end) {
+            return false;
+        }
+        if (nutmeg_atomic_cas_u64(&slot->range, range, nutmeg_range_pack(begin + 1, end))) {
+            *out_task = begin;
+            return true;
+        }
+    }
+}
+
+/* Move half of another participant's remaining range into our own slot. */
+static bool nutmeg_thread_pool_steal(NutmegThreadPool *pool, unsigned int worker)
+{
+    for (unsigned int offset = 1; offset < pool->participant_count; ++offset) {
+        NutmegWorkerSlot *victim = &pool->slots[(worker + offset) % pool->participant_count];
+        unsigned long long range = nutmeg_atomic_load_u64(&victim->range);
+        size_t begin = nutmeg_range_begin(range);
+        size_t end = nutmeg_range_end(range);
+        if (begin >= end) {
+            continue;
+        }
+
+        size_t take = (end - begin + 1) / 2;
+        if (nutmeg_atomic_cas_u64(&victim->range, range, nutmeg_range_pack(begin, end - take))) {
+            nutmeg_atomic_store_u64(&pool->slots[worker].range, nutmeg_range_pack(end - take, end));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void nutmeg_thread_pool_participate(NutmegThreadPool *pool, unsigned int worker, NutmegTaskFn fn, void *context)
+{
+    NutmegWorkerSlot *own = &pool->slots[worker];
+    for (;;) {
+        size_t task = 0;
+        if (nutmeg_thread_pool_pop(own, &task)) {
+            fn(context, task, worker);
+            nutmeg_atomic_fetch_add_u64(&pool->remaining, (unsigned long long)-1);
+            continue;
+        }
+
+        if (nutmeg_atomic_load_u64(&pool->remaining) == 0) {
+            return;
+        }
+
+        /* tasks still in flight elsewhere: help out or wait for them */
+        if (!nutmeg_thread_pool_steal(pool, worker)) {
+            nutmeg_thread_yield();
+        }
+    }
+}
+
+static void nutmeg_thread_pool_worker(void *arg)
+{
+    NutmegWorkerStart *start = (NutmegWorkerStart *)arg;
+    NutmegThreadPool *pool = start->pool;
+    unsigned long long seen = 0;
+
+    for (;;) {
+        nutmeg_mutex_lock(&pool->lock);
+        while (!pool->shutdown && pool->generation == seen) {
+            nutmeg_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->shutdown) {
+            nutmeg_mutex_unlock(&pool->lock);
+            return;
+        }
+        seen = pool->generation;
+        NutmegTaskFn fn = pool->fn;
+        void *context = pool->context;
+        nutmeg_mutex_unlock(&pool->lock);
+
+        nutmeg_thread_pool_participate(pool, start->index, fn, context);
+
+        nutmeg_mutex_lock(&pool->lock);
+        pool->busy--;
+        if (pool->busy == 0) {
+            nutmeg_cond_signal(&pool->done);
+        }
+        nutmeg_mutex_unlock(&pool->lock);
+    }
+}
+
+NutmegThreadPool *nutmeg_thread_pool_create(NutmegMemoryAccount *account, unsigned int participant_count)
+{
+    if (participant_count < 2) {
+        return NULL;
+    }
+
+    NutmegThreadPool *pool = (NutmegThreadPool *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+
+    unsigned int thread_count = participant_count - 1;
+    pool->account = account;
+    pool->capacity = participant_count;
+    pool->participant_count = participant_count;
+    pool->threads = (NutmegThread *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, thread_count * sizeof(NutmegThread));
+    pool->starts = (NutmegWorkerStart *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, thread_count * sizeof(NutmegWorkerStart));
+    pool->slots = (NutmegWorkerSlot *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, participant_count * sizeof(NutmegWorkerSlot));
+    if (!pool->threads || !pool->starts || !pool->slots) {
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool->threads, thread_count * sizeof(NutmegThread));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool->starts, thread_count * sizeof(NutmegWorkerStart));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool->slots, participant_count * sizeof(NutmegWorkerSlot));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool, sizeof(*pool));
+        return NULL;
+    }
+
+    nutmeg_mutex_init(&pool->lock);
+    nutmeg_cond_init(&pool->wake);
+    nutmeg_cond_init(&pool->done);
+
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        pool->starts[i].pool = pool;
+        pool->starts[i].index = i + 1;
+        if (!nutmeg_thread_start(&pool->threads[i], nutmeg_thread_pool_worker, &pool->starts[i])) {
+            /* run with the threads that did start */
+            pool->participant_count = i + 1;
+            break;
+        }
+    }
+
+    if (pool->participant_count < 2) {
+        nutmeg_thread_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void nutmeg_thread_pool_destroy(NutmegThreadPool *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    nutmeg_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    nutmeg_cond_broadcast(&pool->wake);
+    nutmeg_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i + 1 < pool->participant_count; ++i) {
+        nutmeg_thread_join(pool->threads[i]);
+    }
+
+    nutmeg_cond_destroy(&pool->done);
+    nutmeg_cond_destroy(&pool->wake);
+    nutmeg_mutex_destroy(&pool->lock);
+    NutmegMemoryAccount *account = pool->account;
+    unsigned int thread_count = pool->capacity - 1;
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool->threads, thread_count * sizeof(NutmegThread));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool->starts, thread_count * sizeof(NutmegWorkerStart));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool->slots, pool->capacity * sizeof(NutmegWorkerSlot));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, pool, sizeof(*pool));
+}
+
+unsigned int nutmeg_thread_pool_size(const NutmegThreadPool *pool)
+{
+    return pool ? pool->participant_count : 1u;
+}
+
+void nutmeg_thread_pool_run(NutmegThreadPool *pool, size_t task_count, NutmegTaskFn fn, void *context)
+{
+    if (!pool || !fn || task_count == 0) {
+        return;
+    }
+
+    /* give every participant an even share up front; stealing evens out the rest */
+    unsigned int participants = pool->participant_count;
+    size_t share = task_count / participants;
+    size_t extra = task_count % participants;
+    size_t begin = 0;
+    for (unsigned int i = 0; i < participants; ++i) {
+        size_t end = begin + share + (i < extra ? 1 : 0);
+        nutmeg_atomic_store_u64(&pool->slots[i].range, nutmeg_range_pack(begin, end));
+        begin = end;
+    }
+    nutmeg_atomic_store_u64(&pool->remaining, task_count);
+
+    nutmeg_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->context = context;
+    pool->busy = participants - 1;
+    pool->generation++;
+    nutmeg_cond_broadcast(&pool->wake);
+    nutmeg_mutex_unlock(&pool->lock);
+
+    nutmeg_thread_pool_participate(pool, 0, fn, context);
+
+    /* join barrier: no worker may still be touching this job on return */
+    nutmeg_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        nutmeg_cond_wait(&pool->done, &pool->lock);
+    }
+    nutmeg_mutex_unlock(&pool->lock);
+}
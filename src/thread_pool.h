@@ -0,0 +1,42 @@
+#ifndef NUTMEG_THREAD_POOL_H
+#define NUTMEG_THREAD_POOL_H
+
+#include "memory.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Fork/join worker pool used for parallel event dispatch.
+ *
+ * A job is a range of task indices. The range is split evenly between the
+ * participants up front; a participant that runs out of work steals half of
+ * the remaining range from another one, which keeps uneven task costs
+ * balanced without a shared queue.
+ */
+typedef struct NutmegThreadPool NutmegThreadPool;
+
+/** Task callback: runs task_index on behalf of participant worker_index. */
+typedef void (*NutmegTaskFn)(void *context, size_t task_index, unsigned int worker_index);
+
+/**
+ * Create a pool with participant_count participants. The thread calling
+ * nutmeg_thread_pool_run is always participant 0, so participant_count - 1
+ * background threads are started. The pool's memory is charged to account.
+ * Returns NULL for counts below 2.
+ */
+NutmegThreadPool *nutmeg_thread_pool_create(NutmegMemoryAccount *account, unsigned int participant_count);
+
+/** Stop and join the background threads. */
+void nutmeg_thread_pool_destroy(NutmegThreadPool *pool);
+
+/** Number of participants including the calling thread. */
+unsigned int nutmeg_thread_pool_size(const NutmegThreadPool *pool);
+
+/**
+ * Run fn for every task index in [0, task_count) and return once all of them
+ * have completed. Must not be called concurrently or from inside a task.
+ */
+void nutmeg_thread_pool_run(NutmegThreadPool *pool, size_t task_count, NutmegTaskFn fn, void *context);
+
+#endif /* NUTMEG_THREAD_POOL_H */
@@ -0,0 +1,174 @@
+#include "tick_stats.h"
+
+#include <string.h>
+
+#define NUTMEG_TICK_SUB_BITS 4 /* log2(NUTMEG_TICK_SUB_BUCKETS) */
+
+static size_t nutmeg_tick_bucket(unsigned long long value)
+{
+    if (value < 2 * NUTMEG_TICK_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+
+    int magnitude = 63;
+    while (!(value >> magnitude)) {
+        magnitude--;
+    }
+    if (magnitude > NUTMEG_TICK_MAX_MAGNITUDE) {
+        return NUTMEG_TICK_BUCKETS - 1;
+    }
+
+    /* keep the top NUTMEG_TICK_SUB_BITS + 1 bits: sub lies in [SUB_BUCKETS, 2 * SUB_BUCKETS) */
+    int shift = magnitude - NUTMEG_TICK_SUB_BITS;
+    size_t sub = (size_t)(value >> shift);
+    return 2 * NUTMEG_TICK_SUB_BUCKETS + (size_t)(shift - 1) * NUTMEG_TICK_SUB_BUCKETS + (sub - NUTMEG_TICK_SUB_BUCKETS);
+}
+
+/* Highest value mapping to a bucket. */
+static unsigned long long nutmeg_tick_bucket_limit(size_t bucket)
+{
+    if (bucket < 2 * NUTMEG_TICK_SUB_BUCKETS) {
+        return (unsigned long long)bucket;
+    }
+
+    size_t offset = bucket - 2 * NUTMEG_TICK_SUB_BUCKETS;
+    int shift = (int)(offset / NUTMEG_TICK_SUB_BUCKETS) + 1;
+    unsigned long long sub = (unsigned long long)(offset % NUTMEG_TICK_SUB_BUCKETS + NUTMEG_TICK_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+/*
+ * Walk cumulative bucket counts once and resolve every percentile. Values
+ * are reported as the bucket's upper limit, capped at the exact maximum.
+ */
+static void nutmeg_tick_percentiles(const unsigned long long *counts, size_t first, size_t last, NutmegTickStats *stats)
+{
+    static const double fractions[3] = {0.50, 0.95, 0.99};
+    unsigned long long *targets[3];
+    targets[0] = &stats->p50_ns;
+    targets[1] = &stats->p95_ns;
+    targets[2] = &stats->p99_ns;
+
+    int next = 0;
+    unsigned long long seen = 0;
+    for (size_t b = first; b <= last && next < 3; ++b) {
+        seen += counts[b];
+        while (next < 3) {
+            unsigned long long rank = (unsigned long long)(fractions[next] * (double)stats->count + 0.999999);
+            if (rank == 0) {
+                rank = 1;
+            }
+            if (seen < rank) {
+                break;
+            }
+            unsigned long long limit = nutmeg_tick_bucket_limit(b);
+            *targets[next++] = limit < stats->max_ns ? limit : stats->max_ns;
+        }
+    }
+}
+
+void nutmeg_tick_ring_push(NutmegTickRing *ring, unsigned long long duration_ns)
+{
+    unsigned long long head = nutmeg_atomic_load_u64(&ring->head);
+    nutmeg_atomic_store_u64(&ring->samples[head % NUTMEG_TICK_RING_SLOTS], duration_ns);
+    nutmeg_atomic_store_u64(&ring->head, head + 1);
+}
+
+size_t nutmeg_tick_ring_copy(NutmegTickRing *ring, unsigned long long *out_samples, size_t capacity)
+{
+    if (capacity > NUTMEG_TICK_HISTORY_CAPACITY) {
+        capacity = NUTMEG_TICK_HISTORY_CAPACITY;
+    }
+
+    unsigned long long head = nutmeg_atomic_load_u64(&ring->head);
+    unsigned long long begin = head > capacity ? head - capacity : 0;
+    for (unsigned long long i = begin; i < head; ++i) {
+        out_samples[i - begin] = nutmeg_atomic_load_u64(&ring->samples[i % NUTMEG_TICK_RING_SLOTS]);
+    }
+
+    /*
+     * Samples the producer lapped while we copied are torn from another
+     * window: drop them. The producer stores sample after before it
+     * publishes after + 1, so the slot of index after + 1 - slots may
+     * already hold it.
+     */
+    unsigned long long after = nutmeg_atomic_load_u64(&ring->head);
+    unsigned long long valid = after + 1 > NUTMEG_TICK_RING_SLOTS ? after + 1 - NUTMEG_TICK_RING_SLOTS : 0;
+    if (valid > begin) {
+        size_t dropped = valid < head ? (size_t)(valid - begin) : (size_t)(head - begin);
+        memmove(out_samples, out_samples + dropped, (size_t)(head - begin - dropped) * sizeof(*out_samples));
+        return (size_t)(head - begin) - dropped;
+    }
+    return (size_t)(head - begin);
+}
+
+void nutmeg_tick_ring_stats(NutmegTickRing *ring, size_t window, NutmegTickStats *out_stats)
+{
+    unsigned long long samples[NUTMEG_TICK_HISTORY_CAPACITY];
+    unsigned long long counts[NUTMEG_TICK_BUCKETS];
+    size_t count = nutmeg_tick_ring_copy(ring, samples, window);
+
+    memset(out_stats, 0, sizeof(*out_stats));
+    if (count == 0) {
+        return;
+    }
+
+    /* only the touched bucket range is cleared and scanned */
+    size_t first = NUTMEG_TICK_BUCKETS;
+    size_t last = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t bucket = nutmeg_tick_bucket(samples[i]);
+        if (bucket < first) {
+            first = bucket;
+        }
+        if (bucket > last) {
+            last = bucket;
+        }
+    }
+    memset(counts + first, 0, (last - first + 1) * sizeof(*counts));
+
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        counts[nutmeg_tick_bucket(samples[i])]++;
+        sum += samples[i];
+        if (samples[i] > out_stats->max_ns) {
+            out_stats->max_ns = samples[i];
+        }
+    }
+
+    out_stats->count = count;
+    out_stats->mean_ns = sum / count;
+    nutmeg_tick_percentiles(counts, first, last, out_stats);
+}
+
+void nutmeg_tick_histogram_record(NutmegTickHistogram *histogram, unsigned long long duration_ns)
+{
+    nutmeg_atomic_fetch_add_u64(&histogram->counts[nutmeg_tick_bucket(duration_ns)], 1);
+    nutmeg_atomic_fetch_add_u64(&histogram->sum_ns, duration_ns);
+    unsigned long long max = nutmeg_atomic_load_u64(&histogram->max_ns);
+    while (duration_ns > max && !nutmeg_atomic_cas_u64(&histogram->max_ns, max, duration_ns)) {
+        max = nutmeg_atomic_load_u64(&histogram->max_ns);
+    }
+    nutmeg_atomic_fetch_add_u64(&histogram->count, 1);
+}
+
+void nutmeg_tick_histogram_stats(NutmegTickHistogram *histogram, NutmegTickStats *out_stats)
+{
+    unsigned long long counts[NUTMEG_TICK_BUCKETS];
+    unsigned long long total = 0;
+    for (size_t b = 0; b < NUTMEG_TICK_BUCKETS; ++b) {
+        counts[b] = nutmeg_atomic_load_u64(&histogram->counts[b]);
+        total += counts[b];
+    }
+
+    memset(out_stats, 0, sizeof(*out_stats));
+    if (total == 0) {
+        return;
+    }
+
+    /* use the bucket total so a record racing this read cannot push a rank past the end */
+    out_stats->count = total;
+    out_stats->mean_ns = nutmeg_atomic_load_u64(&histogram->sum_ns) / total;
+    out_stats->max_ns = nutmeg_atomic_load_u64(&histogram->max_ns);
+    nutmeg_tick_percentiles(counts, 0, NUTMEG_TICK_BUCKETS - 1, out_stats);
+}
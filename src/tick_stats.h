@@ -0,0 +1,51 @@
+#ifndef NUTMEG_TICK_STATS_H
+#define NUTMEG_TICK_STATS_H
+
+#include "nutmeg_engine.h"
+#include "platform.h"
+
+/*
+ * Log-linear (HDR style) bucketing of nanosecond durations. Values below
+ * 2 * NUTMEG_TICK_SUB_BUCKETS get one bucket each; above that every power of
+ * two is split into NUTMEG_TICK_SUB_BUCKETS buckets, bounding the relative
+ * error of a reported value to 1 / NUTMEG_TICK_SUB_BUCKETS.
+ */
+#define NUTMEG_TICK_SUB_BUCKETS 16
+#define NUTMEG_TICK_MAX_MAGNITUDE 47 /**< Durations saturate at 2^48 ns, about three days. */
+#define NUTMEG_TICK_BUCKETS (2 * NUTMEG_TICK_SUB_BUCKETS + (NUTMEG_TICK_MAX_MAGNITUDE - 4) * NUTMEG_TICK_SUB_BUCKETS)
+
+/**
+ * Single producer ring of the most recent tick durations. The producer
+ * publishes a sample by storing it and then advancing head; readers copy a
+ * window and drop any sample the producer may have overwritten meanwhile,
+ * so neither side ever blocks. One slot more than the history holds is
+ * kept for the sample being stored.
+ */
+#define NUTMEG_TICK_RING_SLOTS (NUTMEG_TICK_HISTORY_CAPACITY + 1)
+
+typedef struct NutmegTickRing {
+    NutmegAtomicU64 samples[NUTMEG_TICK_RING_SLOTS];
+    NutmegAtomicU64 head; /**< Number of samples ever pushed. */
+} NutmegTickRing;
+
+/** Cumulative histogram of every recorded duration. */
+typedef struct NutmegTickHistogram {
+    NutmegAtomicU64 counts[NUTMEG_TICK_BUCKETS];
+    NutmegAtomicU64 count;
+    NutmegAtomicU64 sum_ns;
+    NutmegAtomicU64 max_ns;
+} NutmegTickHistogram;
+
+/** Push a duration. Must only be called from one thread at a time. */
+void nutmeg_tick_ring_push(NutmegTickRing *ring, unsigned long long duration_ns);
+
+/** Copy up to capacity of the most recent samples, oldest first. Returns the number copied. */
+size_t nutmeg_tick_ring_copy(NutmegTickRing *ring, unsigned long long *out_samples, size_t capacity);
+
+/** Summarise the last window samples (capped at the ring capacity). */
+void nutmeg_tick_ring_stats(NutmegTickRing *ring, size_t window, NutmegTickStats *out_stats);
+
+void nutmeg_tick_histogram_record(NutmegTickHistogram *histogram, unsigned long long duration_ns);
+void nutmeg_tick_histogram_stats(NutmegTickHistogram *histogram, NutmegTickStats *out_stats);
+
+#endif /* NUTMEG_TICK_STATS_H */
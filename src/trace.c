@@ -0,0 +1,271 @@
+#include "trace.h"
+
+#include <string.h>
+
+static const char *nutmeg_trace_category(unsigned int kind)
+{
+    switch (kind) {
+    case NUTMEG_TRACE_TICK:
+        return "tick";
+    case NUTMEG_TRACE_SCENE:
+        return "scene";
+    case NUTMEG_TRACE_EVENT:
+        return "event";
+    case NUTMEG_TRACE_BATCH:
+        return "batch";
+    case NUTMEG_TRACE_COMMANDS:
+        return "commands";
+    default:
+        return "counter";
+    }
+}
+
+/* Write a string as the contents of a JSON string literal. */
+static void nutmeg_trace_write_string(FILE *file, const char *string)
+{
+    for (const unsigned char *c = (const unsigned char *)string; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", (unsigned int)*c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+}
+
+static void nutmeg_trace_write_block(NutmegTrace *trace, const NutmegTraceBlock *block)
+{
+    FILE *file = trace->file;
+    if (!trace->named_lanes[block->lane]) {
+        trace->named_lanes[block->lane] = true;
+        if (block->lane == 0) {
+            fputs(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"tick\"}}", file);
+        } else {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}", block->lane, block->lane);
+        }
+    }
+
+    for (size_t i = 0; i < block->count; ++i) {
+        const NutmegTraceRecord *record = &block->records[i];
+        double ts = (double)(record->start_ns - trace->origin_ns) / 1000.0;
+        if (record->kind == NUTMEG_TRACE_COUNTER) {
+            fprintf(file, ",\n{\"name\":\"objects\",\"cat\":\"counter\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"", ts, block->lane);
+            nutmeg_trace_write_string(file, record->name);
+            fprintf(file, "\":%llu}}", record->value);
+            continue;
+        }
+
+        fputs(",\n{\"name\":\"", file);
+        nutmeg_trace_write_string(file, record->name);
+        fprintf(file, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u", nutmeg_trace_category(record->kind), ts, (double)record->value / 1000.0, block->lane);
+        if (record->count > 0) {
+            fprintf(file, ",\"args\":{\"objects\":%u}", record->count);
+        }
+        fputc('}', file);
+    }
+}
+
+static void nutmeg_trace_writer_main(void *arg)
+{
+    NutmegTrace *trace = (NutmegTrace *)arg;
+    nutmeg_mutex_lock(&trace->lock);
+    for (;;) {
+        while (!trace->full_head && !trace->stopping) {
+            nutmeg_cond_wait(&trace->ready, &trace->lock);
+        }
+        NutmegTraceBlock *batch = trace->full_head;
+        if (!batch) {
+            break;
+        }
+        trace->full_head = NULL;
+        trace->full_tail = NULL;
+        nutmeg_mutex_unlock(&trace->lock);
+
+        /* format outside the lock so lanes can hand over blocks meanwhile */
+        NutmegTraceBlock *last = batch;
+        for (NutmegTraceBlock *block = batch; block; block = block->next) {
+            nutmeg_trace_write_block(trace, block);
+            block->count = 0;
+            last = block;
+        }
+
+        nutmeg_mutex_lock(&trace->lock);
+        last->next = trace->free_blocks;
+        trace->free_blocks = batch;
+    }
+    nutmeg_mutex_unlock(&trace->lock);
+}
+
+/* Queue a full (or final) block for the writer. Caller holds the lock. */
+static void nutmeg_trace_queue(NutmegTrace *trace, NutmegTraceBlock *block)
+{
+    block->next = NULL;
+    if (trace->full_tail) {
+        trace->full_tail->next = block;
+    } else {
+        trace->full_head = block;
+    }
+    trace->full_tail = block;
+}
+
+NutmegTrace *nutmeg_trace_create(NutmegMemoryAccount *account, const char *path, size_t buffer_bytes, unsigned int tick_count)
+{
+    size_t block_count = buffer_bytes / sizeof(NutmegTraceBlock);
+    if (block_count < 4) {
+        block_count = 4;
+    }
+
+    NutmegTrace *trace = (NutmegTrace *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, sizeof(*trace));
+    if (!trace) {
+        return NULL;
+    }
+    trace->account = account;
+    trace->blocks = (NutmegTraceBlock *)nutmeg_memory_alloc(account, NUTMEG_MEMORY_ENGINE, block_count * sizeof(NutmegTraceBlock));
+    trace->file = fopen(path, "w");
+    if (!trace->blocks || !trace->file || !nutmeg_mutex_init(&trace->lock)) {
+        if (trace->file) {
+            fclose(trace->file);
+        }
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace->blocks, block_count * sizeof(NutmegTraceBlock));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace, sizeof(*trace));
+        return NULL;
+    }
+    if (!nutmeg_cond_init(&trace->ready)) {
+        nutmeg_mutex_destroy(&trace->lock);
+        fclose(trace->file);
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace->blocks, block_count * sizeof(NutmegTraceBlock));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace, sizeof(*trace));
+        return NULL;
+    }
+
+    trace->block_count = block_count;
+    for (size_t i = 0; i < block_count; ++i) {
+        trace->blocks[i].next = i + 1 < block_count ? &trace->blocks[i + 1] : NULL;
+    }
+    trace->free_blocks = trace->blocks;
+    trace->ticks_left = tick_count;
+    trace->recording = true;
+    trace->origin_ns = nutmeg_clock_ns();
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", trace->file);
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"nutmeg\"}}", trace->file);
+
+    if (!nutmeg_thread_start(&trace->writer, nutmeg_trace_writer_main, trace)) {
+        nutmeg_cond_destroy(&trace->ready);
+        nutmeg_mutex_destroy(&trace->lock);
+        fclose(trace->file);
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace->blocks, block_count * sizeof(NutmegTraceBlock));
+        nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace, sizeof(*trace));
+        return NULL;
+    }
+    return trace;
+}
+
+void nutmeg_trace_finish(NutmegTrace *trace)
+{
+    if (!trace->recording) {
+        return;
+    }
+    trace->recording = false;
+
+    nutmeg_mutex_lock(&trace->lock);
+    for (unsigned int lane = 0; lane < NUTMEG_TRACE_MAX_LANES; ++lane) {
+        if (trace->lanes[lane]) {
+            nutmeg_trace_queue(trace, trace->lanes[lane]);
+            trace->lanes[lane] = NULL;
+        }
+    }
+    trace->stopping = true;
+    nutmeg_cond_signal(&trace->ready);
+    nutmeg_mutex_unlock(&trace->lock);
+}
+
+unsigned long long nutmeg_trace_destroy(NutmegTrace *trace)
+{
+    nutmeg_trace_finish(trace);
+    nutmeg_thread_join(trace->writer);
+
+    fputs("\n]}\n", trace->file);
+    fclose(trace->file);
+    unsigned long long dropped = nutmeg_atomic_load_u64(&trace->dropped);
+
+    NutmegMemoryAccount *account = trace->account;
+    nutmeg_cond_destroy(&trace->ready);
+    nutmeg_mutex_destroy(&trace->lock);
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace->blocks, trace->block_count * sizeof(NutmegTraceBlock));
+    nutmeg_memory_free(account, NUTMEG_MEMORY_ENGINE, trace, sizeof(*trace));
+    return dropped;
+}
+
+/* Next free record of a lane, swapping in a fresh block when the current one is full. */
+static NutmegTraceRecord *nutmeg_trace_reserve(NutmegTrace *trace, unsigned int lane)
+{
+    if (lane >= NUTMEG_TRACE_MAX_LANES) {
+        nutmeg_atomic_fetch_add_u64(&trace->dropped, 1);
+        return NULL;
+    }
+
+    NutmegTraceBlock *block = trace->lanes[lane];
+    if (!block || block->count == NUTMEG_TRACE_BLOCK_RECORDS) {
+        nutmeg_mutex_lock(&trace->lock);
+        if (block) {
+            nutmeg_trace_queue(trace, block);
+            nutmeg_cond_signal(&trace->ready);
+        }
+        block = trace->free_blocks;
+        if (block) {
+            trace->free_blocks = block->next;
+            block->lane = lane;
+            block->count = 0;
+        }
+        nutmeg_mutex_unlock(&trace->lock);
+        trace->lanes[lane] = block;
+        if (!block) {
+            nutmeg_atomic_fetch_add_u64(&trace->dropped, 1);
+            return NULL;
+        }
+    }
+    return &block->records[block->count++];
+}
+
+static void nutmeg_trace_set_name(NutmegTraceRecord *record, const char *name)
+{
+    if (!name) {
+        name = "unnamed";
+    }
+    size_t length = strlen(name);
+    if (length >= NUTMEG_TRACE_NAME_LENGTH) {
+        length = NUTMEG_TRACE_NAME_LENGTH - 1;
+    }
+    memcpy(record->name, name, length);
+    record->name[length] = '\0';
+}
+
+void nutmeg_trace_span(NutmegTrace *trace, unsigned int lane, NutmegTraceKind kind, const char *name, unsigned long long start_ns, unsigned int count)
+{
+    unsigned long long end_ns = nutmeg_clock_ns();
+    NutmegTraceRecord *record = nutmeg_trace_reserve(trace, lane);
+    if (!record) {
+        return;
+    }
+    record->start_ns = start_ns;
+    record->value = end_ns - start_ns;
+    record->count = count;
+    record->kind = (unsigned int)kind;
+    nutmeg_trace_set_name(record, name);
+}
+
+void nutmeg_trace_counter(NutmegTrace *trace, unsigned int lane, const char *name, unsigned long long value)
+{
+    NutmegTraceRecord *record = nutmeg_trace_reserve(trace, lane);
+    if (!record) {
+        return;
+    }
+    record->start_ns = nutmeg_clock_ns();
+    record->value = value;
+    record->count = 0;
+    record->kind = NUTMEG_TRACE_COUNTER;
+    nutmeg_trace_set_name(record, name);
+}
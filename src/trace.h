@@ -0,0 +1,82 @@
+#ifndef NUTMEG_TRACE_H
+#define NUTMEG_TRACE_H
+
+#include "memory.h"
+#include "platform.h"
+
+#include <stdio.h>
+
+/*
+ * Chrome trace event recorder. Spans and counters are written into
+ * fixed-size blocks taken from a pool allocated up front. Each lane (the
+ * ticking thread is lane 0, pool workers use their participant index) owns
+ * one block at a time and touches no shared state until it is full; full
+ * blocks are queued for a background writer that formats them as JSON and
+ * returns them to the pool. When the writer falls behind and the pool runs
+ * dry, records are dropped and counted rather than stalling the tick.
+ */
+#define NUTMEG_TRACE_MAX_LANES 64
+#define NUTMEG_TRACE_BLOCK_RECORDS 512
+#define NUTMEG_TRACE_NAME_LENGTH 40
+
+typedef enum NutmegTraceKind {
+    NUTMEG_TRACE_TICK,
+    NUTMEG_TRACE_SCENE,
+    NUTMEG_TRACE_EVENT,
+    NUTMEG_TRACE_BATCH,
+    NUTMEG_TRACE_COMMANDS,
+    NUTMEG_TRACE_COUNTER
+} NutmegTraceKind;
+
+typedef struct NutmegTraceRecord {
+    unsigned long long start_ns;
+    unsigned long long value; /**< Span duration, or the counter value. */
+    unsigned int count;       /**< Targets a batch span covered. */
+    unsigned int kind;        /**< NutmegTraceKind */
+    char name[NUTMEG_TRACE_NAME_LENGTH];
+} NutmegTraceRecord;
+
+typedef struct NutmegTraceBlock {
+    struct NutmegTraceBlock *next;
+    unsigned int lane;
+    size_t count;
+    NutmegTraceRecord records[NUTMEG_TRACE_BLOCK_RECORDS];
+} NutmegTraceBlock;
+
+typedef struct NutmegTrace {
+    NutmegMemoryAccount *account;
+    FILE *file;
+    unsigned long long origin_ns;
+    unsigned int ticks_left;  /**< Ticks still to record, 0 records until stopped. */
+    bool recording;           /**< Cleared once the tick window is complete. */
+    NutmegTraceBlock *lanes[NUTMEG_TRACE_MAX_LANES];
+    NutmegTraceBlock *blocks; /**< The whole pool, one allocation. */
+    size_t block_count;
+    NutmegAtomicU64 dropped;
+    bool named_lanes[NUTMEG_TRACE_MAX_LANES]; /**< Lanes the writer emitted a thread name for. */
+
+    NutmegMutex lock;         /**< Guards everything below. */
+    NutmegCond ready;
+    NutmegTraceBlock *free_blocks;
+    NutmegTraceBlock *full_head;
+    NutmegTraceBlock *full_tail;
+    bool stopping;
+    NutmegThread writer;
+} NutmegTrace;
+
+/** Open path, allocate buffer_bytes worth of blocks and start the writer. Returns NULL on failure. */
+NutmegTrace *nutmeg_trace_create(NutmegMemoryAccount *account, const char *path, size_t buffer_bytes, unsigned int tick_count);
+
+/** Stop recording and queue every partially filled block. Lanes must be idle. */
+void nutmeg_trace_finish(NutmegTrace *trace);
+
+/** Finish, wait for the writer to drain, close the file and free the trace. Returns the dropped record count. */
+unsigned long long nutmeg_trace_destroy(NutmegTrace *trace);
+
+/** Record a span that started at start_ns and ends now. count is reported as an argument when non-zero. */
+void nutmeg_trace_span(NutmegTrace *trace, unsigned int lane, NutmegTraceKind kind, const char *name, unsigned long long start_ns, unsigned int count);
+
+/** Record a counter sample on lane. */
+void nutmeg_trace_counter(NutmegTrace *trace, unsigned int lane, const char *name, unsigned long long value);
+
+#endif /* NUTMEG_TRACE_H */